@@ -0,0 +1,113 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Analysis_Offload.h"
+#include "headers/Util.h"
+
+// L'autre cote doit couter moins de 80 % du cote actuel pour qu'on y passe
+#define MIGRATE_MARGIN 0.8
+// ... pendant au moins 2 s
+#define MIGRATE_HOLD_US 2000000u
+// Pas plus d'un changement de cote toutes les 5 s
+#define MIN_DWELL_US 5000000u
+// Charge serveur perimee (un PING par seconde en temps normal)
+#define LOAD_STALE_US 5000000u
+// Cote serveur : une analyse locale toutes les 10 s pour remesurer le cout device
+#define PROBE_INTERVAL_US 10000000u
+
+// Statuts thermiques Android (PowerManager.THERMAL_STATUS_*)
+#define THERMAL_LIGHT 1
+#define THERMAL_MODERATE 2
+#define THERMAL_SEVERE 3
+
+void Analysis_Offload::SetPowerState(int battery_pct, bool charging, int thermal_status) {
+    battery_pct_ = battery_pct;
+    charging_ = charging;
+    thermal_status_ = thermal_status;
+}
+
+double Analysis_Offload::powerFactor() const {
+    int thermal = thermal_status_;
+    if (thermal >= THERMAL_SEVERE) return 0.0;
+
+    double factor = thermal >= THERMAL_MODERATE ? 2.0 : (thermal >= THERMAL_LIGHT ? 1.25 : 1.0);
+    if (!charging_) {
+        int battery = battery_pct_;
+        if (battery < 15) {
+            factor *= 4.0;
+        } else if (battery < 30) {
+            factor *= 2.0;
+        }
+    }
+    return factor;
+}
+
+analysis_site Analysis_Offload::Decide(SocketClient *server, uint64_t now_us) {
+    if (server == nullptr) {
+        if (site_ == ANALYSIS_SERVER) migrate(ANALYSIS_DEVICE, "no analysis server", Server_Load(), now_us);
+        return site_;
+    }
+    Server_Load load = server->ServerLoad();
+    if (load.updated_us == 0 || now_us - load.updated_us > LOAD_STALE_US) {
+        if (site_ == ANALYSIS_SERVER) migrate(ANALYSIS_DEVICE, "server load unknown", load, now_us);
+        return site_;
+    }
+
+    double factor = powerFactor();
+    if (factor == 0.0) {
+        // Le telephone doit refroidir : pas d'attente ni d'hysteresis, ni de cout a connaitre
+        if (site_ == ANALYSIS_DEVICE) migrate(ANALYSIS_SERVER, "thermal limit", load, now_us);
+        return site_;
+    }
+    if (local_us_ == 0.0) return site_;  // pas encore de cout device a comparer
+
+    // Tant que le serveur n'a rien analyse, on lui suppose la meme vitesse que le device
+    double compute_us = load.analysis_us ? (double)load.analysis_us : local_us_;
+    double server_us = (double)load.rtt_us + compute_us * (1.0 + load.queued);
+    double device_us = local_us_ * factor;
+
+    bool other_cheaper = site_ == ANALYSIS_DEVICE ? server_us < device_us * MIGRATE_MARGIN
+                                                  : device_us < server_us * MIGRATE_MARGIN;
+    if (!other_cheaper) {
+        favored_since_ = 0;
+        return site_;
+    }
+    if (favored_since_ == 0) favored_since_ = now_us;
+    if (now_us - favored_since_ < MIGRATE_HOLD_US || now_us - migrated_us_ < MIN_DWELL_US) {
+        return site_;
+    }
+    if (site_ == ANALYSIS_DEVICE) {
+        migrate(ANALYSIS_SERVER, "server cheaper", load, now_us);
+    } else {
+        migrate(ANALYSIS_DEVICE, "device cheaper", load, now_us);
+    }
+    return site_;
+}
+
+bool Analysis_Offload::RunLocally(uint64_t now_us) {
+    // SEVERE et au-dela : rien sur le device, meme sans serveur pour prendre le relais
+    if (powerFactor() == 0.0) return false;
+    if (site_ == ANALYSIS_DEVICE) return true;
+    if (now_us - last_probe_us_ < PROBE_INTERVAL_US) return false;
+    last_probe_us_ = now_us;
+    return true;
+}
+
+void Analysis_Offload::AddLocalCost(uint32_t cost_us) {
+    local_us_ = (local_us_ == 0.0) ? cost_us : 0.8 * local_us_ + 0.2 * cost_us;
+}
+
+void Analysis_Offload::migrate(analysis_site to, const char *reason, const Server_Load &load,
+                               uint64_t now_us) {
+    double factor = powerFactor();
+    LOGI("analysis: %s -> %s (%s): device %.1f ms x%.2f (battery %d%%%s, thermal %d), "
+         "server %.1f ms + rtt %.1f ms, %u queued",
+         site_ == ANALYSIS_DEVICE ? "device" : "server", to == ANALYSIS_DEVICE ? "device" : "server",
+         reason, local_us_ / 1000.0, factor, battery_pct_.load(), charging_ ? ", charging" : "",
+         thermal_status_.load(), load.analysis_us / 1000.0, load.rtt_us / 1000.0, load.queued);
+    site_ = to;
+    migrated_us_ = now_us;
+    favored_since_ = 0;
+    last_probe_us_ = now_us;
+}
@@ -7,6 +7,59 @@
 using namespace std;
 using namespace cv;
 
+// Un resultat d'analyse reste affiche au plus 500 ms
+#define OVERLAY_HOLD_US 500000u
+
+// Zone de code-barres trouvee sur l'affichage en Result_Object, en pixels de la frame
+// envoyee (orientation capteur, sensor = sa taille) : rectangle englobant + 4 sommets
+static Result_Object barcodeObject(const RotatedRect &region, uint8_t orientation,
+                                   const Size &sensor) {
+    Result_Object object{};
+    object.kind = RESULT_BARCODE;
+    object.confidence = 1.0f;  // BarcodeDetect ne donne pas de score
+    Point2f corners[4];
+    region.points(corners);
+    object.point_count = 4;
+    for (int i = 0; i < 4; i++) {
+        UnorientPoint(orientation, (float)sensor.width, (float)sensor.height, corners[i].x,
+                      corners[i].y);
+        object.polygon[i][0] = (int16_t)cvRound(corners[i].x);
+        object.polygon[i][1] = (int16_t)cvRound(corners[i].y);
+    }
+    Rect box = boundingRect(vector<Point2f>(corners, corners + 4));
+    object.box[0] = (int16_t)box.x;
+    object.box[1] = (int16_t)box.y;
+    object.box[2] = (int16_t)box.width;
+    object.box[3] = (int16_t)box.height;
+    return object;
+}
+
+// Contour d'un objet (ses sommets, sinon son rectangle) ramene en pixels d'affichage :
+// mis a l'echelle de l'image capteur (sensor), puis redresse comme l'affichage
+static vector<Point> overlayPolygon(const Result_Object &object, const Point &origin, double sx,
+                                    double sy, uint8_t orientation, const Size &sensor) {
+    vector<Point2f> corners;
+    if (object.point_count > 0) {
+        for (int i = 0; i < object.point_count; i++) {
+            corners.emplace_back(object.polygon[i][0], object.polygon[i][1]);
+        }
+    } else {
+        float x = object.box[0];
+        float y = object.box[1];
+        float w = object.box[2];
+        float h = object.box[3];
+        corners = {Point2f(x, y), Point2f(x + w, y), Point2f(x + w, y + h), Point2f(x, y + h)};
+    }
+    vector<Point> polygon;
+    for (Point2f &c : corners) {
+        float x = (float)(origin.x + c.x * sx);
+        float y = (float)(origin.y + c.y * sy);
+        OrientPoint(orientation, (float)sensor.width, (float)sensor.height, x, y);
+        polygon.emplace_back(cvRound(x), cvRound(y));
+    }
+    return polygon;
+}
+
 CV_Manager::CV_Manager()
         : m_camera_ready(false), m_image(nullptr), m_image_reader(nullptr),
           m_native_camera(nullptr) {
@@ -28,10 +81,10 @@ CV_Manager::~CV_Manager() {
         ANativeWindow_release(m_native_window);
         m_native_window = nullptr;
     }
-    // 4. La socket TCP
-    if (m_Client != nullptr) {
-        delete m_Client;
-        m_Client = nullptr;
+    // 4. Les sockets des destinations
+    if (m_transmit != nullptr) {
+        delete m_transmit;
+        m_transmit = nullptr;
     }
 }
 
@@ -58,6 +111,8 @@ void CV_Manager::SetUpCamera() {
 
     m_image_reader = new Image_Reader(&m_view, AIMAGE_FORMAT_YUV_420_888);
     m_image_reader->SetPresentRotation(m_native_camera->GetOrientation());
+    // Les frames partent en orientation capteur, l'affichage seul est tourne
+    m_orientation = OrientationByte((int)m_native_camera->GetOrientation(), false);
 
     ANativeWindow *image_reader_window = m_image_reader->GetNativeWindow();
     m_camera_ready = m_native_camera->CreateCaptureSession(image_reader_window);
@@ -90,23 +145,113 @@ void CV_Manager::CameraLoop() {
             LOGI("/// H-W-S-F: %d, %d, %d, %d", buffer.height, buffer.width, buffer.stride, buffer.format);
         }
 
+        // Horodatage capteur (ns), a lire avant DisplayImage qui libere l'image
+        int64_t capture_ts_ns = 0;
+        AImage_getTimestamp(m_image, &capture_ts_ns);
+
+        // Une seule conversion, en orientation capteur : c'est elle qui est encodee,
+        // seul l'affichage est tourne
         m_image_reader->DisplayImage(&buffer, m_image);
         display_mat = Mat(buffer.height, buffer.stride, CV_8UC4, buffer.bits);
-        //BarcodeDetect(display_mat);
-        Mat send_mat;
-        if (m_Client) {
-            send_mat = display_mat.clone(); // copie avant unlock, buffer.bits sera invalide après
+        sensor_mat = m_image_reader->SensorImage();
+        // Aucune destination connectee (ou toutes en pause) : on affiche mais on
+        // n'encode rien. Les commandes serveur sont figees ici, en debut de frame.
+        bool online = m_transmit && m_transmit->BeginFrame();
+        if (online && m_transmit->TakeKeyframeRequest()) {
+            m_dedup.Reset();  // session reprise : la prochaine frame doit etre complete
+        }
+        // Nettete sur une vue decimee : en mode analyse (Scan), une frame floue n'est ni
+        // analysee, ni encodee, ni envoyee, sauf pour tenir le rythme minimal du direct
+        uint64_t now_us = ProtoClockMicros();
+        double sharpness = m_sharpness.Score(sensor_mat);
+        bool blurry = m_sharpness.IsBlurry(sharpness);
+        online = online && m_sharpness.Keep(blurry, scan_mode, now_us);
+        m_sharpness.Report(now_us);
+
+        // Scene inchangee : ni clone, ni conversion, ni encodage, juste un "repeat"
+        bool repeat = online && m_dedup.IsRepeat(sensor_mat);
+
+        // Analyse (apres Scan), sur le device ou sur le serveur selon leurs couts du
+        // moment. Une frame repetee a le meme resultat que la precedente ; une frame
+        // floue n'en a pas. Sur le device, l'analyse lit l'affichage (image droite) et
+        // ramene ses resultats en pixels de la frame envoyee.
+        SocketClient *analysis_server = online ? m_transmit->AnalysisServer() : nullptr;
+        bool analyze = scan_mode && !repeat && !blurry;
+        analysis_site site = analyze ? m_offload.Decide(analysis_server, now_us) : m_offload.Site();
+        vector<uint8_t> local_results;
+        bool analyzed_here = analyze && m_offload.RunLocally(now_us);
+        if (analyzed_here) {
+            RotatedRect region;
+            uint64_t start_us = ProtoClockMicros();
+            bool found = BarcodeDetect(display_mat(Rect(0, 0, buffer.width, buffer.height)), region);
+            uint32_t cost_us = (uint32_t)(ProtoClockMicros() - start_us);
+            m_offload.AddLocalCost(cost_us);
+            Result_Object object =
+                    found ? barcodeObject(region, m_orientation, sensor_mat.size()) : Result_Object{};
+            local_results = EncodeResults(ANALYSIS_DEVICE, cost_us, &object, found ? 1 : 0);
+            if (site == ANALYSIS_DEVICE) {
+                m_overlay.clear();
+                if (found) {
+                    m_overlay.push_back(overlayPolygon(object, Point(0, 0), 1.0, 1.0, m_orientation,
+                                                       sensor_mat.size()));
+                }
+                m_overlay_us = now_us;
+            }
+        }
+
+        // L'image capteur appartient a Image_Reader et survit a l'unlock : pas de copie,
+        // seules les ROI seront encodees
+        Rect capture;
+        if (online && !repeat) {
+            capture = m_transmit->CaptureRect(sensor_mat.size());
+        }
+
+        // Resultats du serveur, en pixels de la frame qu'il a recue : ramenes a l'affichage
+        const Results_Header *header;
+        const Result_Object *objects;
+        const char *text;
+        if (analysis_server && analysis_server->TakeResults(m_remote_results) &&
+            m_remote_results.width > 0 && m_remote_results.height > 0 &&
+            ParseResults(m_remote_results.payload.data(), m_remote_results.payload.size(), &header,
+                         &objects, &text)) {
+            double sx = (double)m_analysis_capture.width / m_remote_results.width;
+            double sy = (double)m_analysis_capture.height / m_remote_results.height;
+            m_overlay.clear();
+            for (uint16_t i = 0; i < header->count; i++) {
+                m_overlay.push_back(overlayPolygon(objects[i], m_analysis_capture.tl(), sx, sy,
+                                                   m_orientation, sensor_mat.size()));
+            }
+            m_overlay_us = now_us;
+        }
+        // Dessine apres la copie : le resultat voyage a part, pas dans les pixels envoyes
+        if (scan_mode && !m_overlay.empty() && now_us - m_overlay_us < OVERLAY_HOLD_US) {
+            polylines(display_mat, m_overlay, true, CV_GREEN, 2);
         }
         ANativeWindow_unlockAndPost(m_native_window);
-        if (m_Client) {
-            m_Client->SendImage(send_mat); // cvtColor + imencode + TCP hors du lock
+
+        if (online) {
+            if (repeat) {
+                m_transmit->SendRepeat(capture_ts_ns / 1000);
+            } else {
+                // cvtColor + imencode (une fois par profil) + envoi hors du lock, sans
+                // rotation : le header dit au serveur comment redresser
+                bool offload = analyze && site == ANALYSIS_SERVER;
+                if (offload) m_analysis_capture = capture;
+                m_transmit->SendFrame(sensor_mat(capture), capture.tl(), capture_ts_ns / 1000,
+                                      offload, SharpnessByte(sharpness), m_orientation);
+            }
+            // Le serveur a les resultats dans tous les cas, sans refaire l'analyse ; ils
+            // suivent la frame (meme sequence) dans la file de controle, ramenes a sa ROI
+            if (analyzed_here && site == ANALYSIS_DEVICE) {
+                m_transmit->SendResults(std::move(local_results), capture_ts_ns / 1000);
+            }
         }
         ReleaseMats();
     }
     LOGI("CameraLoop exited cleanly");
 }
 
-void CV_Manager::BarcodeDetect(Mat &frame) {
+bool CV_Manager::BarcodeDetect(const Mat &frame, RotatedRect &region) {
     int ddepth = CV_16S;
 
     // Conversion en niveaux de gris
@@ -140,13 +285,15 @@ void CV_Manager::BarcodeDetect(Mat &frame) {
     // Extraction des contours
     findContours(cleaned, contours, hierarchy, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
 
-    // Tri des contours par aire croissante
-    std::sort(contours.begin(), contours.end(), [](const vector<Point>& c1, const vector<Point>& c2) {
+    if (contours.empty()) return false;
+
+    // Plus grand contour : le dessin est laisse a l'appelant (affichage seulement)
+    auto largest = std::max_element(contours.begin(), contours.end(),
+                                    [](const vector<Point>& c1, const vector<Point>& c2) {
         return contourArea(c1, false) < contourArea(c2, false);
     });
-
-    // Dessin du plus grand contour
-    drawContours(frame, contours, int(contours.size()-1), CV_GREEN, 2, LINE_8, hierarchy, 0, Point());
+    region = minAreaRect(*largest);
+    return true;
 }
 
 void CV_Manager::RunCV() {
@@ -155,6 +302,10 @@ void CV_Manager::RunCV() {
     start_t = clock();
 }
 
+void CV_Manager::SetPowerState(int battery_pct, bool charging, int thermal_status) {
+    m_offload.SetPowerState(battery_pct, charging, thermal_status);
+}
+
 void CV_Manager::HaltCamera() {
     m_camera_thread_stopped = true;
 }
@@ -176,6 +327,7 @@ void CV_Manager::FlipCamera() {
         m_selected_camera_type = FRONT_CAMERA;
     }
 
+    m_dedup.Reset();
     SetUpCamera();
 }
 void CV_Manager::SetUpTCP()
@@ -184,20 +336,34 @@ void CV_Manager::SetUpTCP()
     const char hostname[] = "172.16.81.179";
     int port = 9999;
 
-    SocketClient* client =new SocketClient(hostname, port);
+    Transmit_Stage* transmit = new Transmit_Stage();
+
+    SocketClient* client = transmit->AddDestination(hostname, port, Encode_Profile());
+
+    // TRANSPORT_UDP : pas de blocage head-of-line sur Wi-Fi avec pertes
+    // (necessite le recepteur UDP du serveur, meme port)
+    client->SetTransport(TRANSPORT_TCP);
+    client->SetDeviceId(m_device_id);
+
+    // Autres destinations possibles, chacune avec son profil et sa file, ex. :
+    //   Encode_Profile gray; gray.width = 320; gray.height = 240; gray.luma_only = true;
+    //   transmit->AddDestination("172.16.81.180", 9999, gray, 4, DROP_NEWEST);
 
-    client->ConnectToServer();
-    client->SendImageDims(640, 480);
-    setSocketClient(client);
+    // Connexion en arriere-plan : si le serveur est absent ou redemarre, chaque
+    // client se reconnecte seul et renvoie ces dimensions a chaque session
+    transmit->SendImageDims(640, 480);
+    transmit->Start();
+    setTransmitStage(transmit);
 
 }
-void CV_Manager::setSocketClient(SocketClient *client)
+void CV_Manager::setTransmitStage(Transmit_Stage *transmit)
 {
-    this->m_Client = client;
+    this->m_transmit = transmit;
 }
 
 void CV_Manager::ReleaseMats() {
     display_mat.release();
+    sensor_mat.release();
     frame_gray.release();
     grad_x.release();
     abs_grad_x.release();
@@ -0,0 +1,56 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Frame_Dedup.h"
+
+#include <opencv2/imgproc.hpp>
+
+using namespace std;
+using namespace cv;
+
+Frame_Dedup::Frame_Dedup(int max_distance, int keepalive_ms)
+        : m_max_distance(max_distance), m_keepalive_ms(keepalive_ms) {
+}
+
+uint64_t Frame_Dedup::ComputeHash(const Mat &rgba) {
+    // Vignette 9x8 : INTER_AREA moyenne tous les pixels, donc insensible au bruit capteur
+    resize(rgba, m_thumb, Size(9, 8), 0, 0, INTER_AREA);
+    cvtColor(m_thumb, m_luma, COLOR_RGBA2GRAY);
+
+    // dHash : 1 bit par couple de pixels voisins (gradient horizontal)
+    uint64_t hash = 0;
+    for (int y = 0; y < 8; y++) {
+        const uchar *row = m_luma.ptr<uchar>(y);
+        for (int x = 0; x < 8; x++) {
+            hash = (hash << 1) | (row[x] > row[x + 1] ? 1u : 0u);
+        }
+    }
+    return hash;
+}
+
+bool Frame_Dedup::IsRepeat(const Mat &rgba) {
+    if (rgba.empty()) return false;
+
+    uint64_t hash = ComputeHash(rgba);
+    auto now = chrono::steady_clock::now();
+
+    if (m_has_last) {
+        int distance = __builtin_popcountll(hash ^ m_last_hash);
+        auto age = chrono::duration_cast<chrono::milliseconds>(now - m_last_sent).count();
+        if (distance <= m_max_distance && age < m_keepalive_ms) {
+            return true;
+        }
+    }
+
+    // On compare toujours a la derniere frame ENVOYEE, pas a la precedente,
+    // sinon un changement lent passerait inapercu
+    m_last_hash = hash;
+    m_last_sent = now;
+    m_has_last = true;
+    return false;
+}
+
+void Frame_Dedup::Reset() {
+    m_has_last = false;
+}
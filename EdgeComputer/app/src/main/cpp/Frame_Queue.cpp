@@ -0,0 +1,76 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Frame_Queue.h"
+
+Frame_Queue::Frame_Queue(size_t capacity, drop_policy policy)
+        : capacity_(capacity > 0 ? capacity : 1), policy_(policy) {
+}
+
+void Frame_Queue::PushControl(Frame_Packet packet) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    control_.push_back(std::move(packet));
+}
+
+bool Frame_Queue::PushFrame(Frame_Packet packet) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Un repeat ne doit jamais remplacer une vraie frame en attente : le serveur
+    // re-servirait alors une image plus ancienne. La frame en attente porte deja
+    // le meme contenu, le repeat est redondant.
+    if (packet.header.type == MSG_REPEAT && !frames_.empty()) {
+        dropped_++;
+        return false;
+    }
+
+    if (policy_ == DROP_NEWEST && frames_.size() >= capacity_) {
+        dropped_++;
+        return false;
+    }
+
+    bool kept_all = true;
+    while (frames_.size() >= capacity_) {
+        frames_.pop_front();
+        dropped_++;
+        kept_all = false;
+    }
+    frames_.push_back(std::move(packet));
+    return kept_all;
+}
+
+bool Frame_Queue::Pop(Frame_Packet &out) {
+    return PopControl(out) || PopFrame(out);
+}
+
+bool Frame_Queue::PopControl(Frame_Packet &out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (control_.empty()) return false;
+    out = std::move(control_.front());
+    control_.pop_front();
+    return true;
+}
+
+bool Frame_Queue::PopFrame(Frame_Packet &out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (frames_.empty()) return false;
+    out = std::move(frames_.front());
+    frames_.pop_front();
+    return true;
+}
+
+bool Frame_Queue::HasFrame() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !frames_.empty();
+}
+
+void Frame_Queue::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    control_.clear();
+    frames_.clear();
+}
+
+uint64_t Frame_Queue::Dropped() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
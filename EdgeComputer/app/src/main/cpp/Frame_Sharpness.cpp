@@ -0,0 +1,84 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Frame_Sharpness.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+
+using namespace std;
+using namespace cv;
+
+// Largeur visee de la vue decimee
+#define SHARPNESS_WIDTH 160
+
+// Decroissance de la reference par frame : divisee par deux en ~1 s a 30 fps
+#define REFERENCE_DECAY 0.98
+
+// Reference sous laquelle la scene est trop uniforme pour juger du flou
+#define MIN_REFERENCE 4.0
+
+#define REPORT_PERIOD_US 10000000u
+
+Frame_Sharpness::Frame_Sharpness(double blur_ratio, int min_live_ms)
+        : m_blur_ratio(blur_ratio), m_min_live_us((uint64_t)min_live_ms * 1000u) {
+}
+
+double Frame_Sharpness::Score(const Mat &rgba) {
+    if (rgba.empty()) return 0.0;
+
+    // Un pixel sur step : INTER_NEAREST ne moyenne rien, les aretes nettes restent nettes
+    int step = max(1, rgba.cols / SHARPNESS_WIDTH);
+    resize(rgba, m_small, Size(rgba.cols / step, rgba.rows / step), 0, 0, INTER_NEAREST);
+    cvtColor(m_small, m_luma, COLOR_RGBA2GRAY);
+    Laplacian(m_luma, m_laplacian, CV_16S, 1);
+
+    Scalar mean;
+    Scalar stddev;
+    meanStdDev(m_laplacian, mean, stddev);
+    double score = stddev[0] * stddev[0];
+
+    m_buckets[SharpnessBucket(SharpnessByte(score))]++;
+    m_frames++;
+    m_sum += score;
+    return score;
+}
+
+bool Frame_Sharpness::IsBlurry(double score) {
+    m_reference = max(score, m_reference * REFERENCE_DECAY);
+    bool blurry = m_reference >= MIN_REFERENCE && score < m_blur_ratio * m_reference;
+    if (blurry) m_blurry++;
+    return blurry;
+}
+
+bool Frame_Sharpness::Keep(bool blurry, bool analytics, uint64_t now_us) {
+    if (analytics && blurry && now_us - m_last_kept_us < m_min_live_us) {
+        m_skipped++;
+        return false;
+    }
+    m_last_kept_us = now_us;
+    return true;
+}
+
+void Frame_Sharpness::Report(uint64_t now_us) {
+    if (m_last_report_us == 0) m_last_report_us = now_us;
+    if (now_us - m_last_report_us < REPORT_PERIOD_US || m_frames == 0) return;
+
+    const uint64_t *b = m_buckets;
+    LOGI("sharpness: %llu frames, mean %.0f, %llu blurry, %llu skipped, reference %.0f, "
+         "buckets %llu %llu %llu %llu %llu %llu %llu %llu",
+         (unsigned long long)m_frames, m_sum / (double)m_frames, (unsigned long long)m_blurry,
+         (unsigned long long)m_skipped, m_reference,
+         (unsigned long long)b[0], (unsigned long long)b[1], (unsigned long long)b[2],
+         (unsigned long long)b[3], (unsigned long long)b[4], (unsigned long long)b[5],
+         (unsigned long long)b[6], (unsigned long long)b[7]);
+
+    fill(m_buckets, m_buckets + SHARPNESS_BUCKETS, 0);
+    m_frames = 0;
+    m_blurry = 0;
+    m_skipped = 0;
+    m_sum = 0.0;
+    m_last_report_us = now_us;
+}
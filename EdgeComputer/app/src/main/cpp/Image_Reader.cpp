@@ -220,76 +220,24 @@ bool Image_Reader::DisplayImage(ANativeWindow_Buffer *buf, AImage *image) {
     AImage_getNumberOfPlanes(image, &srcPlanes);
     ASSERT(srcPlanes == 3, "Is not 3 planes");
 
-    switch (presentRotation_) {
-        case 0:
-            PresentImage(buf, image);
-            break;
-        case 90:
-            PresentImage90(buf, image);
-            break;
-        case 180:
-            PresentImage180(buf, image);
-            break;
-        case 270:
-            PresentImage270(buf, image);
-            break;
-        default:
-            ASSERT(0, "NOT recognized display rotation: %d", presentRotation_);
-    }
+    // Partie de l'image que l'ecran peut montrer, mesuree en orientation capteur
+    bool quarter = presentRotation_ == 90 || presentRotation_ == 270;
+    ConvertImage(image, quarter ? buf->height : buf->width, quarter ? buf->width : buf->height);
 
     AImage_delete(image);
     image = nullptr;
 
+    PresentImage(buf);
     return true;
 }
 
 /*
- * PresentImage()
- *   Converting yuv to RGB
- *   No rotation: (x,y) --> (x, y)
- *   Refer to:
- * https://mathbits.com/MathBits/TISection/Geometry/Transformations2.htm
- */
-void Image_Reader::PresentImage(ANativeWindow_Buffer *buf, AImage *image) {
-    AImageCropRect srcRect;
-    AImage_getCropRect(image, &srcRect);
-
-    AImage_getPlaneRowStride(image, 0, &yStride);
-    AImage_getPlaneRowStride(image, 1, &uvStride);
-    yPixel = imageBuffer_;
-    AImage_getPlaneData(image, 0, &yPixel, &yLen);
-    vPixel = imageBuffer_ + yLen;
-    AImage_getPlaneData(image, 1, &vPixel, &vLen);
-    uPixel = imageBuffer_ + yLen + vLen;
-    AImage_getPlaneData(image, 2, &uPixel, &uLen);
-    AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-
-    int32_t height = MIN(buf->height, (srcRect.bottom - srcRect.top));
-    int32_t width = MIN(buf->width, (srcRect.right - srcRect.left));
-
-    uint32_t *out = static_cast<uint32_t *>(buf->bits);
-
-    for (int32_t y = 0; y < height; y++) {
-        const uint8_t *pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
-
-        int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-        const uint8_t *pU = uPixel + uv_row_start + (srcRect.left >> 1);
-        const uint8_t *pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-        for (int32_t x = 0; x < width; x++) {
-            const int32_t uv_offset = (x >> 1) * uvPixelStride;
-            out[x] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-        }
-        out += buf->stride;
-    }
-}
-
-/*
- * PresentImage90()
- *   Converting YUV to RGB
- *   Rotation image anti-clockwise 90 degree -- (x, y) --> (-y, x)
+ * ConvertImage()
+ *   Converting yuv to RGB, in sensor orientation (no rotation): rows are
+ *   read and written sequentially. Only the top-left max_width x max_height
+ *   part is converted.
  */
-void Image_Reader::PresentImage90(ANativeWindow_Buffer *buf, AImage *image) {
+void Image_Reader::ConvertImage(AImage *image, int32_t max_width, int32_t max_height) {
     AImageCropRect srcRect;
     AImage_getCropRect(image, &srcRect);
 
@@ -303,54 +251,15 @@ void Image_Reader::PresentImage90(ANativeWindow_Buffer *buf, AImage *image) {
     AImage_getPlaneData(image, 2, &uPixel, &uLen);
     AImage_getPlanePixelStride(image, 1, &uvPixelStride);
 
-    int32_t height = MIN(buf->width, (srcRect.bottom - srcRect.top));
-    int32_t width = MIN(buf->height, (srcRect.right - srcRect.left));
+    int32_t height = MIN(max_height, (srcRect.bottom - srcRect.top));
+    int32_t width = MIN(max_width, (srcRect.right - srcRect.left));
 
-    uint32_t *out = static_cast<uint32_t *>(buf->bits);
-    out += height - 1;
-    for (int32_t y = 0; y < height; y++) {
-        const uint8_t *pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
-
-        int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-        const uint8_t *pU = uPixel + uv_row_start + (srcRect.left >> 1);
-        const uint8_t *pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-        for (int32_t x = 0; x < width; x++) {
-            const int32_t uv_offset = (x >> 1) * uvPixelStride;
-            // [x, y]--> [-y, x]
-            int testb = pU[uv_offset];
-            int testc = pV[uv_offset];
-            int testA = pY[x];
-            out[x * buf->stride] = YUV2RGB(testA, testb, testc);
-        }
-        out -= 1;  // move to the next column
+    // Nouveau buffer si la taille change ou si un lecteur garde encore l'ancien
+    if (sensorImage_.rows != height || sensorImage_.cols != width || sensorImage_.u == nullptr ||
+        sensorImage_.u->refcount > 1) {
+        sensorImage_ = cv::Mat(height, width, CV_8UC4);
     }
-}
 
-/*
- * PresentImage180()
- *   Converting yuv to RGB
- *   Rotate image 180 degree: (x, y) --> (-x, -y)
- */
-void Image_Reader::PresentImage180(ANativeWindow_Buffer *buf, AImage *image) {
-    AImageCropRect srcRect;
-    AImage_getCropRect(image, &srcRect);
-
-    AImage_getPlaneRowStride(image, 0, &yStride);
-    AImage_getPlaneRowStride(image, 1, &uvStride);
-    yPixel = imageBuffer_;
-    AImage_getPlaneData(image, 0, &yPixel, &yLen);
-    vPixel = imageBuffer_ + yLen;
-    AImage_getPlaneData(image, 1, &vPixel, &vLen);
-    uPixel = imageBuffer_ + yLen + vLen;
-    AImage_getPlaneData(image, 2, &uPixel, &uLen);
-    AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-
-    int32_t height = MIN(buf->height, (srcRect.bottom - srcRect.top));
-    int32_t width = MIN(buf->width, (srcRect.right - srcRect.left));
-
-    uint32_t *out = static_cast<uint32_t *>(buf->bits);
-    out += (height - 1) * buf->stride;
     for (int32_t y = 0; y < height; y++) {
         const uint8_t *pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
 
@@ -358,55 +267,41 @@ void Image_Reader::PresentImage180(ANativeWindow_Buffer *buf, AImage *image) {
         const uint8_t *pU = uPixel + uv_row_start + (srcRect.left >> 1);
         const uint8_t *pV = vPixel + uv_row_start + (srcRect.left >> 1);
 
+        uint32_t *out = sensorImage_.ptr<uint32_t>(y);
         for (int32_t x = 0; x < width; x++) {
             const int32_t uv_offset = (x >> 1) * uvPixelStride;
-            // mirror image since we are using front camera
-            out[width - 1 - x] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-            // out[x] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
+            out[x] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
         }
-        out -= buf->stride;
     }
 }
 
 /*
- * PresentImage270()
- *   Converting image from YUV to RGB
- *   Rotate Image counter-clockwise 270 degree: (x, y) --> (y, x)
+ * PresentImage()
+ *   Copy the converted image to the display buffer, rotated clockwise by
+ *   presentRotation_ (blocked transpose + flip, see cv::rotate):
+ *     90:  (x, y) --> (h - 1 - y, x)
+ *     180: (x, y) --> (w - 1 - x, h - 1 - y)
+ *     270: (x, y) --> (y, w - 1 - x)
  */
-void Image_Reader::PresentImage270(ANativeWindow_Buffer *buf, AImage *image) {
-    AImageCropRect srcRect;
-    AImage_getCropRect(image, &srcRect);
-
-    AImage_getPlaneRowStride(image, 0, &yStride);
-    AImage_getPlaneRowStride(image, 1, &uvStride);
-    yPixel = imageBuffer_;
-    AImage_getPlaneData(image, 0, &yPixel, &yLen);
-    vPixel = imageBuffer_ + yLen;
-    AImage_getPlaneData(image, 1, &vPixel, &vLen);
-    uPixel = imageBuffer_ + yLen + vLen;
-    AImage_getPlaneData(image, 2, &uPixel, &uLen);
-    AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-
-    int32_t height = MIN(buf->width, (srcRect.bottom - srcRect.top));
-    int32_t width = MIN(buf->height, (srcRect.right - srcRect.left));
-
-    uint32_t *out = static_cast<uint32_t *>(buf->bits);
-    for (int32_t y = 0; y < height; y++) {
-        const uint8_t *pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
-
-        int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-        const uint8_t *pU = uPixel + uv_row_start + (srcRect.left >> 1);
-        const uint8_t *pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-        for (int32_t x = 0; x < width; x++) {
-            const int32_t uv_offset = (x >> 1) * uvPixelStride;
-            int testb = pU[uv_offset];
-            int testc = pV[uv_offset];
-            int testA = pY[x];
-            out[(width - 1 - x) * buf->stride] =
-                    YUV2RGB(testA, testb, testc);
-        }
-        out += 1;  // move to the next column
+void Image_Reader::PresentImage(ANativeWindow_Buffer *buf) {
+    cv::Mat out(buf->height, buf->width, CV_8UC4, buf->bits, (size_t)buf->stride * 4);
+    const cv::Mat &src = sensorImage_;
+    switch (presentRotation_) {
+        case 0:
+            src.copyTo(out(cv::Rect(0, 0, src.cols, src.rows)));
+            break;
+        case 90:
+            cv::rotate(src, out(cv::Rect(0, 0, src.rows, src.cols)), cv::ROTATE_90_CLOCKWISE);
+            break;
+        case 180:
+            cv::rotate(src, out(cv::Rect(0, 0, src.cols, src.rows)), cv::ROTATE_180);
+            break;
+        case 270:
+            cv::rotate(src, out(cv::Rect(0, 0, src.rows, src.cols)),
+                       cv::ROTATE_90_COUNTERCLOCKWISE);
+            break;
+        default:
+            ASSERT(0, "NOT recognized display rotation: %d", presentRotation_);
     }
 }
 
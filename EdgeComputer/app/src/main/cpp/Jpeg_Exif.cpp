@@ -0,0 +1,43 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Jpeg_Exif.h"
+#include "headers/Protocol.h"
+
+// APP1 "Exif" : en-tete TIFF little-endian, un IFD d'une seule entree (0x0112, SHORT)
+#define EXIF_SEGMENT_BYTES 36
+#define EXIF_ORIENTATION_BYTE 28
+
+uint8_t ExifOrientation(uint8_t orientation) {
+    // Indice : quarts de tour horaires, + 4 si miroir apres rotation
+    static const uint8_t tags[8] = {1, 6, 3, 8, 2, 5, 4, 7};
+    return tags[(orientation & ORIENT_TURNS) | ((orientation & ORIENT_MIRROR) ? 4 : 0)];
+}
+
+size_t JpegOrientationPrefix(const uint8_t *jpeg, size_t length, uint8_t orientation,
+                             std::string &prefix) {
+    prefix.clear();
+    uint8_t tag = ExifOrientation(orientation);
+    if (tag == 1 || length < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8) return 0;
+
+    size_t skip = 2;
+    if (jpeg[2] == 0xFF && jpeg[3] == 0xE0 && length >= 6) {
+        size_t app0 = 2 + ((size_t)jpeg[4] << 8 | jpeg[5]);
+        if (skip + app0 > length) return 0;
+        skip += app0;
+    }
+
+    static const uint8_t exif[EXIF_SEGMENT_BYTES] = {
+            0xFF, 0xE1, 0x00, EXIF_SEGMENT_BYTES - 2, 'E', 'x', 'i', 'f', 0, 0,
+            'I', 'I', 0x2A, 0, 8, 0, 0, 0,   // en-tete TIFF, IFD0 a l'octet 8
+            1, 0,                            // une entree
+            0x12, 0x01, 3, 0, 1, 0, 0, 0,    // Orientation, SHORT, 1 valeur
+            0, 0, 0, 0,                      // valeur (EXIF_ORIENTATION_BYTE)
+            0, 0, 0, 0};                     // pas d'IFD suivant
+    prefix.reserve(skip + EXIF_SEGMENT_BYTES);
+    prefix.assign((const char *)jpeg, skip);
+    prefix.append((const char *)exif, EXIF_SEGMENT_BYTES);
+    prefix[skip + EXIF_ORIENTATION_BYTE] = (char)tag;
+    return skip;
+}
@@ -48,6 +48,15 @@ Native_Camera::Native_Camera(camera_type type) {
 //  ACameraMetadata_getConstEntry(
 //      cameraMetadata, ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL, &entry);
 
+    // Les horodatages capteur ne sont comparables a CLOCK_BOOTTIME (horloge des
+    // PING/PONG) que si la source est REALTIME
+    ACameraMetadata_const_entry ts_source;
+    if (ACameraMetadata_getConstEntry(cameraMetadata, ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE,
+                                      &ts_source) == ACAMERA_OK &&
+        ts_source.data.u8[0] != ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME) {
+        LOGE("Sensor timestamp source is not REALTIME: capture latencies will be wrong");
+    }
+
     m_camera_ready = true;
 }
 
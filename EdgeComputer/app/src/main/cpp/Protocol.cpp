@@ -0,0 +1,126 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Protocol.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <time.h>
+
+void InitHeaderV2(FrameHeaderV2 *hdr, uint8_t type, uint32_t payload_len) {
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = PROTO_MAGIC;
+    hdr->version = PROTO_VERSION;
+    hdr->type = type;
+    hdr->payload_len = payload_len;
+}
+
+bool IsValidHeaderV2(const FrameHeaderV2 *hdr) {
+    return hdr->magic == PROTO_MAGIC &&
+           hdr->version == PROTO_VERSION &&
+           hdr->payload_len <= PROTO_MAX_PAYLOAD;
+}
+
+// Table generee une seule fois (static local : initialisation thread-safe)
+struct Crc32Table {
+    uint32_t v[256];
+
+    Crc32Table() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            }
+            v[i] = c;
+        }
+    }
+};
+
+uint32_t Crc32(const void *data, size_t len, uint32_t crc) {
+    static const Crc32Table table;
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = table.v[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+bool ParseResults(const uint8_t *payload, size_t len, const Results_Header **header,
+                  const Result_Object **objects, const char **text) {
+    if (len < sizeof(Results_Header)) return false;
+    const Results_Header *h = reinterpret_cast<const Results_Header *>(payload);
+    if (ResultsBytes(h->count, h->text_bytes) > len) return false;
+
+    const Result_Object *o = reinterpret_cast<const Result_Object *>(h + 1);
+    for (uint16_t i = 0; i < h->count; i++) {
+        if (o[i].point_count > RESULT_MAX_POINTS ||
+            (uint32_t)o[i].text_offset + o[i].text_length > h->text_bytes) {
+            return false;
+        }
+    }
+    *header = h;
+    *objects = o;
+    *text = reinterpret_cast<const char *>(o + h->count);
+    return true;
+}
+
+std::vector<uint8_t> EncodeResults(uint8_t site, uint32_t cost_us, const Result_Object *objects,
+                                   uint16_t count, const char *text, uint32_t text_bytes) {
+    std::vector<uint8_t> payload(ResultsBytes(count, text_bytes));
+    Results_Header header{};
+    header.site = site;
+    header.count = count;
+    header.cost_us = cost_us;
+    header.text_bytes = text_bytes;
+    memcpy(payload.data(), &header, sizeof(header));
+    if (count > 0) {
+        memcpy(payload.data() + sizeof(header), objects, count * sizeof(Result_Object));
+    }
+    if (text_bytes > 0) {
+        memcpy(payload.data() + sizeof(header) + count * sizeof(Result_Object), text, text_bytes);
+    }
+    return payload;
+}
+
+uint8_t SharpnessByte(double score) {
+    double scaled = 16.0 * std::log2(1.0 + std::max(score, 0.0));
+    return (uint8_t)std::min(255.0, std::max(1.0, scaled));
+}
+
+uint8_t OrientationByte(int rotation_deg, bool mirror) {
+    int turns = ((rotation_deg / 90) % 4 + 4) % 4;
+    return (uint8_t)(turns | (mirror ? ORIENT_MIRROR : 0));
+}
+
+// Un quart de tour horaire d'un point de l'image w x h, qui devient h x w
+static void turnPoint(float &w, float &h, float &x, float &y) {
+    float turned_x = h - y;
+    y = x;
+    x = turned_x;
+    std::swap(w, h);
+}
+
+void OrientPoint(uint8_t orientation, float w, float h, float &x, float &y) {
+    for (int i = 0; i < (orientation & ORIENT_TURNS); i++) {
+        turnPoint(w, h, x, y);
+    }
+    if (orientation & ORIENT_MIRROR) x = w - x;
+}
+
+void UnorientPoint(uint8_t orientation, float w, float h, float &x, float &y) {
+    int turns = orientation & ORIENT_TURNS;
+    if (turns & 1) std::swap(w, h);  // dimensions de l'image redressee
+    if (orientation & ORIENT_MIRROR) x = w - x;
+    for (int i = 0; i < (4 - turns) % 4; i++) {
+        turnPoint(w, h, x, y);
+    }
+}
+
+uint64_t ProtoClockMicros() {
+    timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
@@ -3,39 +3,127 @@
 //
 
 #include "headers/SocketTcp.h"
+#include "headers/Jpeg_Exif.h"
+#include "headers/Protocol.h"
 #include "headers/Util.h"
 
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 #include <errno.h>
 
+#include <algorithm>
+#include <chrono>
+#include <random>
 #include <vector>
 #include <cstring>
-#include <opencv2/imgproc.hpp>
-#include <opencv2/imgcodecs.hpp>
 
-SocketClient::SocketClient(const std::string& host, int port)
-        : host_(host), port_(port) {}
+// Delai max d'attente du HELLO_ACK : au-dela on considere un serveur legacy (v1)
+#define HELLO_TIMEOUT_MS 500
+#define CONNECT_TIMEOUT_MS 2000
+
+// Backoff de reconnexion : 100 ms, 200 ms, ... plafonne a 5 s (+ jitter)
+#define RECONNECT_MIN_MS 100
+#define RECONNECT_MAX_MS 5000
+
+// Flux strie : connexions max, et attente avant de revoir une voie pleine
+#define MAX_STRIPES 8
+#define STRIPE_RETRY_MS 5
+
+// Adaptation de qualite au debit cible (CTRL_SET_BITRATE)
+#define MIN_JPEG_QUALITY 20
+
+SocketClient::SocketClient(const std::string& host, int port, size_t queue_capacity,
+                           drop_policy policy)
+        : host_(host), port_(port), queue_(queue_capacity, policy) {}
 
 SocketClient::~SocketClient() {
     Close();
 }
 
+void SocketClient::Start() {
+    if (sender_thread_.joinable()) return;
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        LOGE("eventfd() failed errno=%d", errno);
+        return;
+    }
+    sender_stop_ = false;
+    sender_thread_ = std::thread(&SocketClient::transportLoop, this);
+}
+
 void SocketClient::Close() {
+    if (sender_thread_.joinable()) {
+        sender_stop_ = true;
+        wakeSender();
+        sender_thread_.join();
+    }
+    if (wake_fd_ >= 0) {
+        close(wake_fd_);
+        wake_fd_ = -1;
+    }
+    closeSocket();
+    queue_.Clear();
+}
+
+void SocketClient::closeSocket() {
+    connected_ = false;
     if (sock_ >= 0) {
         close(sock_);
         sock_ = -1;
     }
+    in_flight_.packet.payload.reset();
+    in_flight_.iovcnt = 0;
+    for (Stripe &stripe : stripes_) {
+        close(stripe.sock);
+    }
+    stripes_.clear();
 }
 
-bool SocketClient::ConnectToServer() {
-    Close();
+// Attend un evenement sur fd, ou un reveil de Close() (@return false dans ce cas)
+bool SocketClient::waitFd(int fd, short events, int timeout_ms) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+    while (!sender_stop_) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) return false;
+
+        pollfd fds[2] = {{fd, events, 0}, {wake_fd_, POLLIN, 0}};
+        int r = poll(fds, 2, (int)left);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) return false;
+        if (fds[0].revents) return true;
+        if (fds[1].revents & POLLIN) {
+            // Reveil pour une frame : sans interet pendant la connexion, on draine
+            uint64_t count;
+            ssize_t ignored = read(wake_fd_, &count, sizeof(count));
+            (void)ignored;
+        }
+    }
+    return false;
+}
 
-    sock_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock_ < 0) {
+bool SocketClient::connectSocket() {
+    closeSocket();
+    sock_ = openSocket();
+    return sock_ >= 0;
+}
+
+int SocketClient::openSocket() {
+    int type = (transport_ == TRANSPORT_UDP) ? SOCK_DGRAM : SOCK_STREAM;
+    int sock = socket(AF_INET, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
         LOGE("socket() failed errno=%d", errno);
-        return false;
+        return -1;
     }
 
     sockaddr_in addr{};
@@ -44,79 +132,756 @@ bool SocketClient::ConnectToServer() {
 
     if (inet_pton(AF_INET, host_.c_str(), &addr.sin_addr) != 1) {
         LOGE("inet_pton failed for %s", host_.c_str());
-        Close();
-        return false;
+        close(sock);
+        return -1;
     }
 
-    if (connect(sock_, (sockaddr*)&addr, sizeof(addr)) < 0) {
-        LOGE("connect() failed errno=%d", errno);
-        Close();
+    // connect() non bloquant : un serveur injoignable ne bloque pas Close()
+    if (connect(sock, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        int err = errno;
+        if (err == EINPROGRESS && waitFd(sock, POLLOUT, CONNECT_TIMEOUT_MS)) {
+            socklen_t len = sizeof(err);
+            getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len);
+        } else if (err == EINPROGRESS) {
+            err = ETIMEDOUT;
+        }
+        if (err != 0) {
+            LOGE("connect() failed errno=%d", err);
+            close(sock);
+            return -1;
+        }
+    }
+
+    // UDP : connect() fixe juste la destination (et remonte les ICMP en ECONNREFUSED)
+    if (transport_ == TRANSPORT_UDP) return sock;
+
+    // Header + payload partent deja en un seul appel : Nagle ne ferait que retarder la frame
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    // Un petit buffer noyau borne mecaniquement le nombre de frames en vol
+    if (budget_.sndbuf_bytes > 0) {
+        setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &budget_.sndbuf_bytes, sizeof(budget_.sndbuf_bytes));
+    }
+    return sock;
+}
+
+bool SocketClient::connectOnce() {
+    if (!connectSocket()) return false;
+    stream_id_ = std::random_device{}();
+
+    // Pas de negociation en UDP : le recepteur datagramme est forcement v2
+    if (transport_ == TRANSPORT_UDP) {
+        proto_version_ = 2;
+        caps_ = CAP_REPEAT;
+        LOGI("Streaming to %s:%d (UDP, protocol v2)", host_.c_str(), port_);
+        return true;
+    }
+
+    if (negotiate(sock_, 0)) {
+        proto_version_ = 2;
+        LOGI("Connected to %s:%d (protocol v2, caps=0x%x)", host_.c_str(), port_, caps_.load());
+        if (transport_ == TRANSPORT_TCP_STRIPED) connectStripes();
+        return true;
+    }
+    if (sender_stop_) return false;
+
+    // Serveur legacy : il ferme la connexion en recevant un type inconnu,
+    // on se reconnecte en v1
+    proto_version_ = 1;
+    caps_ = 0;
+    if (!connectSocket()) return false;
+    LOGI("Connected to %s:%d (protocol v1)", host_.c_str(), port_);
+    return true;
+}
+
+bool SocketClient::negotiate(int sock, uint8_t stripe_index) {
+    HelloPayload hello{};
+    hello.caps = CAP_REPEAT | CAP_CONTROL | CAP_ANALYSIS | CAP_RESULTS | CAP_ORIENTATION |
+                 (want_checksum_ ? CAP_CHECKSUM : 0u);
+
+    FrameHeaderV2 hdr;
+    iovec iov[4] = {{&hdr, sizeof(hdr)}, {&hello, sizeof(hello)}};
+    int count = 2;
+    uint32_t payload_len = sizeof(hello);
+
+    StripeHello stripe{};
+    if (transport_ == TRANSPORT_TCP_STRIPED) {
+        hello.caps |= CAP_STRIPED;
+        stripe.stream_id = stream_id_;
+        stripe.stripe_index = stripe_index;
+        stripe.stripe_count = (uint8_t)std::min(stripe_count_, MAX_STRIPES);
+        iov[count++] = {&stripe, sizeof(stripe)};
+        payload_len += sizeof(stripe);
+    }
+    DeviceHello device{device_id_};
+    if (device_id_ != 0) {
+        hello.caps |= CAP_DEVICE_ID;
+        iov[count++] = {&device, sizeof(device)};
+        payload_len += sizeof(device);
+    }
+
+    InitHeaderV2(&hdr, MSG_HELLO, payload_len);
+    if (!sendv(sock, iov, count, HELLO_TIMEOUT_MS)) return false;
+
+    FrameHeaderV2 ack;
+    if (!recvAll(sock, &ack, sizeof(ack), HELLO_TIMEOUT_MS)) return false;
+    if (!IsValidHeaderV2(&ack) || ack.type != MSG_HELLO_ACK ||
+        ack.payload_len < sizeof(HelloPayload)) {
+        LOGE("negotiate: unexpected reply type=%d", ack.type);
         return false;
     }
 
-    LOGI("Connected to %s:%d", host_.c_str(), port_);
+    std::vector<uint8_t> payload(ack.payload_len);
+    if (!recvAll(sock, payload.data(), payload.size(), HELLO_TIMEOUT_MS)) return false;
+
+    HelloPayload accepted;
+    memcpy(&accepted, payload.data(), sizeof(accepted));
+    if (stripe_index == 0) {
+        caps_ = accepted.caps & hello.caps;
+    }
+    return stripe_index == 0 || (accepted.caps & CAP_STRIPED);
+}
+
+void SocketClient::connectStripes() {
+    if (!(caps_ & CAP_STRIPED)) {
+        LOGI("Server does not accept striping, using a single connection");
+        return;
+    }
+
+    int count = std::min(stripe_count_, MAX_STRIPES);
+    for (int i = 1; i < count && !sender_stop_; i++) {
+        Stripe stripe;
+        stripe.sock = openSocket();
+        if (stripe.sock < 0 || !negotiate(stripe.sock, (uint8_t)i)) {
+            // Les voies deja ouvertes suffisent a faire passer le flux
+            if (stripe.sock >= 0) close(stripe.sock);
+            LOGE("Stripe %d failed, streaming over %d connection(s)", i, (int)stripes_.size() + 1);
+            return;
+        }
+        stripes_.push_back(stripe);
+    }
+    LOGI("Striped stream 0x%x over %d connections", stream_id_, (int)stripes_.size() + 1);
+}
+
+bool SocketClient::recvAll(int sock, void* data, size_t len, int timeout_ms) {
+    uint8_t* p = reinterpret_cast<uint8_t*>(data);
+    size_t got = 0;
+
+    while (got < len) {
+        ssize_t n = recv(sock, p + got, len - got, MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!waitFd(sock, POLLIN, timeout_ms)) return false;
+            continue;
+        }
+        if (n <= 0) return false;
+        got += (size_t)n;
+    }
     return true;
 }
 
-bool SocketClient::sendAll(const void* data, size_t len) {
-    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
-    size_t sent = 0;
-    while (sent < len) {
-        ssize_t n = send(sock_, p + sent, len - sent, 0);
+// Envoi scatter/gather avec attente, utilise seulement pendant la negociation.
+// Les envois partiels reprennent la ou le noyau s'est arrete (iov modifies en place).
+bool SocketClient::sendv(int sock, struct iovec* iov, int iovcnt, int timeout_ms) {
+    while (iovcnt > 0) {
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+
+        ssize_t n = sendmsg(sock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!waitFd(sock, POLLOUT, timeout_ms)) return false;
+            continue;
+        }
         if (n <= 0) {
-            LOGE("send() failed errno=%d", errno);
+            LOGE("sendmsg() failed errno=%d", errno);
             return false;
         }
-        sent += (size_t)n;
+
+        size_t sent = (size_t)n;
+        while (iovcnt > 0 && sent >= iov->iov_len) {
+            sent -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = reinterpret_cast<uint8_t*>(iov->iov_base) + sent;
+            iov->iov_len -= sent;
+        }
     }
     return true;
 }
 
-// Petit protocole : on envoie un header 1 octet type + payload
-// type=1 -> dims (int32 w, int32 h)
-// type=2 -> jpeg (int32 size + bytes)
-bool SocketClient::SendImageDims(int width, int height) {
-    if (sock_ < 0) return false;
+Frame_Packet SocketClient::makePacket(uint8_t type, uint16_t flags, uint64_t capture_ts_us,
+                                      int width, int height, uint8_t codec,
+                                      std::shared_ptr<const std::vector<uint8_t>> payload) {
+    Frame_Packet packet;
+    size_t len = payload ? payload->size() : 0;
+
+    InitHeaderV2(&packet.header, type, (uint32_t)len);
+    packet.header.flags = flags;
+    // Seules les frames (jpeg ou repeat) consomment un numero de sequence
+    packet.header.sequence = (type == MSG_JPEG || type == MSG_REPEAT) ? sequence_++ : 0;
+    packet.header.capture_ts_us = capture_ts_us;
+    packet.header.width = (uint16_t)width;
+    packet.header.height = (uint16_t)height;
+    packet.header.codec = codec;
+    if (proto_version_ >= 2 && want_checksum_ && (caps_ & CAP_CHECKSUM) && len > 0) {
+        packet.header.flags |= FLAG_CHECKSUM;
+        packet.header.checksum = Crc32(payload->data(), len);
+    }
+    packet.payload = std::move(payload);
+    return packet;
+}
 
-    uint8_t type = 1;
-    int32_t w = width;
-    int32_t h = height;
+void SocketClient::wakeSender() {
+    if (wake_fd_ >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wake_fd_, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+void SocketClient::prepareInFlight(In_Flight &f, Frame_Packet packet) {
+    f.packet = std::move(packet);
+    if (f.packet.header.type == MSG_PONG) {
+        // t2 au plus pres de l'envoi : le temps passe en file est compte cote device
+        f.packet.header.capture_ts_us = ProtoClockMicros();
+    }
+    const FrameHeaderV2 &hdr = f.packet.header;
+    size_t hdr_len;
 
-    if (!sendAll(&type, 1)) return false;
-    if (!sendAll(&w, sizeof(w))) return false;
-    if (!sendAll(&h, sizeof(h))) return false;
+    if (proto_version_ >= 2) {
+        memcpy(f.wire_header, &hdr, sizeof(hdr));
+        hdr_len = sizeof(hdr);
+    } else {
+        // Petit protocole v1 : un header 1 octet type + payload
+        // type=1 -> dims (int32 w, int32 h)
+        // type=2 -> jpeg (int32 size + bytes)
+        // type=3 -> repeat (pas de payload : le serveur re-sert son dernier JPEG)
+        uint8_t *legacy = f.wire_header;
+        legacy[0] = hdr.type;
+        hdr_len = 1;
+        if (hdr.type == MSG_DIMS) {
+            int32_t w = hdr.width;
+            int32_t h = hdr.height;
+            memcpy(legacy + 1, &w, sizeof(w));
+            memcpy(legacy + 5, &h, sizeof(h));
+            hdr_len = 9;
+        } else if (hdr.type == MSG_JPEG) {
+            int32_t size = (int32_t)hdr.payload_len;
+            memcpy(legacy + 1, &size, sizeof(size));
+            hdr_len = 5;
+        }
+    }
+
+    f.iov[0].iov_base = f.wire_header;
+    f.iov[0].iov_len = hdr_len;
+    f.iov_index = 0;
+    f.iovcnt = 1;
+    if (hdr.payload_len > 0) {
+        f.iov[1].iov_base = const_cast<uint8_t *>(f.packet.payload->data());
+        f.iov[1].iov_len = hdr.payload_len;
+        f.iovcnt = 2;
+    }
+}
+
+bool SocketClient::writeInFlight(In_Flight &f, int sock) {
+    while (f.iov_index < f.iovcnt) {
+        msghdr msg{};
+        msg.msg_iov = &f.iov[f.iov_index];
+        msg.msg_iovlen = f.iovcnt - f.iov_index;
+
+        ssize_t n = sendmsg(sock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;  // POLLOUT plus tard
+        if (n <= 0) {
+            LOGE("sendmsg() failed errno=%d", errno);
+            return false;
+        }
+        bytes_sent_ += (uint64_t)n;
+        session_bytes_ += (uint64_t)n;
+
+        // Avance dans les iovec sans rien recopier
+        size_t sent = (size_t)n;
+        while (f.iov_index < f.iovcnt && sent >= f.iov[f.iov_index].iov_len) {
+            sent -= f.iov[f.iov_index].iov_len;
+            f.iov_index++;
+        }
+        if (f.iov_index < f.iovcnt) {
+            f.iov[f.iov_index].iov_base = reinterpret_cast<uint8_t *>(f.iov[f.iov_index].iov_base) + sent;
+            f.iov[f.iov_index].iov_len -= sent;
+        }
+    }
+
+    countSent(f.packet.header.type);
+    f.packet.payload.reset();
+    f.iovcnt = 0;
     return true;
 }
 
-bool SocketClient::SendImage(const cv::Mat& img) {
-    if (sock_ < 0) return false;
-    if (img.empty()) return false;
+void SocketClient::countSent(uint8_t type) {
+    if (type != MSG_JPEG && type != MSG_REPEAT) return;
 
-    cv::Mat bgr;
+    uint64_t sent = ++frames_sent_;
+    if (sent % 300 == 0) {
+        LOGI("SocketClient: %llu frames sent, %llu dropped before send, %llu skipped (backlog), %llu bytes",
+             (unsigned long long)sent, (unsigned long long)queue_.Dropped(),
+             (unsigned long long)frames_skipped_.load(), (unsigned long long)bytes_sent_.load());
+    }
+}
 
-    // Tes frames dans CV_Manager sont souvent en CV_8UC4 (RGBA)
-    if (img.type() == CV_8UC4) {
-        cv::cvtColor(img, bgr, cv::COLOR_RGBA2BGR);
-    } else if (img.type() == CV_8UC3) {
-        bgr = img;
-    } else {
-        LOGE("SendImage: unsupported mat type=%d", img.type());
-        return false;
+void SocketClient::sleepInterruptible(int ms) {
+    pollfd pfd{wake_fd_, POLLIN, 0};
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+    while (!sender_stop_) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) return;
+        if (poll(&pfd, 1, (int)left) > 0) {
+            uint64_t count;
+            ssize_t ignored = read(wake_fd_, &count, sizeof(count));
+            (void)ignored;
+        }
     }
+}
+
+void SocketClient::transportLoop() {
+    LOGI("SocketClient transport thread started");
+    std::minstd_rand rng((unsigned)std::chrono::steady_clock::now().time_since_epoch().count());
+    int backoff_ms = RECONNECT_MIN_MS;
+    bool first = true;
 
-    std::vector<uchar> jpeg;
-    std::vector<int> params = { cv::IMWRITE_JPEG_QUALITY, 80 };
-    if (!cv::imencode(".jpg", bgr, jpeg, params)) {
-        LOGE("imencode jpg failed");
+    while (!sender_stop_) {
+        auto t0 = std::chrono::steady_clock::now();
+        if (!connectOnce()) {
+            // Jitter : attente tiree dans [backoff/2, backoff] pour que toute une
+            // flotte de telephones ne se reconnecte pas au meme instant
+            int wait_ms = backoff_ms / 2 + (int)(rng() % (unsigned)(backoff_ms / 2 + 1));
+            sleepInterruptible(wait_ms);
+            backoff_ms = std::min(backoff_ms * 2, RECONNECT_MAX_MS);
+            continue;
+        }
+        backoff_ms = RECONNECT_MIN_MS;
+
+        // Reprise de session : rien de l'ancienne session ne doit partir (un repeat
+        // designerait un JPEG que le serveur n'a peut-etre plus), on renvoie les
+        // parametres du flux puis on reclame une keyframe au thread camera
+        queue_.Clear();
+        if (dims_width_ > 0 && dims_height_ > 0) {
+            queue_.PushControl(makePacket(MSG_DIMS, 0, 0, dims_width_, dims_height_,
+                                          CODEC_NONE, nullptr));
+        }
+        rx_buf_.clear();
+        {
+            // L'etat pilote par le serveur (pause, ROI, qualite, taille) appartient a
+            // l'ancienne session : le nouveau serveur repart des valeurs par defaut
+            std::lock_guard<std::mutex> lock(control_mutex_);
+            control_ = Stream_Control{};
+            server_load_ = Server_Load{};
+            results_ready_ = false;
+        }
+        dispatch_seq_ = 0;
+        last_frame_bytes_ = 0;
+        keyframe_requested_ = true;
+        connected_ = true;
+
+        if (!first) {
+            reconnections_++;
+            LOGI("SocketClient: session resumed in %lld ms",
+                 (long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::steady_clock::now() - t0).count());
+        }
+        first = false;
+
+        if (transport_ == TRANSPORT_UDP) {
+            runDatagramSession();
+        } else {
+            runSession();
+        }
+        closeSocket();
+    }
+
+    LOGI("SocketClient transport thread stopped");
+}
+
+bool SocketClient::overBudget() {
+    int outq = 0;
+    if (ioctl(sock_, SIOCOUTQ, &outq) < 0) return false;
+
+    // Debit mesure = octets sortis du buffer noyau par seconde. On ne le met a
+    // jour que si le lien etait occupe sur l'intervalle, sinon on mesurerait le
+    // debit de la camera et pas celui du reseau.
+    auto now = std::chrono::steady_clock::now();
+    uint64_t drained = session_bytes_ - (uint64_t)outq;
+    double dt = std::chrono::duration<double>(now - drained_last_t_).count();
+    if (dt >= 0.05) {
+        if (link_busy_ && drained > drained_last_) {
+            double rate = (double)(drained - drained_last_) / dt;
+            drain_rate_ = (drain_rate_ == 0.0) ? rate : 0.7 * drain_rate_ + 0.3 * rate;
+        }
+        drained_last_ = drained;
+        drained_last_t_ = now;
+        link_busy_ = outq > 0;
+    } else if (outq > 0) {
+        link_busy_ = true;
+    }
+
+    if (budget_.max_queue_ms <= 0 || outq == 0 || drain_rate_ == 0.0) return false;
+    double queued_ms = (double)outq * 1000.0 / drain_rate_;
+    return queued_ms > (double)budget_.max_queue_ms;
+}
+
+void SocketClient::runSession() {
+    session_bytes_ = 0;
+    drained_last_ = 0;
+    drained_last_t_ = std::chrono::steady_clock::now();
+    link_busy_ = false;
+    drain_rate_ = 0.0;
+
+    while (!sender_stop_) {
+        // Controle (dims, pong) toujours sur la voie 0, avant les frames
+        if (in_flight_.iovcnt == 0) {
+            Frame_Packet next;
+            if (queue_.PopControl(next)) prepareInFlight(in_flight_, std::move(next));
+        }
+        bool frames_waiting = !dispatchFrames() && !stripes_.empty();
+
+        // POLLIN : canal de retour (MSG_CONTROL / MSG_PING), et une lecture de
+        // 0 octet est le moyen le plus rapide de voir que le serveur a ferme
+        pollfd fds[2 + MAX_STRIPES];
+        int nfds = 2 + (int)stripes_.size();
+        fds[0] = {wake_fd_, POLLIN, 0};
+        fds[1] = {sock_, (short)(POLLIN | (in_flight_.iovcnt > 0 ? POLLOUT : 0)), 0};
+        for (size_t i = 0; i < stripes_.size(); i++) {
+            const Stripe &stripe = stripes_[i];
+            fds[2 + i] = {stripe.sock, (short)(POLLIN | (stripe.in_flight.iovcnt > 0 ? POLLOUT : 0)), 0};
+        }
+        // Une voie striee ne signale pas que son backlog est retombe : on repasse
+        // regulierement tant qu'une frame attend
+        int r = poll(fds, nfds, frames_waiting ? STRIPE_RETRY_MS : -1);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            LOGE("poll() failed errno=%d", errno);
+            return;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t count;
+            ssize_t ignored = read(wake_fd_, &count, sizeof(count));
+            (void)ignored;
+        }
+        for (int i = 1; i < nfds; i++) {
+            In_Flight &f = (i == 1) ? in_flight_ : stripes_[i - 2].in_flight;
+            if (fds[i].revents & (POLLERR | POLLNVAL)) {
+                LOGE("SocketClient: connection lost");
+                return;
+            }
+            if (fds[i].revents & (POLLIN | POLLHUP)) {
+                // Le serveur ne parle que sur la voie 0 ; ailleurs seule la fermeture compte
+                if (i == 1 ? !readIncoming() : !drainStripe(fds[i].fd)) return;
+            }
+            if ((fds[i].revents & POLLOUT) && !writeInFlight(f, fds[i].fd)) {
+                return;
+            }
+        }
+    }
+}
+
+bool SocketClient::dispatchFrames() {
+    bool striped = !stripes_.empty();
+
+    for (size_t lane = 0; lane <= stripes_.size(); lane++) {
+        In_Flight &f = (lane == 0) ? in_flight_ : stripes_[lane - 1].in_flight;
+        int sock = (lane == 0) ? sock_ : stripes_[lane - 1].sock;
+        if (f.iovcnt > 0 || (striped && !stripeReady(sock))) continue;
+
+        Frame_Packet next;
+        while (queue_.PopFrame(next)) {
+            if (!striped && next.header.type == MSG_JPEG && overBudget()) {
+                // Le reseau a deja plus de max_queue_ms de retard : envoyer cette
+                // frame ne ferait qu'ajouter de la latence. Le serveur ne l'a
+                // jamais vue, donc pas de repeat tant qu'une keyframe n'est pas partie.
+                frames_skipped_++;
+                keyframe_requested_ = true;
+                continue;
+            }
+            if (striped) {
+                // Renumerotee a l'envoi : le recepteur ne voit pas de trou pour les
+                // frames remplacees dans la file, il peut remettre l'ordre sans attendre
+                next.header.sequence = dispatch_seq_++;
+                last_frame_bytes_ = next.header.payload_len;
+            }
+            prepareInFlight(f, std::move(next));
+            break;
+        }
+        if (f.iovcnt == 0) return true;  // file vide
+    }
+    return !queue_.HasFrame();
+}
+
+bool SocketClient::stripeReady(int sock) {
+    int outq = 0;
+    if (ioctl(sock, SIOCOUTQ, &outq) < 0) return true;
+    // Plus d'une frame non acquittee : la voie subit des pertes (fenetre
+    // reduite), la frame suivante ira sur une autre
+    return (size_t)outq <= last_frame_bytes_;
+}
+
+bool SocketClient::drainStripe(int sock) {
+    uint8_t discard[256];
+    ssize_t n = recv(sock, discard, sizeof(discard), MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        LOGE("SocketClient: stripe closed by server");
         return false;
     }
+    return true;
+}
+
+bool SocketClient::readIncoming() {
+    uint8_t buf[4096];
+    for (;;) {
+        ssize_t n = recv(sock_, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) {
+            LOGE("SocketClient: connection closed by server");
+            return false;
+        }
+        rx_buf_.insert(rx_buf_.end(), buf, buf + n);
+    }
 
-    uint8_t type = 2;
-    int32_t size = (int32_t)jpeg.size();
+    // Un serveur v1 n'envoie jamais rien : seuls des messages v2 sont attendus
+    size_t off = 0;
+    while (rx_buf_.size() - off >= sizeof(FrameHeaderV2)) {
+        FrameHeaderV2 hdr;
+        memcpy(&hdr, rx_buf_.data() + off, sizeof(hdr));
+        if (!IsValidHeaderV2(&hdr)) {
+            LOGE("SocketClient: invalid message from server");
+            return false;
+        }
+        if (rx_buf_.size() - off - sizeof(hdr) < hdr.payload_len) break;  // payload incomplet
+        handleIncoming(hdr, rx_buf_.data() + off + sizeof(hdr));
+        off += sizeof(hdr) + hdr.payload_len;
+    }
+    rx_buf_.erase(rx_buf_.begin(), rx_buf_.begin() + (long)off);
+    return true;
+}
 
-    if (!sendAll(&type, 1)) return false;
-    if (!sendAll(&size, sizeof(size))) return false;
-    if (!sendAll(jpeg.data(), jpeg.size())) return false;
+void SocketClient::handleIncoming(const FrameHeaderV2 &hdr, const uint8_t *payload) {
+    if (hdr.type == MSG_CONTROL && hdr.payload_len >= sizeof(ControlPayload)) {
+        ControlPayload ctrl;
+        memcpy(&ctrl, payload, sizeof(ctrl));
+        applyControl(ctrl);
+    } else if (hdr.type == MSG_PING) {
+        // Repondu directement par le thread transport, sans attendre une frame
+        auto pong = std::make_shared<std::vector<uint8_t>>(sizeof(PongPayload));
+        PongPayload p{hdr.capture_ts_us, ProtoClockMicros()};
+        memcpy(pong->data(), &p, sizeof(p));
+        queue_.PushControl(makePacket(MSG_PONG, 0, 0, 0, 0, CODEC_NONE, std::move(pong)));
+    } else if (hdr.type == MSG_RESULTS && hdr.payload_len >= sizeof(Results_Header)) {
+        // Seuls les plus recents comptent : le thread camera les prend en debut de frame
+        std::lock_guard<std::mutex> lock(control_mutex_);
+        results_.sequence = hdr.sequence;
+        results_.capture_ts_us = hdr.capture_ts_us;
+        results_.width = hdr.width;
+        results_.height = hdr.height;
+        results_.payload.assign(payload, payload + hdr.payload_len);
+        results_ready_ = true;
+    } else {
+        LOGI("SocketClient: ignoring message type=%d from server", hdr.type);
+    }
+}
 
+void SocketClient::applyControl(const ControlPayload &ctrl) {
+    const int32_t *a = ctrl.args;
+    std::lock_guard<std::mutex> lock(control_mutex_);
+
+    // Simple mesure, ne change pas l'image servie : ni log ni keyframe
+    if (ctrl.command == CTRL_SERVER_LOAD) {
+        server_load_.analysis_us = (uint32_t)std::max(0, (int)a[0]);
+        server_load_.queued = (uint32_t)std::max(0, (int)a[1]);
+        server_load_.rtt_us = (uint32_t)std::max(0, (int)a[2]);
+        server_load_.updated_us = ProtoClockMicros();
+        return;
+    }
+
+    switch (ctrl.command) {
+        case CTRL_SET_QUALITY:
+            control_.jpeg_quality = std::max(1, std::min(100, (int)a[0]));
+            break;
+        case CTRL_SET_BITRATE:
+            control_.bitrate_kbps = std::max(0, (int)a[0]);
+            break;
+        case CTRL_SET_SIZE:
+            control_.width = std::max(0, (int)a[0]);
+            control_.height = std::max(0, (int)a[1]);
+            break;
+        case CTRL_REQUEST_REFRESH:
+            break;
+        case CTRL_SET_ROI:
+            control_.roi = (a[2] > 0 && a[3] > 0) ? Stream_Rect{a[0], a[1], a[2], a[3]} : Stream_Rect();
+            break;
+        case CTRL_PAUSE:
+            control_.paused = a[0] != 0;
+            break;
+        default:
+            LOGE("SocketClient: unknown control command %d", ctrl.command);
+            return;
+    }
+    LOGI("SocketClient: control cmd=%d args=%d,%d,%d,%d", ctrl.command, a[0], a[1], a[2], a[3]);
+
+    // Toute commande change l'image servie : le dernier JPEG du serveur ne peut
+    // plus etre repete
+    keyframe_requested_ = true;
+}
+
+Stream_Control SocketClient::Control() {
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    return control_;
+}
+
+Server_Load SocketClient::ServerLoad() {
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    return server_load_;
+}
+
+bool SocketClient::TakeResults(Frame_Results &out) {
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    if (!results_ready_) return false;
+    out.sequence = results_.sequence;
+    out.capture_ts_us = results_.capture_ts_us;
+    out.width = results_.width;
+    out.height = results_.height;
+    out.payload.swap(results_.payload);
+    results_ready_ = false;
+    return true;
+}
+
+int SocketClient::EncodeQuality(int max_quality) {
+    Stream_Control ctrl = Control();
+    quality_cap_ = std::min(max_quality, ctrl.jpeg_quality);
+    if (ctrl.bitrate_kbps <= 0) effective_quality_ = quality_cap_;
+    return std::min(effective_quality_, quality_cap_);
+}
+
+void SocketClient::adaptQuality(size_t encoded_bytes) {
+    Stream_Control ctrl = Control();
+    auto now = std::chrono::steady_clock::now();
+    double dt = std::chrono::duration<double>(now - last_encode_t_).count();
+    last_encode_t_ = now;
+
+    if (ctrl.bitrate_kbps <= 0) {
+        encoded_bps_ = 0.0;
+        return;
+    }
+    if (dt <= 0.0 || dt > 1.0) return;  // premiere frame ou reprise apres pause
+
+    double bps = (double)encoded_bytes * 8.0 / dt;
+    encoded_bps_ = (encoded_bps_ == 0.0) ? bps : 0.8 * encoded_bps_ + 0.2 * bps;
+
+    // Descente rapide, remontee lente : on evite d'osciller autour de la cible
+    double target = ctrl.bitrate_kbps * 1000.0;
+    if (encoded_bps_ > target * 1.05) {
+        effective_quality_ -= (encoded_bps_ > target * 1.5) ? 5 : 1;
+    } else if (encoded_bps_ < target * 0.85) {
+        effective_quality_ += 1;
+    }
+    effective_quality_ = std::max(MIN_JPEG_QUALITY, std::min(quality_cap_, effective_quality_));
+}
+
+void SocketClient::runDatagramSession() {
+    while (!sender_stop_) {
+        Frame_Packet next;
+        if (!queue_.Pop(next)) {
+            pollfd pfd{wake_fd_, POLLIN, 0};
+            if (poll(&pfd, 1, -1) > 0) {
+                uint64_t count;
+                ssize_t ignored = read(wake_fd_, &count, sizeof(count));
+                (void)ignored;
+            }
+            continue;
+        }
+
+        const uint8_t *payload = next.payload ? next.payload->data() : nullptr;
+        if (!udp_.SendMessage(sock_, next.header, payload, wake_fd_, sender_stop_)) {
+            return;
+        }
+        bytes_sent_ += sizeof(FrameHeaderV2) + next.header.payload_len;
+        countSent(next.header.type);
+    }
+}
+
+bool SocketClient::SendImageDims(int width, int height) {
+    dims_width_ = width;
+    dims_height_ = height;
+    if (!connected_) return false;  // sera envoye a la connexion
+
+    queue_.PushControl(makePacket(MSG_DIMS, 0, 0, width, height, CODEC_NONE, nullptr));
+    wakeSender();
+    return true;
+}
+
+bool SocketClient::SendEncoded(std::shared_ptr<const std::vector<uint8_t>> payload, int width,
+                               int height, uint8_t codec, uint64_t capture_ts_us, bool analyze,
+                               uint8_t sharpness, uint8_t orientation) {
+    if (!connected_ || !payload) return false;
+    // Le protocole v1 ne connait que le JPEG
+    if (codec != CODEC_JPEG && proto_version_ < 2) return false;
+
+    if (codec == CODEC_JPEG) adaptQuality(payload->size());
+    // Serveur qui ignore l'octet orientation (v1, UDP sans negociation, ancien v2) :
+    // le redressement part en tag EXIF dans le JPEG, pixels intacts
+    if (codec == CODEC_JPEG && orientation != 0 && !(caps_ & CAP_ORIENTATION)) {
+        std::string prefix;
+        size_t skip = JpegOrientationPrefix(payload->data(), payload->size(), orientation, prefix);
+        if (!prefix.empty()) {
+            auto tagged = std::make_shared<std::vector<uint8_t>>();
+            tagged->reserve(prefix.size() + payload->size() - skip);
+            tagged->insert(tagged->end(), prefix.begin(), prefix.end());
+            tagged->insert(tagged->end(), payload->begin() + skip, payload->end());
+            payload = std::move(tagged);
+            orientation = 0;
+        }
+    }
+
+    uint16_t flags = FLAG_KEYFRAME | ((analyze && (caps_ & CAP_ANALYSIS)) ? FLAG_ANALYZE : 0);
+    Frame_Packet packet = makePacket(MSG_JPEG, flags, capture_ts_us, width, height, codec,
+                                     std::move(payload));
+    packet.header.sharpness = sharpness;
+    packet.header.orientation = orientation;
+    frame_sequence_ = packet.header.sequence;
+    if (!queue_.PushFrame(std::move(packet)) &&
+        queue_.Policy() == DROP_NEWEST) {
+        // Frame refusee : le serveur ne l'aura jamais, un repeat designerait une image plus ancienne
+        keyframe_requested_ = true;
+    }
+    wakeSender();
+    return true;
+}
+
+bool SocketClient::SendResults(std::shared_ptr<const std::vector<uint8_t>> payload, int width,
+                               int height, uint64_t capture_ts_us) {
+    if (!connected_ || !payload || !(caps_ & CAP_RESULTS)) return false;
+
+    // File de controle : jamais sacrifie a une frame, quelques centaines d'octets
+    Frame_Packet packet = makePacket(MSG_RESULTS, 0, capture_ts_us, width, height, CODEC_NONE,
+                                     std::move(payload));
+    packet.header.sequence = frame_sequence_;
+    queue_.PushControl(std::move(packet));
+    wakeSender();
+    return true;
+}
+
+bool SocketClient::SendRepeat(uint64_t capture_ts_us) {
+    if (!connected_ || keyframe_requested_) return false;
+    // Un serveur qui n'a pas annonce CAP_REPEAT fermerait la connexion : sans
+    // nouvelle frame il continue de toute facon a servir la derniere recue
+    if (proto_version_ < 2 || !(caps_ & CAP_REPEAT)) return false;
+
+    queue_.PushFrame(makePacket(MSG_REPEAT, 0, capture_ts_us, 0, 0, CODEC_NONE, nullptr));
+    wakeSender();
     return true;
-}
\ No newline at end of file
+}
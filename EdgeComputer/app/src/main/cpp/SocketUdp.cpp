@@ -0,0 +1,159 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/SocketUdp.h"
+#include "headers/Util.h"
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <cstring>
+
+// Rafale max autorisee par le pacing, en datagrammes
+#define PACING_BURST_DATAGRAMS 8
+
+DatagramSender::DatagramSender(int mtu, int fec_group, uint64_t pacing_bps)
+        : frag_size_(mtu - (int)sizeof(DatagramHeader)),
+          fec_group_(std::max(0, std::min(fec_group, 255))),
+          pacing_bps_(pacing_bps),
+          parity_(mtu - sizeof(DatagramHeader), 0),
+          rng_((unsigned)std::chrono::steady_clock::now().time_since_epoch().count()) {
+    burst_bytes_ = (double)PACING_BURST_DATAGRAMS * mtu;
+    tokens_ = burst_bytes_;
+    last_refill_ = std::chrono::steady_clock::now();
+}
+
+bool DatagramSender::pace(size_t bytes, int wake_fd, const std::atomic_bool &stop) {
+    if (pacing_bps_ == 0) return true;
+
+    while (!stop) {
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - last_refill_).count();
+        last_refill_ = now;
+        tokens_ = std::min(burst_bytes_, tokens_ + elapsed * (double)pacing_bps_ / 8.0);
+        if (tokens_ >= (double)bytes) {
+            tokens_ -= (double)bytes;
+            return true;
+        }
+
+        // Attente precise (ppoll a une resolution ns) mais interruptible par Close()
+        double wait_s = ((double)bytes - tokens_) * 8.0 / (double)pacing_bps_;
+        timespec ts{(time_t)wait_s, (long)((wait_s - (double)(time_t)wait_s) * 1e9)};
+        pollfd pfd{wake_fd, POLLIN, 0};
+        if (ppoll(&pfd, 1, &ts, nullptr) > 0 && (pfd.revents & POLLIN)) {
+            uint64_t count;
+            ssize_t ignored = read(wake_fd, &count, sizeof(count));
+            (void)ignored;
+        }
+    }
+    return false;
+}
+
+bool DatagramSender::sendDatagram(int sock, DatagramHeader &dh,
+                                  const uint8_t *part1, size_t len1,
+                                  const uint8_t *part2, size_t len2,
+                                  int wake_fd, const std::atomic_bool &stop) {
+    size_t total = sizeof(dh) + len1 + len2;
+    if (!pace(total, wake_fd, stop)) return false;
+
+    if (loss_rate_ > 0.0 &&
+        std::uniform_real_distribution<double>(0.0, 1.0)(rng_) < loss_rate_) {
+        return true;  // perdu "sur le reseau"
+    }
+
+    iovec iov[3] = {{&dh, sizeof(dh)},
+                    {const_cast<uint8_t *>(part1), len1},
+                    {const_cast<uint8_t *>(part2), len2}};
+    msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = len2 > 0 ? 3 : 2;
+
+    while (!stop) {
+        ssize_t n = sendmsg(sock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n >= 0) {
+            datagrams_sent_++;
+            return true;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+            pollfd fds[2] = {{sock, POLLOUT, 0}, {wake_fd, POLLIN, 0}};
+            poll(fds, 2, 10);
+            continue;
+        }
+        // ECONNREFUSED : ICMP port unreachable, le recepteur n'ecoute pas (ou plus)
+        LOGE("DatagramSender: sendmsg() failed errno=%d", errno);
+        return false;
+    }
+    return false;
+}
+
+bool DatagramSender::SendMessage(int sock, const FrameHeaderV2 &hdr, const uint8_t *payload,
+                                 int wake_fd, const std::atomic_bool &stop) {
+    // Message "virtuel" = header v2 puis payload : les fragments sont des tranches
+    // de ces deux buffers, rien n'est recopie (sauf la parite)
+    const uint8_t *head = reinterpret_cast<const uint8_t *>(&hdr);
+    const size_t head_len = sizeof(hdr);
+    const size_t total = head_len + hdr.payload_len;
+    const size_t frag = (size_t)frag_size_;
+    const size_t count = (total + frag - 1) / frag;
+    if (count > 0xFFFF) {
+        LOGE("DatagramSender: message too large (%zu bytes)", total);
+        return true;  // on jette le message, la connexion reste valide
+    }
+
+    DatagramHeader dh{};
+    dh.magic = DGRAM_MAGIC;
+    dh.fec_group = (uint8_t)fec_group_;
+    dh.frag_count = (uint16_t)count;
+    dh.frag_size = (uint16_t)frag;
+    dh.message_id = message_id_++;
+    dh.message_len = (uint32_t)total;
+
+    // Un envoi interrompu (erreur, arret) laisse un groupe a moitie XORe : parite
+    // repartie de zero a chaque message, sinon elle corromprait une reconstruction
+    std::fill(parity_.begin(), parity_.end(), 0);
+
+    for (size_t i = 0; i < count; i++) {
+        size_t off = i * frag;
+        size_t len = std::min(frag, total - off);
+
+        const uint8_t *p1;
+        size_t l1;
+        const uint8_t *p2 = nullptr;
+        size_t l2 = 0;
+        if (off < head_len) {
+            p1 = head + off;
+            l1 = std::min(len, head_len - off);
+            p2 = payload;
+            l2 = len - l1;
+        } else {
+            p1 = payload + (off - head_len);
+            l1 = len;
+        }
+
+        dh.kind = DGRAM_DATA;
+        dh.frag_index = (uint16_t)i;
+        if (!sendDatagram(sock, dh, p1, l1, p2, l2, wake_fd, stop)) return false;
+
+        if (fec_group_ == 0) continue;
+
+        for (size_t k = 0; k < l1; k++) parity_[k] ^= p1[k];
+        for (size_t k = 0; k < l2; k++) parity_[l1 + k] ^= p2[k];
+
+        bool group_end = (i % fec_group_ == (size_t)fec_group_ - 1) || i == count - 1;
+        if (group_end) {
+            dh.kind = DGRAM_PARITY;
+            dh.frag_index = (uint16_t)(i / fec_group_);
+            if (!sendDatagram(sock, dh, parity_.data(), frag, nullptr, 0, wake_fd, stop)) {
+                return false;
+            }
+            std::fill(parity_.begin(), parity_.end(), 0);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,269 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Transmit_Stage.h"
+#include "headers/Protocol.h"
+#include "headers/Util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+// Plus petite des deux limites, 0 = pas de limite
+static int minLimit(int a, int b) {
+    return (a > 0 && b > 0) ? std::min(a, b) : std::max(a, b);
+}
+
+// Objets de l'image entiere ramenes a une frame envoyee : decoupe roi, puis taille size
+static std::vector<uint8_t> mapResults(const std::vector<uint8_t> &payload, const cv::Rect &roi,
+                                       const cv::Size &size) {
+    std::vector<uint8_t> mapped(payload);
+    const Results_Header *header;
+    const Result_Object *objects;
+    const char *text;
+    if (!ParseResults(mapped.data(), mapped.size(), &header, &objects, &text)) return mapped;
+
+    double sx = (double)size.width / roi.width;
+    double sy = (double)size.height / roi.height;
+    auto mapX = [&](int x) { return (int16_t)cvRound((x - roi.x) * sx); };
+    auto mapY = [&](int y) { return (int16_t)cvRound((y - roi.y) * sy); };
+    uint8_t *at = mapped.data() + sizeof(Results_Header);
+    for (uint16_t i = 0; i < header->count; i++, at += sizeof(Result_Object)) {
+        // Payload packe : pas d'acces direct aux champs
+        Result_Object o;
+        memcpy(&o, at, sizeof(o));
+        o.box[0] = mapX(o.box[0]);
+        o.box[1] = mapY(o.box[1]);
+        o.box[2] = (int16_t)cvRound(o.box[2] * sx);
+        o.box[3] = (int16_t)cvRound(o.box[3] * sy);
+        for (int p = 0; p < o.point_count && p < RESULT_MAX_POINTS; p++) {
+            o.polygon[p][0] = mapX(o.polygon[p][0]);
+            o.polygon[p][1] = mapY(o.polygon[p][1]);
+        }
+        memcpy(at, &o, sizeof(o));
+    }
+    return mapped;
+}
+
+Transmit_Stage::~Transmit_Stage() {
+    Close();
+    for (Destination &dest : destinations_) {
+        delete dest.client;
+    }
+    destinations_.clear();
+}
+
+SocketClient *Transmit_Stage::AddDestination(const std::string &host, int port,
+                                             const Encode_Profile &profile,
+                                             size_t queue_capacity, drop_policy policy) {
+    Destination dest;
+    dest.client = new SocketClient(host, port, queue_capacity, policy);
+    dest.profile = profile;
+    destinations_.push_back(dest);
+    return dest.client;
+}
+
+void Transmit_Stage::Start() {
+    for (Destination &dest : destinations_) {
+        dest.client->Start();
+    }
+}
+
+void Transmit_Stage::Close() {
+    for (Destination &dest : destinations_) {
+        dest.client->Close();
+    }
+}
+
+void Transmit_Stage::SendImageDims(int width, int height) {
+    for (Destination &dest : destinations_) {
+        dest.client->SendImageDims(width, height);
+    }
+}
+
+bool Transmit_Stage::BeginFrame() {
+    bool any = false;
+    for (Destination &dest : destinations_) {
+        // Hors connexion (reconnexion en cours) ou en pause : rien a encoder pour elle
+        dest.active = dest.client->IsConnected();
+        if (dest.active) {
+            dest.control = dest.client->Control();
+            dest.active = !dest.control.paused;
+        }
+        any = any || dest.active;
+    }
+    return any;
+}
+
+bool Transmit_Stage::TakeKeyframeRequest() {
+    bool requested = false;
+    for (Destination &dest : destinations_) {
+        if (dest.active && dest.client->TakeKeyframeRequest()) {
+            requested = true;
+        }
+    }
+    return requested;
+}
+
+cv::Rect Transmit_Stage::CaptureRect(const cv::Size &frame_size) {
+    cv::Rect full(0, 0, frame_size.width, frame_size.height);
+    cv::Rect rect;
+
+    for (Destination &dest : destinations_) {
+        if (!dest.active) continue;
+        const Stream_Rect &r = dest.control.roi;
+        cv::Rect roi = cv::Rect(r.x, r.y, r.width, r.height) & full;
+        if (roi.area() == 0) return full;
+        rect = (rect.area() > 0) ? (rect | roi) : roi;
+    }
+    return rect.area() > 0 ? rect : full;
+}
+
+Transmit_Stage::Encode_Key Transmit_Stage::keyFor(Destination &dest, const cv::Mat &frame,
+                                                  const cv::Point &origin) {
+    const Stream_Control &ctrl = dest.control;
+    const Encode_Profile &profile = dest.profile;
+    Encode_Key key;
+
+    // ROI en coordonnees de la copie
+    cv::Rect full(0, 0, frame.cols, frame.rows);
+    cv::Rect roi = cv::Rect(ctrl.roi.x - origin.x, ctrl.roi.y - origin.y,
+                            ctrl.roi.width, ctrl.roi.height) & full;
+    key.roi = (roi.area() > 0) ? roi : full;
+
+    // Taille max : la plus petite du profil et du serveur, ratio conserve
+    int max_w = minLimit(profile.width, ctrl.width);
+    int max_h = minLimit(profile.height, ctrl.height);
+    double scale = 1.0;
+    if (max_w > 0) scale = std::min(scale, (double)max_w / key.roi.width);
+    if (max_h > 0) scale = std::min(scale, (double)max_h / key.roi.height);
+    key.width = std::max(1, (int)(key.roi.width * scale));
+    key.height = std::max(1, (int)(key.roi.height * scale));
+
+    key.luma_only = profile.luma_only;
+    key.raw = profile.raw;
+    key.quality = profile.raw ? 0 : dest.client->EncodeQuality(profile.jpeg_quality);
+    return key;
+}
+
+bool Transmit_Stage::encode(const cv::Mat &frame, const Encode_Key &key, Encoded &out) {
+    // Conversion + redimensionnement partages entre qualites / brut et JPEG
+    const cv::Mat *img = nullptr;
+    for (const auto &prepared : prepared_) {
+        if (prepared.first.sameImage(key)) {
+            img = &prepared.second;
+            break;
+        }
+    }
+    if (img == nullptr) {
+        cv::Mat converted;
+        cv::cvtColor(frame(key.roi), converted,
+                     key.luma_only ? cv::COLOR_RGBA2GRAY : cv::COLOR_RGBA2BGR);
+        if (converted.cols != key.width || converted.rows != key.height) {
+            cv::resize(converted, converted, cv::Size(key.width, key.height), 0, 0, cv::INTER_AREA);
+        }
+        prepared_.emplace_back(key, converted);
+        img = &prepared_.back().second;
+    }
+
+    auto bytes = std::make_shared<std::vector<uint8_t>>();
+    if (key.raw) {
+        cv::Mat contiguous = img->isContinuous() ? *img : img->clone();
+        bytes->assign(contiguous.data, contiguous.data + contiguous.total() * contiguous.elemSize());
+        out.codec = key.luma_only ? CODEC_RAW_GRAY : CODEC_RAW_BGR;
+    } else {
+        std::vector<int> params = { cv::IMWRITE_JPEG_QUALITY, key.quality };
+        if (!cv::imencode(".jpg", *img, *bytes, params)) {
+            LOGE("imencode jpg failed");
+            return false;
+        }
+        out.codec = CODEC_JPEG;
+    }
+
+    out.key = key;
+    out.payload = std::move(bytes);
+    out.width = img->cols;
+    out.height = img->rows;
+    return true;
+}
+
+SocketClient *Transmit_Stage::AnalysisServer() {
+    for (Destination &dest : destinations_) {
+        if (dest.active && dest.client->CanAnalyze()) {
+            return dest.client;
+        }
+    }
+    return nullptr;
+}
+
+void Transmit_Stage::SendFrame(const cv::Mat &frame, const cv::Point &origin,
+                               uint64_t capture_ts_us, bool analyze, uint8_t sharpness,
+                               uint8_t orientation) {
+    if (frame.empty() || frame.type() != CV_8UC4) {
+        LOGE("SendFrame: unsupported mat type=%d", frame.type());
+        return;
+    }
+    SocketClient *analyzer = analyze ? AnalysisServer() : nullptr;
+
+    for (Destination &dest : destinations_) {
+        dest.sent_roi = cv::Rect();
+        if (!dest.active) continue;
+
+        Encode_Key key = keyFor(dest, frame, origin);
+        const Encoded *enc = nullptr;
+        for (const Encoded &e : encoded_) {
+            if (e.key == key) {
+                enc = &e;
+                break;
+            }
+        }
+        if (enc == nullptr) {
+            Encoded e;
+            if (!encode(frame, key, e)) continue;
+            encoded_.push_back(std::move(e));
+            enc = &encoded_.back();
+        }
+        dest.client->SendEncoded(enc->payload, enc->width, enc->height, enc->codec, capture_ts_us,
+                                 dest.client == analyzer, sharpness, orientation);
+        dest.sent_roi = key.roi + origin;
+        dest.sent_size = cv::Size(enc->width, enc->height);
+    }
+
+    // Les files des destinations gardent leur reference sur les payloads
+    prepared_.clear();
+    encoded_.clear();
+}
+
+void Transmit_Stage::SendRepeat(uint64_t capture_ts_us) {
+    for (Destination &dest : destinations_) {
+        if (dest.active) {
+            dest.client->SendRepeat(capture_ts_us);
+        }
+    }
+}
+
+void Transmit_Stage::SendResults(std::vector<uint8_t> payload, uint64_t capture_ts_us) {
+    // Meme payload pour les destinations qui ont recu la meme frame, comme les frames encodees
+    struct Mapped {
+        cv::Rect roi;
+        cv::Size size;
+        std::shared_ptr<const std::vector<uint8_t>> payload;
+    };
+    std::vector<Mapped> mapped;
+    for (Destination &dest : destinations_) {
+        if (!dest.active || dest.sent_roi.empty()) continue;
+
+        std::shared_ptr<const std::vector<uint8_t>> shared;
+        for (const Mapped &m : mapped) {
+            if (m.roi == dest.sent_roi && m.size == dest.sent_size) shared = m.payload;
+        }
+        if (!shared) {
+            shared = std::make_shared<const std::vector<uint8_t>>(
+                    mapResults(payload, dest.sent_roi, dest.sent_size));
+            mapped.push_back({dest.sent_roi, dest.sent_size, shared});
+        }
+        dest.client->SendResults(shared, dest.sent_size.width, dest.sent_size.height, capture_ts_us);
+    }
+}
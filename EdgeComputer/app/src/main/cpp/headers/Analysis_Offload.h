@@ -0,0 +1,65 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_ANALYSIS_OFFLOAD_H
+#define EDGECOMPUTER_ANALYSIS_OFFLOAD_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "Protocol.h"
+#include "SocketTcp.h"
+
+/**
+ * Choisit ou tourne l'analyse (BarcodeDetect) : sur le device ou sur le
+ * serveur, et la deplace pendant le flux.
+ *
+ * Cout device = duree mesuree d'une analyse locale, majoree quand la batterie
+ * est basse (hors charge) ou que le telephone chauffe ; au-dela du statut
+ * thermique SEVERE, le device n'analyse plus du tout. Cout serveur = RTT +
+ * duree d'une analyse serveur, multipliee par sa file d'attente (les trois
+ * annonces par CTRL_SERVER_LOAD a chaque PING).
+ *
+ * Un changement de cote n'a lieu que si l'autre est nettement moins cher
+ * pendant un moment, et pas plus d'une fois par MIN_DWELL : pas
+ * d'oscillation autour de l'egalite. Chaque changement est logue avec les
+ * mesures qui l'ont decide. Quand le serveur analyse, une frame est encore
+ * analysee sur le device de temps en temps pour garder son cout a jour.
+ *
+ * Appele depuis le thread camera, sauf SetPowerState() (thread UI).
+ */
+class Analysis_Offload {
+public:
+    // @param thermal_status PowerManager.THERMAL_STATUS_* (0 = aucun ... 6 = arret)
+    void SetPowerState(int battery_pct, bool charging, int thermal_status);
+
+    // Cote de la frame courante ; server = nullptr si aucune destination ne peut analyser
+    analysis_site Decide(SocketClient *server, uint64_t now_us);
+
+    // true si la frame doit etre analysee sur le device : cote device, ou mesure periodique ;
+    // jamais au-dela du seuil thermique SEVERE
+    bool RunLocally(uint64_t now_us);
+
+    // Duree d'une analyse faite sur le device
+    void AddLocalCost(uint32_t cost_us);
+
+    analysis_site Site() const { return site_; }
+
+private:
+    // Multiplicateur du cout device selon batterie et temperature, 0 = interdit
+    double powerFactor() const;
+    void migrate(analysis_site to, const char *reason, const Server_Load &load, uint64_t now_us);
+
+    std::atomic_int battery_pct_{100};
+    std::atomic_bool charging_{true};
+    std::atomic_int thermal_status_{0};
+
+    analysis_site site_ = ANALYSIS_DEVICE;
+    double local_us_ = 0.0;        // moyenne glissante, 0 = jamais mesure
+    uint64_t migrated_us_ = 0;     // dernier changement de cote
+    uint64_t favored_since_ = 0;   // depuis quand l'autre cote est moins cher, 0 = il ne l'est pas
+    uint64_t last_probe_us_ = 0;
+};
+
+#endif //EDGECOMPUTER_ANALYSIS_OFFLOAD_H
@@ -12,7 +12,10 @@
 #include "Image_Reader.h"
 #include "Native_Camera.h"
 #include "Util.h"
-#include "SocketTcp.h"
+#include "Transmit_Stage.h"
+#include "Frame_Dedup.h"
+#include "Frame_Sharpness.h"
+#include "Analysis_Offload.h"
 #include <cstdlib>
 #include <string>
 #include <vector>
@@ -33,10 +36,15 @@ public:
 
     void SetUpCamera();
     void CameraLoop();
-    void BarcodeDetect(Mat &frame);
+    // @return true si un contour est trouve ; region = rectangle (oriente) du plus grand
+    bool BarcodeDetect(const Mat &frame, RotatedRect &region);
     void RunCV();
+    // Batterie et temperature, pour le choix du cote de l'analyse (thread UI)
+    void SetPowerState(int battery_pct, bool charging, int thermal_status);
+    // Identite du telephone annoncee aux serveurs, a fixer avant SetUpTCP()
+    void SetDeviceId(uint64_t device_id) { m_device_id = device_id; }
     void SetUpTCP();
-    void setSocketClient(SocketClient *client);
+    void setTransmitStage(Transmit_Stage *transmit);
     void HaltCamera();
     void FlipCamera();
     void ReleaseMats();
@@ -52,8 +60,9 @@ private:
     volatile bool m_camera_ready;
     clock_t start_t, end_t;
     double  total_t;
-    bool scan_mode;
+    atomic_bool scan_mode{false};
     Mat display_mat;
+    Mat sensor_mat;            // image capteur de la frame courante (Image_Reader::SensorImage)
     Mat frame_gray;
     Mat grad_x;
     Mat abs_grad_x;
@@ -71,7 +80,16 @@ private:
     Scalar CV_GREEN = Scalar(0, 255, 0);
     Scalar CV_BLUE = Scalar(0, 0, 255);
     atomic_bool m_camera_thread_stopped{true};
-    SocketClient*     m_Client{nullptr};
+    Transmit_Stage*   m_transmit{nullptr};
+    Frame_Dedup m_dedup;
+    Frame_Sharpness m_sharpness;
+    Analysis_Offload m_offload;
+    uint8_t m_orientation = 0; // redressement des frames envoyees (OrientationByte)
+    uint64_t m_device_id = 0;  // DeviceHello, 0 = non annoncee
+    Rect m_analysis_capture;   // zone envoyee pour la derniere frame analysee par le serveur
+    Frame_Results m_remote_results;   // derniers resultats du serveur (buffer reutilise)
+    vector<vector<Point>> m_overlay;  // contours du dernier resultat, en pixels d'affichage
+    uint64_t m_overlay_us = 0;
     thread m_loopThread;
 };
 
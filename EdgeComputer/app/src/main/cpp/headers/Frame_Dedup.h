@@ -0,0 +1,45 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_FRAME_DEDUP_H
+#define EDGECOMPUTER_FRAME_DEDUP_H
+
+#include <cstdint>
+#include <chrono>
+#include <opencv2/core.hpp>
+
+/**
+ * Detection des frames dupliquees (scene immobile).
+ * On calcule un hash perceptuel (dHash 64 bits) sur une vignette de luminance
+ * 9x8 : si la frame est indiscernable de la derniere frame envoyee, l'appelant
+ * envoie un message "repeat" a la place d'un nouveau JPEG.
+ * Une vraie frame est forcee au moins toutes les keepalive_ms.
+ */
+class Frame_Dedup {
+public:
+    explicit Frame_Dedup(int max_distance = 2, int keepalive_ms = 1000);
+
+    /**
+     * @param rgba frame CV_8UC4 (buffer d'affichage)
+     * @return true si la frame peut etre remplacee par un "repeat".
+     *         Sinon la frame devient la nouvelle reference (elle doit etre envoyee).
+     */
+    bool IsRepeat(const cv::Mat &rgba);
+
+    // Oublie la reference : la prochaine frame sera toujours envoyee
+    void Reset();
+
+private:
+    uint64_t ComputeHash(const cv::Mat &rgba);
+
+    cv::Mat m_thumb;
+    cv::Mat m_luma;
+    uint64_t m_last_hash = 0;
+    bool m_has_last = false;
+    std::chrono::steady_clock::time_point m_last_sent;
+    int m_max_distance;
+    int m_keepalive_ms;
+};
+
+#endif //EDGECOMPUTER_FRAME_DEDUP_H
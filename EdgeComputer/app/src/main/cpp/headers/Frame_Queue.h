@@ -0,0 +1,66 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_FRAME_QUEUE_H
+#define EDGECOMPUTER_FRAME_QUEUE_H
+
+#include "Protocol.h"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Que faire d'une nouvelle frame quand la file est pleine
+enum drop_policy {
+    DROP_OLDEST,  // la plus ancienne en attente est remplacee (latence minimale)
+    DROP_NEWEST,  // la nouvelle est refusee (les frames en attente partent toutes)
+};
+
+// Un message pret a partir : header v2 + payload partage (jamais copie)
+struct Frame_Packet {
+    FrameHeaderV2 header;
+    std::shared_ptr<const std::vector<uint8_t>> payload;
+};
+
+/**
+ * File d'envoi bornee entre le thread camera et le thread d'envoi.
+ *  - messages de controle (dims, ...) : FIFO, jamais jetes
+ *  - frames : au plus `capacity` en attente. En DROP_OLDEST une nouvelle frame
+ *    remplace la plus ancienne frame non envoyee (latest-frame-wins) : le fil
+ *    porte toujours la frame la plus recente. En DROP_NEWEST elle est refusee.
+ */
+class Frame_Queue {
+public:
+    explicit Frame_Queue(size_t capacity = 1, drop_policy policy = DROP_OLDEST);
+
+    void PushControl(Frame_Packet packet);
+
+    // @return false si une frame a du etre jetee (l'ancienne ou celle-ci selon la politique)
+    bool PushFrame(Frame_Packet packet);
+
+    drop_policy Policy() const { return policy_; }
+
+    // Controle d'abord, puis frames. @return false si la file est vide
+    bool Pop(Frame_Packet &out);
+    bool PopControl(Frame_Packet &out);
+    bool PopFrame(Frame_Packet &out);
+    bool HasFrame();
+
+    void Clear();
+
+    // Frames jetees avant envoi (remplacees ou redondantes)
+    uint64_t Dropped();
+
+private:
+    std::mutex mutex_;
+    std::deque<Frame_Packet> control_;
+    std::deque<Frame_Packet> frames_;
+    size_t capacity_;
+    drop_policy policy_;
+    uint64_t dropped_ = 0;
+};
+
+#endif //EDGECOMPUTER_FRAME_QUEUE_H
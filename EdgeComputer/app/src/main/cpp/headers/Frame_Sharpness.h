@@ -0,0 +1,64 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_FRAME_SHARPNESS_H
+#define EDGECOMPUTER_FRAME_SHARPNESS_H
+
+#include <cstdint>
+#include <opencv2/core.hpp>
+
+#include "Protocol.h"
+
+/**
+ * Filtre des frames floues (bouge pendant la pose).
+ * Score = variance du laplacien de la luminance, calcule sur une vue decimee
+ * (~160 pixels de large, un pixel sur N sans moyenne : le flou reste visible).
+ *
+ * Une frame est floue si son score tombe sous blur_ratio fois la reference,
+ * le meilleur score recent (qui decroit doucement pour suivre la scene) : pas
+ * de seuil absolu, qui dependrait de l'eclairage et de la texture.
+ *
+ * En mode analyse (Scan), une frame floue n'est ni analysee ni envoyee ; une
+ * frame part quand meme toutes les min_live_ms pour que le direct continue.
+ * Hors mode analyse, tout est envoye : seuls les compteurs changent.
+ */
+class Frame_Sharpness {
+public:
+    explicit Frame_Sharpness(double blur_ratio = 0.35, int min_live_ms = 200);
+
+    // @param rgba frame CV_8UC4 (buffer d'affichage, sans le padding de stride)
+    double Score(const cv::Mat &rgba);
+
+    // true si score est sous blur_ratio fois la reference (met la reference a jour)
+    bool IsBlurry(double score);
+
+    /**
+     * @param analytics mode analyse actif
+     * @return false si la frame doit etre sautee (ni analyse, ni encodage, ni envoi).
+     *         Une frame gardee compte comme envoyee pour le rythme minimal du direct.
+     */
+    bool Keep(bool blurry, bool analytics, uint64_t now_us);
+
+    // Logue la distribution des scores et les frames sautees, au plus toutes les 10 s
+    void Report(uint64_t now_us);
+
+private:
+    cv::Mat m_small;
+    cv::Mat m_luma;
+    cv::Mat m_laplacian;
+    double m_blur_ratio;
+    uint64_t m_min_live_us;
+    double m_reference = 0.0;
+    uint64_t m_last_kept_us = 0;
+
+    // Compteurs depuis le dernier Report()
+    uint64_t m_buckets[SHARPNESS_BUCKETS] = {0};
+    uint64_t m_frames = 0;
+    uint64_t m_blurry = 0;
+    uint64_t m_skipped = 0;
+    double m_sum = 0.0;
+    uint64_t m_last_report_us = 0;
+};
+
+#endif //EDGECOMPUTER_FRAME_SHARPNESS_H
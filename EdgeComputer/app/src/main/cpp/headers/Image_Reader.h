@@ -53,6 +53,8 @@ public:
      *   to display buffer format. Supported display format:
      *      WINDOW_FORMAT_RGBX_8888
      *      WINDOW_FORMAT_RGBA_8888
+     *   The image is converted once in sensor orientation (SensorImage()), then
+     *   rotated for the display only.
      *   @param buf {@link ANativeWindow_Buffer} for image to display to.
      *   @param image a {@link AImage} instance, source of image conversion.
      *            it will be deleted via {@link AImage_delete}
@@ -60,6 +62,14 @@ public:
      */
     bool DisplayImage(ANativeWindow_Buffer *buf, AImage *image);
 
+    /**
+     * Last image given to DisplayImage(), RGBA in sensor orientation, limited
+     * to the part shown on the display. Rotating it clockwise by the present
+     * rotation gives the display. A copy of the header keeps the pixels valid
+     * after the next DisplayImage().
+     */
+    const cv::Mat &SensorImage() const { return sensorImage_; }
+
     /**
      * Configure the rotation angle necessary to apply to
      * Camera image when presenting: all rotations should be accumulated:
@@ -72,13 +82,11 @@ private:
     int32_t presentRotation_;
     AImageReader *reader_;
 
-    void PresentImage(ANativeWindow_Buffer *buf, AImage *image);
-
-    void PresentImage90(ANativeWindow_Buffer *buf, AImage *image);
+    void ConvertImage(AImage *image, int32_t max_width, int32_t max_height);
 
-    void PresentImage180(ANativeWindow_Buffer *buf, AImage *image);
+    void PresentImage(ANativeWindow_Buffer *buf);
 
-    void PresentImage270(ANativeWindow_Buffer *buf, AImage *image);
+    cv::Mat sensorImage_;
 
     int32_t imageHeight_;
     int32_t imageWidth_;
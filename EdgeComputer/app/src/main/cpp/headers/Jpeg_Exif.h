@@ -0,0 +1,32 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_JPEG_EXIF_H
+#define EDGECOMPUTER_JPEG_EXIF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Debut de JPEG a lire pour JpegOrientationPrefix() : SOI et un APP0 JFIF sans vignette
+#define JPEG_ORIENTATION_PEEK 64
+
+// Tag EXIF Orientation (1 = droit ... 8) d'une orientation du protocole (OrientationByte)
+uint8_t ExifOrientation(uint8_t orientation);
+
+/**
+ * Redressement d'un JPEG sans toucher a ses pixels : un segment APP1 EXIF
+ * ne portant que le tag Orientation, que les navigateurs et visionneuses
+ * appliquent a l'affichage. Le JPEG part en deux morceaux, prefix puis
+ * jpeg + skip : SOI et l'eventuel APP0 JFIF (qui doit rester en tete) sont
+ * recopies dans prefix, suivis du segment EXIF. Cote serveur pour les
+ * visionneuses, cote device pour un serveur sans CAP_ORIENTATION.
+ *
+ * @return skip, octets de jpeg deja repris dans prefix ; 0 (prefix vide) si
+ *         orientation est nulle ou si le debut du JPEG n'est pas reconnu
+ */
+size_t JpegOrientationPrefix(const uint8_t *jpeg, size_t length, uint8_t orientation,
+                             std::string &prefix);
+
+#endif //EDGECOMPUTER_JPEG_EXIF_H
@@ -0,0 +1,279 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_PROTOCOL_H
+#define EDGECOMPUTER_PROTOCOL_H
+
+// Definitions du protocole reseau Android -> serveur.
+// Ce header ne depend ni d'Android ni d'OpenCV : il est partage avec le serveur natif.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Protocole v1 (legacy) : 1 octet type + payload
+ *   type=1 -> dims   (int32 w, int32 h)
+ *   type=2 -> jpeg   (int32 size + bytes)
+ *   type=3 -> repeat (pas de payload)
+ *
+ * Protocole v2 : chaque message commence par un FrameHeaderV2 de taille fixe
+ * (little-endian) suivi de payload_len octets. Le premier octet du magic ('E')
+ * ne peut pas etre confondu avec un type v1, un recepteur peut donc accepter
+ * les deux formats sur la meme connexion.
+ */
+enum msg_type : uint8_t {
+    MSG_DIMS = 1,
+    MSG_JPEG = 2,
+    MSG_REPEAT = 3,
+
+    // v2 uniquement
+    MSG_HELLO = 16,      // client -> serveur, payload = HelloPayload
+    MSG_HELLO_ACK = 17,  // serveur -> client, payload = HelloPayload (caps acceptees)
+
+    // Canal de retour serveur -> device (si CAP_CONTROL)
+    MSG_CONTROL = 20,    // serveur -> client, payload = ControlPayload
+    MSG_PING = 21,       // serveur -> client, capture_ts_us = heure d'envoi serveur (t0)
+    MSG_PONG = 22,       // client -> serveur, payload = PongPayload,
+                         // capture_ts_us = heure d'envoi device (t2)
+
+    // Resultats d'analyse d'une frame (si CAP_RESULTS), dans les deux sens :
+    // sequence et capture_ts_us = ceux de la frame decrite, width / height = image
+    // analysee, payload = Results_Header + objets + texte (voir ParseResults)
+    // En flux strie, les frames sont renumerotees a l'envoi : seul capture_ts_us la designe
+    MSG_RESULTS = 23,
+};
+
+// Commandes du canal de retour, appliquees par le device en debut de frame
+enum control_cmd : uint8_t {
+    CTRL_SET_QUALITY = 1,      // args[0] = qualite JPEG max (1..100)
+    CTRL_SET_BITRATE = 2,      // args[0] = debit cible en kbit/s (0 = pas de cible)
+    CTRL_SET_SIZE = 3,         // args[0..1] = taille max du flux (0,0 = taille native)
+    CTRL_REQUEST_REFRESH = 4,  // force une keyframe
+    CTRL_SET_ROI = 5,          // args[0..3] = x, y, w, h (w = 0 : image entiere)
+    CTRL_PAUSE = 6,            // args[0] = 1 pause, 0 reprise
+    CTRL_SERVER_LOAD = 7,      // args[0] = cout d'une analyse serveur en µs (0 = inconnu),
+                               // args[1] = frames en attente d'analyse, args[2] = RTT en µs
+};
+
+#define PROTO_MAGIC   0x32474445u  // "EDG2" en little-endian
+#define PROTO_VERSION 2
+
+enum frame_flags : uint16_t {
+    FLAG_KEYFRAME = 1 << 0,  // frame complete (par opposition a un repeat)
+    FLAG_CHECKSUM = 1 << 1,  // le champ checksum contient le CRC32 du payload
+    FLAG_ANALYZE = 1 << 2,   // le device demande au serveur d'analyser cette frame
+};
+
+enum codec_type : uint8_t {
+    CODEC_NONE = 0,
+    CODEC_JPEG = 1,
+    CODEC_RAW_GRAY = 2,  // pixels bruts 8 bits, lignes contigues (width * height octets)
+    CODEC_RAW_BGR = 3,   // pixels bruts BGR 24 bits, lignes contigues
+};
+
+// Capacites negociees a la connexion (bitmask)
+enum proto_caps : uint32_t {
+    CAP_CHECKSUM = 1 << 0,
+    CAP_REPEAT = 1 << 1,
+    CAP_CONTROL = 1 << 2,  // le client lit MSG_CONTROL / MSG_PING sur la connexion
+    CAP_STRIPED = 1 << 3,  // flux reparti sur plusieurs connexions (StripeHello)
+    CAP_ANALYSIS = 1 << 4, // analyse faite d'un cote ou de l'autre (FLAG_ANALYZE)
+    CAP_RESULTS = 1 << 5,  // le serveur accepte MSG_RESULTS
+    CAP_DEVICE_ID = 1 << 6, // DeviceHello dans le HELLO
+    CAP_ORIENTATION = 1 << 7, // le serveur lit l'octet orientation (sinon tag EXIF dans le JPEG)
+};
+
+// Cote qui a fait une analyse
+enum analysis_site : uint8_t {
+    ANALYSIS_DEVICE = 0,
+    ANALYSIS_SERVER = 1,
+};
+
+// Types d'objets de MSG_RESULTS
+enum result_kind : uint16_t {
+    RESULT_BARCODE = 1,  // zone de code-barres (BarcodeDetect) ; texte = valeur, si decodee
+    RESULT_OBJECT = 2,   // objet detecte par un modele (class_id)
+};
+
+// Sommets max d'un Result_Object
+#define RESULT_MAX_POINTS 8
+
+#pragma pack(push, 1)
+struct FrameHeaderV2 {
+    uint32_t magic;          // PROTO_MAGIC
+    uint8_t version;         // PROTO_VERSION
+    uint8_t type;            // msg_type
+    uint16_t flags;          // frame_flags
+    uint32_t sequence;       // numero de frame, incremente a chaque message
+    uint64_t capture_ts_us;  // horodatage de capture (ProtoClockMicros du device)
+    uint16_t width;
+    uint16_t height;
+    uint8_t codec;           // codec_type
+    uint8_t sharpness;       // nettete de la frame (SharpnessByte), 0 = non mesuree
+    uint8_t orientation;     // redressement des pixels (OrientationByte), 0 = deja droits
+    uint8_t reserved;
+    uint32_t payload_len;
+    uint32_t checksum;       // CRC32 du payload si FLAG_CHECKSUM, 0 sinon
+};
+
+struct HelloPayload {
+    uint32_t caps;           // proto_caps
+};
+
+// Suit HelloPayload dans le HELLO d'un flux strie : le serveur regroupe les
+// connexions de meme stream_id (la voie 0 porte le controle)
+struct StripeHello {
+    uint32_t stream_id;      // tire au hasard a chaque session
+    uint8_t stripe_index;
+    uint8_t stripe_count;
+    uint16_t reserved;
+};
+
+// Dernier element du HELLO quand CAP_DEVICE_ID (apres StripeHello s'il y en a un) :
+// identite stable du telephone, quels que soient son adresse et son port
+struct DeviceHello {
+    uint64_t device_id;      // jamais 0
+};
+
+struct ControlPayload {
+    uint8_t command;         // control_cmd
+    uint8_t reserved[3];
+    int32_t args[4];
+};
+
+// Debut du payload MSG_RESULTS
+struct Results_Header {
+    uint8_t site;            // analysis_site
+    uint8_t reserved;
+    uint16_t count;          // Result_Object qui suivent
+    uint32_t cost_us;        // duree de l'analyse
+    uint32_t text_bytes;     // zone de texte apres les objets (UTF-8, sans zero final)
+    uint32_t reserved2;
+};
+
+// Un objet trouve dans la frame, en pixels de l'image analysee
+struct Result_Object {
+    uint16_t kind;           // result_kind
+    uint16_t class_id;       // classe du modele (RESULT_OBJECT), 0 sinon
+    float confidence;        // 0..1
+    int16_t box[4];          // x, y, w, h : rectangle englobant
+    uint8_t point_count;     // sommets valides dans polygon (0 = rectangle seul)
+    uint8_t reserved;
+    uint16_t text_offset;    // texte de l'objet dans la zone de texte
+    uint16_t text_length;    // 0 = pas de texte
+    uint16_t reserved2;
+    int16_t polygon[RESULT_MAX_POINTS][2];  // contour (x, y), dans l'ordre
+};
+
+struct PongPayload {
+    uint64_t ping_ts_us;     // t0 : capture_ts_us du PING recu (horloge serveur)
+    uint64_t recv_ts_us;     // t1 : reception du PING (horloge device)
+};
+#pragma pack(pop)
+
+static_assert(sizeof(FrameHeaderV2) == 36, "FrameHeaderV2 doit rester fixe sur le fil");
+static_assert(sizeof(Results_Header) == 16, "Results_Header doit rester fixe sur le fil");
+static_assert(sizeof(Result_Object) == 56, "Result_Object doit rester fixe sur le fil");
+
+/**
+ * Transport datagramme (UDP) : chaque message v2 complet (FrameHeaderV2 + payload)
+ * est decoupe en fragments de frag_size octets, chacun precede d'un DatagramHeader.
+ * Optionnellement, un datagramme de parite (XOR des fragments, completes par des
+ * zeros) suit chaque groupe de fec_group fragments : il permet de reconstruire
+ * un fragment perdu par groupe sans retransmission.
+ */
+#define DGRAM_MAGIC 0x55474445u  // "EDGU" en little-endian
+
+enum dgram_kind : uint8_t {
+    DGRAM_DATA = 0,
+    DGRAM_PARITY = 1,
+};
+
+#pragma pack(push, 1)
+struct DatagramHeader {
+    uint32_t magic;        // DGRAM_MAGIC
+    uint8_t kind;          // dgram_kind
+    uint8_t fec_group;     // fragments par groupe de parite (0 = pas de FEC)
+    uint16_t frag_index;   // DATA : index du fragment, PARITY : index du groupe
+    uint16_t frag_count;   // nombre de fragments DATA du message
+    uint16_t frag_size;    // taille nominale d'un fragment (le dernier peut etre plus court)
+    uint32_t message_id;   // compteur de messages cote emetteur
+    uint32_t message_len;  // taille du message reconstruit (FrameHeaderV2 + payload)
+};
+#pragma pack(pop)
+
+static_assert(sizeof(DatagramHeader) == 20, "DatagramHeader doit rester fixe sur le fil");
+
+// Taille max d'un payload accepte par un recepteur (garde-fou contre un flux corrompu)
+#define PROTO_MAX_PAYLOAD (16u * 1024u * 1024u)
+
+/**
+ * Remplit un header v2 (magic, version, type, longueur). Les autres champs
+ * sont mis a zero et restent a la charge de l'appelant.
+ */
+void InitHeaderV2(FrameHeaderV2 *hdr, uint8_t type, uint32_t payload_len);
+
+// true si le header a le bon magic / version et une taille de payload raisonnable
+bool IsValidHeaderV2(const FrameHeaderV2 *hdr);
+
+// CRC32 (polynome IEEE 802.3, compatible zlib.crc32)
+uint32_t Crc32(const void *data, size_t len, uint32_t crc = 0);
+
+/**
+ * Payload MSG_RESULTS : Results_Header, count Result_Object, puis text_bytes
+ * octets de texte. Rien a decoder : les pointeurs renvoyes designent le
+ * payload lui-meme (structures packees, little-endian).
+ * @return false si le payload est plus court que ce qu'il annonce
+ */
+bool ParseResults(const uint8_t *payload, size_t len, const Results_Header **header,
+                  const Result_Object **objects, const char **text);
+
+// Taille du payload MSG_RESULTS pour count objets et text_bytes octets de texte
+inline size_t ResultsBytes(size_t count, size_t text_bytes) {
+    return sizeof(Results_Header) + count * sizeof(Result_Object) + text_bytes;
+}
+
+// Payload MSG_RESULTS ; text = textes des objets mis bout a bout (text_offset / text_length)
+std::vector<uint8_t> EncodeResults(uint8_t site, uint32_t cost_us, const Result_Object *objects,
+                                   uint16_t count, const char *text = nullptr, uint32_t text_bytes = 0);
+
+/**
+ * Nettete d'une frame sur un octet (FrameHeaderV2::sharpness), a partir de la
+ * variance du laplacien : 16 * log2(1 + score), au moins 1 (0 = non mesuree).
+ */
+uint8_t SharpnessByte(double score);
+
+// Histogrammes de nettete : 8 seaux de 32 valeurs de l'octet, soit des scores < 4, 16, 64...
+#define SHARPNESS_BUCKETS 8
+inline int SharpnessBucket(uint8_t sharpness) { return sharpness / 32; }
+
+/**
+ * Orientation d'une frame (FrameHeaderV2::orientation) : le device envoie
+ * les pixels tels que le capteur les donne ; pour redresser l'image, tourner
+ * de (orientation & ORIENT_TURNS) quarts de tour dans le sens horaire, puis
+ * retourner horizontalement si ORIENT_MIRROR. Les coordonnees du protocole
+ * (ROI, resultats) restent celles de la frame recue.
+ */
+#define ORIENT_TURNS  0x03
+#define ORIENT_MIRROR 0x04
+
+// @param rotation_deg rotation horaire d'affichage (0, 90, 180, 270)
+uint8_t OrientationByte(int rotation_deg, bool mirror);
+
+// Point (x, y) d'une image w x h telle que recue -> image redressee
+void OrientPoint(uint8_t orientation, float w, float h, float &x, float &y);
+
+// Point de l'image redressee -> image w x h telle que recue (w, h avant redressement)
+void UnorientPoint(uint8_t orientation, float w, float h, float &x, float &y);
+
+/**
+ * Horloge des horodatages du protocole, en µs : CLOCK_BOOTTIME, la base des
+ * timestamps capteur (AImage_getTimestamp, source REALTIME). Les PONG
+ * utilisent la meme horloge, le serveur peut donc ramener les captures dans
+ * son propre temps.
+ */
+uint64_t ProtoClockMicros();
+
+#endif //EDGECOMPUTER_PROTOCOL_H
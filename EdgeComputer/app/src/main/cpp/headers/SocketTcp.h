@@ -8,28 +8,267 @@
 
 #include <string>
 #include <cstdint>
-#include <opencv2/core.hpp>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <sys/uio.h>
 
+#include "Frame_Queue.h"
+#include "SocketUdp.h"
+
+enum transport_mode {
+    TRANSPORT_TCP,  // flux fiable, une perte bloque les frames suivantes (head-of-line)
+    TRANSPORT_UDP,  // datagrammes fragmentes + FEC, une frame incomplete est abandonnee
+    TRANSPORT_TCP_STRIPED,  // N connexions TCP, chaque frame part sur la premiere libre
+};
+
+/**
+ * Borne la latence accumulee dans le buffer d'envoi du noyau (TCP) : avant
+ * chaque frame, les octets non acquittes (SIOCOUTQ) sont convertis en temps au
+ * debit mesure, et la frame est sautee si ce temps depasse max_queue_ms.
+ */
+struct Send_Budget {
+    int max_queue_ms = 100;  // 0 = pas de saut de frame
+    int sndbuf_bytes = 0;    // plafond SO_SNDBUF, 0 = defaut du noyau
+};
+
+// Rectangle en pixels du buffer d'affichage (width = 0 : vide)
+struct Stream_Rect {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+};
+
+/**
+ * Etat du flux pilote par le serveur via le canal de retour (MSG_CONTROL).
+ * Le thread camera en prend une copie en debut de frame : un changement ne
+ * s'applique jamais au milieu d'une frame.
+ */
+struct Stream_Control {
+    int jpeg_quality = 80;  // qualite max
+    int bitrate_kbps = 0;   // debit cible, 0 = pas de cible (qualite fixe)
+    int width = 0;          // taille max du flux, 0 = taille du buffer d'affichage
+    int height = 0;
+    Stream_Rect roi;        // vide = image entiere
+    bool paused = false;
+};
+
+// Charge annoncee par le serveur (CTRL_SERVER_LOAD), une fois par PING
+struct Server_Load {
+    uint32_t analysis_us = 0;  // cout d'une analyse serveur, 0 = inconnu
+    uint32_t queued = 0;       // frames en attente d'analyse
+    uint32_t rtt_us = 0;
+    uint64_t updated_us = 0;   // ProtoClockMicros() a la reception, 0 = jamais recue
+};
+
+// Resultats d'analyse recus du serveur (MSG_RESULTS), payload tel que recu (voir ParseResults)
+struct Frame_Results {
+    uint32_t sequence = 0;         // frame analysee
+    uint64_t capture_ts_us = 0;
+    int width = 0;                 // taille de l'image analysee
+    int height = 0;
+    std::vector<uint8_t> payload;
+};
+
+/**
+ * Client TCP vers le serveur (une destination du Transmit_Stage).
+ * Les Send*() ne font que preparer le message et le deposer dans une Frame_Queue :
+ * c'est un thread de transport dedie qui ecrit sur la socket (non bloquante, poll()),
+ * le thread camera n'attend donc jamais le reseau.
+ *
+ * Le thread de transport gere aussi la connexion : en cas d'echec ou de coupure
+ * il se reconnecte en arriere-plan (backoff exponentiel + jitter), renvoie les
+ * parametres du flux et demande une keyframe, sans toucher a la session camera.
+ */
 class SocketClient {
 public:
-    SocketClient(const std::string& host, int port);
+    // queue_capacity / policy : frames en attente d'envoi, 1 + DROP_OLDEST = on
+    // n'envoie jamais que la plus recente
+    SocketClient(const std::string& host, int port, size_t queue_capacity = 1,
+                 drop_policy policy = DROP_OLDEST);
     ~SocketClient();
 
-    bool ConnectToServer();
+    // A appeler avant Start()
+    void SetTransport(transport_mode mode) { transport_ = mode; }
+    // Nombre de connexions en TRANSPORT_TCP_STRIPED
+    void SetStripeCount(int count) { stripe_count_ = count; }
+    void SetSendBudget(const Send_Budget &budget) { budget_ = budget; }
+    // Identite stable du telephone, annoncee au HELLO (0 = aucune) : le serveur y
+    // range les enregistrements au lieu de l'IP
+    void SetDeviceId(uint64_t device_id) { device_id_ = device_id; }
+    DatagramSender &Datagrams() { return udp_; }
+
+    // Demarre le thread de transport (connexion + reconnexions en arriere-plan)
+    void Start();
     void Close();
 
+    // true si une session est etablie (inutile d'encoder sinon)
+    bool IsConnected() const { return connected_; }
+
+    // true une seule fois apres chaque (re)connexion : la prochaine frame doit
+    // etre complete (le serveur n'a peut-etre plus de JPEG a re-servir)
+    bool TakeKeyframeRequest() { return keyframe_requested_.exchange(false); }
+
+    // Copie de l'etat pilote par le serveur, a prendre une fois par frame
+    Stream_Control Control();
+
+    // true si le serveur peut analyser les frames (CAP_ANALYSIS accepte)
+    bool CanAnalyze() const { return connected_ && (caps_ & CAP_ANALYSIS); }
+    Server_Load ServerLoad();
+    // Derniers resultats du serveur, une seule fois. @return false si rien de neuf
+    bool TakeResults(Frame_Results &out);
+
+    // Demande un CRC32 par payload (applique seulement si le serveur l'accepte)
+    void SetChecksum(bool enabled) { want_checksum_ = enabled; }
+    int ProtocolVersion() const { return proto_version_; }
+
+    // Memorise les dimensions du flux : elles sont renvoyees a chaque reconnexion
     bool SendImageDims(int width, int height);
 
-    // Envoie une image OpenCV (on l’encode en JPEG pour éviter d’envoyer du brut énorme)
-    bool SendImage(const cv::Mat& rgba_or_bgr);
+    // Qualite JPEG a utiliser pour la prochaine frame : max_quality (profil)
+    // plafonnee par le serveur et ajustee au debit cible
+    int EncodeQuality(int max_quality);
+
+    // Envoie une frame deja encodee (payload partage avec les autres destinations)
+    // @param analyze demande au serveur d'analyser la frame (si CAP_ANALYSIS)
+    // @param sharpness score de nettete (SharpnessByte), 0 = non mesure
+    // @param orientation redressement des pixels (OrientationByte), 0 = deja droits
+    bool SendEncoded(std::shared_ptr<const std::vector<uint8_t>> payload, int width, int height,
+                     uint8_t codec, uint64_t capture_ts_us = 0, bool analyze = false,
+                     uint8_t sharpness = 0, uint8_t orientation = 0);
+
+    // Resultats de la derniere frame envoyee (EncodeResults), pour le serveur (si CAP_RESULTS)
+    bool SendResults(std::shared_ptr<const std::vector<uint8_t>> payload, int width, int height,
+                     uint64_t capture_ts_us);
+
+    // Demande au serveur de re-servir la derniere frame recue (scene inchangee)
+    bool SendRepeat(uint64_t capture_ts_us = 0);
+
+    uint64_t FramesSent() const { return frames_sent_; }
+    uint64_t FramesDropped() { return queue_.Dropped(); }
+    uint64_t BytesSent() const { return bytes_sent_; }
+    // Frames sautees parce que le buffer noyau depassait le budget de latence
+    uint64_t FramesSkipped() const { return frames_skipped_; }
+    uint32_t Reconnections() const { return reconnections_; }
 
 private:
-    bool sendAll(const void* data, size_t len);
+    // Message en cours d'ecriture : les iovec pointent directement dans le
+    // header et le payload partage, un envoi partiel reprend sans recopie
+    struct In_Flight {
+        Frame_Packet packet;
+        uint8_t wire_header[sizeof(FrameHeaderV2)];
+        iovec iov[2];
+        int iov_index = 0;  // premier iovec pas encore entierement envoye
+        int iovcnt = 0;     // 0 = rien en cours
+    };
+
+    // Connexion supplementaire d'un flux strie (la voie 0 est sock_)
+    struct Stripe {
+        int sock = -1;
+        In_Flight in_flight;
+    };
+
+    // Une tentative de connexion complete (connect + negociation v2/v1)
+    bool connectOnce();
+    bool connectSocket();
+    // @return la socket connectee, -1 en cas d'echec
+    int openSocket();
+    void closeSocket();
+    bool negotiate(int sock, uint8_t stripe_index);
+    // Ouvre les voies 1..N-1 d'un flux strie
+    void connectStripes();
+    bool waitFd(int fd, short events, int timeout_ms);
+    bool sendv(int sock, struct iovec* iov, int iovcnt, int timeout_ms);
+    bool recvAll(int sock, void* data, size_t len, int timeout_ms);
+
+    Frame_Packet makePacket(uint8_t type, uint16_t flags, uint64_t capture_ts_us,
+                            int width, int height, uint8_t codec,
+                            std::shared_ptr<const std::vector<uint8_t>> payload);
+    void wakeSender();
+    // Attente interruptible par Close()
+    void sleepInterruptible(int ms);
+    void transportLoop();
+    // Envoie la file jusqu'a la perte de connexion (ou l'arret)
+    void runSession();
+    void runDatagramSession();
+    void countSent(uint8_t type);
+    // Lit le canal de retour et traite les messages complets
+    // @return false si la connexion est fermee
+    bool readIncoming();
+    void handleIncoming(const FrameHeaderV2 &hdr, const uint8_t *payload);
+    void applyControl(const ControlPayload &ctrl);
+    // Ajuste la qualite JPEG pour tenir le debit cible
+    void adaptQuality(size_t encoded_bytes);
+
+    // true si le backlog noyau depasse le budget : la frame doit etre sautee
+    bool overBudget();
+    // Flux strie : true si la voie peut prendre une frame de plus
+    bool stripeReady(int sock);
+    // Donne les frames en attente aux voies libres. @return false s'il en reste
+    bool dispatchFrames();
+    // Lit (et jette) ce qui arrive sur une voie secondaire. @return false si fermee
+    bool drainStripe(int sock);
+    void prepareInFlight(In_Flight &f, Frame_Packet packet);
+    // @return false sur erreur fatale de la socket
+    bool writeInFlight(In_Flight &f, int sock);
 
 private:
     std::string host_;
     int port_ = 0;
     int sock_ = -1;
+    int wake_fd_ = -1;       // eventfd : reveille le thread de transport
+    transport_mode transport_ = TRANSPORT_TCP;
+    DatagramSender udp_;
+    int stripe_count_ = 4;
+    std::vector<Stripe> stripes_;
+    uint32_t stream_id_ = 0;
+    uint64_t device_id_ = 0;
+    uint32_t dispatch_seq_ = 0;     // sequence continue des frames d'un flux strie
+    size_t last_frame_bytes_ = 0;
+    std::atomic_int proto_version_{1};
+    std::atomic<uint32_t> caps_{0};   // capacites acceptees par le serveur (v2)
+    uint32_t sequence_ = 0;
+    uint32_t frame_sequence_ = 0;   // derniere frame envoyee, reprise par SendResults
+    bool want_checksum_ = false;
+
+    std::atomic_int dims_width_{0};
+    std::atomic_int dims_height_{0};
+
+    std::mutex control_mutex_;
+    Stream_Control control_;
+    Server_Load server_load_;
+    Frame_Results results_;
+    bool results_ready_ = false;
+    std::vector<uint8_t> rx_buf_;   // octets recus pas encore decodes
+
+    // Adaptation de la qualite (thread camera uniquement)
+    int effective_quality_ = 80;
+    int quality_cap_ = 80;
+    double encoded_bps_ = 0.0;
+    std::chrono::steady_clock::time_point last_encode_t_;
+
+    Send_Budget budget_;
+    // Estimation du debit reel (octets quittant le buffer noyau), par session
+    uint64_t session_bytes_ = 0;
+    uint64_t drained_last_ = 0;
+    std::chrono::steady_clock::time_point drained_last_t_;
+    bool link_busy_ = false;
+    double drain_rate_ = 0.0;  // octets/s, 0 = pas encore mesure
+
+    Frame_Queue queue_;
+    In_Flight in_flight_;
+    std::thread sender_thread_;
+    std::atomic_bool sender_stop_{false};
+    std::atomic_bool connected_{false};
+    std::atomic_bool keyframe_requested_{false};
+
+    std::atomic<uint64_t> frames_sent_{0};
+    std::atomic<uint64_t> bytes_sent_{0};
+    std::atomic<uint64_t> frames_skipped_{0};
+    std::atomic<uint32_t> reconnections_{0};
 };
 
 #endif //EDGECOMPUTER_SOCKETTCP_H
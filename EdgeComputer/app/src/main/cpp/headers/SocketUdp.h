@@ -0,0 +1,66 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_SOCKETUDP_H
+#define EDGECOMPUTER_SOCKETUDP_H
+
+#include "Protocol.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+/**
+ * Emission d'un message v2 en datagrammes UDP (voir DatagramHeader) :
+ * fragmentation a la MTU, parite XOR par groupe de fragments et pacing
+ * (token bucket) pour ne pas noyer le buffer du point d'acces Wi-Fi en rafale.
+ * Utilise par le thread de transport de SocketClient en mode TRANSPORT_UDP.
+ */
+class DatagramSender {
+public:
+    /**
+     * @param mtu taille max d'un datagramme (header UDP/IP non compris)
+     * @param fec_group fragments par datagramme de parite, 0 = pas de FEC
+     * @param pacing_bps debit de pacing en bits/s, 0 = pas de pacing
+     */
+    explicit DatagramSender(int mtu = 1400, int fec_group = 8, uint64_t pacing_bps = 40000000);
+
+    // Perte simulee (0..1) avant emission, pour valider la FEC sans netem
+    void SetSimulatedLoss(double rate) { loss_rate_ = rate; }
+
+    /**
+     * Fragmente et envoie un message sur une socket UDP connectee.
+     * Le pacing attend sur wake_fd : un reveil avec stop=true interrompt l'envoi.
+     * @return false sur erreur de la socket (ex : ECONNREFUSED, serveur absent)
+     */
+    bool SendMessage(int sock, const FrameHeaderV2 &hdr, const uint8_t *payload,
+                     int wake_fd, const std::atomic_bool &stop);
+
+    uint64_t DatagramsSent() const { return datagrams_sent_; }
+
+private:
+    bool sendDatagram(int sock, DatagramHeader &dh, const uint8_t *part1, size_t len1,
+                      const uint8_t *part2, size_t len2, int wake_fd, const std::atomic_bool &stop);
+    // Attend d'avoir assez de credit pour `bytes` octets
+    bool pace(size_t bytes, int wake_fd, const std::atomic_bool &stop);
+
+    int frag_size_;
+    int fec_group_;
+    uint64_t pacing_bps_;
+    double loss_rate_ = 0.0;
+
+    uint32_t message_id_ = 0;
+    std::vector<uint8_t> parity_;
+
+    double tokens_;       // credit en octets
+    double burst_bytes_;
+    std::chrono::steady_clock::time_point last_refill_;
+
+    std::minstd_rand rng_;
+    uint64_t datagrams_sent_ = 0;
+};
+
+#endif //EDGECOMPUTER_SOCKETUDP_H
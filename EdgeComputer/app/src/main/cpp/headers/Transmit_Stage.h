@@ -0,0 +1,128 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_TRANSMIT_STAGE_H
+#define EDGECOMPUTER_TRANSMIT_STAGE_H
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SocketTcp.h"
+
+// Format d'encodage d'une destination
+struct Encode_Profile {
+    int width = 0;           // taille max, ratio conserve ; 0 = taille de la frame
+    int height = 0;
+    int jpeg_quality = 80;
+    bool luma_only = false;  // niveaux de gris
+    bool raw = false;        // pixels bruts (CODEC_RAW_*), pas de JPEG
+};
+
+/**
+ * Etage d'emission : un ensemble de destinations (un SocketClient chacune,
+ * avec sa propre file et sa politique de rejet : une destination lente ne
+ * retarde jamais les autres).
+ *
+ * Chaque frame est encodee une seule fois par profil effectif (profil de la
+ * destination + commandes de son serveur) ; les destinations qui tombent sur
+ * le meme profil partagent le meme payload, sans copie.
+ *
+ * Toutes les methodes sont appelees depuis le thread camera.
+ */
+class Transmit_Stage {
+public:
+    Transmit_Stage() = default;
+    ~Transmit_Stage();
+    Transmit_Stage(const Transmit_Stage &other) = delete;
+    Transmit_Stage &operator=(const Transmit_Stage &other) = delete;
+
+    // @return le client de la destination, pour les reglages avant Start()
+    SocketClient *AddDestination(const std::string &host, int port, const Encode_Profile &profile,
+                                 size_t queue_capacity = 1, drop_policy policy = DROP_OLDEST);
+
+    void Start();
+    void Close();
+
+    // Dimensions du flux, renvoyees par chaque destination a sa connexion
+    void SendImageDims(int width, int height);
+
+    // Debut de frame : fige les commandes serveur de chaque destination.
+    // @return true si au moins une destination attend des frames
+    bool BeginFrame();
+
+    // true si une destination active reclame une keyframe (toutes sont consommees)
+    bool TakeKeyframeRequest();
+
+    // Zone de l'image capteur a encoder : union des ROI demandees (en pixels de
+    // la frame envoyee), image entiere si une destination n'en a pas
+    cv::Rect CaptureRect(const cv::Size &frame_size);
+
+    // Premiere destination qui peut analyser les frames (CAP_ANALYSIS), nullptr sinon
+    SocketClient *AnalysisServer();
+
+    // @param frame  RGBA, zone CaptureRect() ; origin = son coin dans la frame
+    // @param analyze  demande l'analyse de la frame a AnalysisServer()
+    // @param sharpness  score de nettete (SharpnessByte), 0 = non mesure
+    // @param orientation  pixels en orientation capteur : redressement (OrientationByte)
+    void SendFrame(const cv::Mat &frame, const cv::Point &origin, uint64_t capture_ts_us,
+                   bool analyze = false, uint8_t sharpness = 0, uint8_t orientation = 0);
+    void SendRepeat(uint64_t capture_ts_us);
+
+    // Resultats d'une analyse faite sur le device (EncodeResults), en pixels de l'image
+    // entiere, pour la frame qui vient de partir : ramenes pour chaque destination a la
+    // frame qu'elle a recue (ROI, taille), vers toutes celles qui les acceptent
+    void SendResults(std::vector<uint8_t> payload, uint64_t capture_ts_us);
+
+private:
+    struct Destination {
+        SocketClient *client;
+        Encode_Profile profile;
+        Stream_Control control;  // copie prise par BeginFrame()
+        bool active = false;
+        // Derniere frame envoyee : zone de l'image entiere (vide = rien envoye) et taille
+        cv::Rect sent_roi;
+        cv::Size sent_size;
+    };
+
+    // Tout ce qui determine les octets encodes : deux destinations avec la meme
+    // cle recoivent le meme payload
+    struct Encode_Key {
+        cv::Rect roi;
+        int width;
+        int height;
+        int quality;  // 0 si raw
+        bool luma_only;
+        bool raw;
+
+        bool sameImage(const Encode_Key &o) const {
+            return roi == o.roi && width == o.width && height == o.height &&
+                   luma_only == o.luma_only;
+        }
+        bool operator==(const Encode_Key &o) const {
+            return sameImage(o) && quality == o.quality && raw == o.raw;
+        }
+    };
+
+    struct Encoded {
+        Encode_Key key;
+        std::shared_ptr<const std::vector<uint8_t>> payload;
+        int width;
+        int height;
+        uint8_t codec;
+    };
+
+    Encode_Key keyFor(Destination &dest, const cv::Mat &frame, const cv::Point &origin);
+    // @return false si l'encodage echoue
+    bool encode(const cv::Mat &frame, const Encode_Key &key, Encoded &out);
+
+    std::vector<Destination> destinations_;
+    // Par frame : images converties/redimensionnees et payloads deja produits
+    std::vector<std::pair<Encode_Key, cv::Mat>> prepared_;
+    std::vector<Encoded> encoded_;
+};
+
+#endif //EDGECOMPUTER_TRANSMIT_STAGE_H
@@ -6,6 +6,9 @@
 #define EDGECOMPUTER_UTIL_H
 
 #include <unistd.h>
+#include <cstdint>
+
+#ifdef __ANDROID__
 #include <android/log.h>
 
 // used to get logcat outputs which can be regex filtered by the LOG_TAG we give
@@ -17,6 +20,19 @@
   if (!(cond)) {                                              \
     __android_log_assert(#cond, LOG_TAG, fmt, ##__VA_ARGS__); \
   }
+#else
+// Code partage compile sur PC (serveur d'ingestion) : logs sur stdout/stderr
+#include <cstdio>
+#include <cstdlib>
+
+#define LOGI(fmt, ...) fprintf(stdout, fmt "\n", ##__VA_ARGS__)
+#define LOGE(fmt, ...) fprintf(stderr, fmt "\n", ##__VA_ARGS__)
+#define ASSERT(cond, fmt, ...)                                \
+  if (!(cond)) {                                              \
+    fprintf(stderr, fmt "\n", ##__VA_ARGS__);                 \
+    abort();                                                  \
+  }
+#endif
 
 // A Data Structure to communicate resolution between camera and ImageReader
 struct ImageFormat {
@@ -15,6 +15,12 @@ static int gWinH = 0;
 
 static std::thread gCameraThread;
 
+// Derniers etats batterie / temperature recus de Java, appliques a chaque nouveau manager
+static int gBatteryPct = 100;
+static uint64_t gDeviceId = 0;
+static bool gCharging = true;
+static int gThermalStatus = 0;
+
 static void startCameraThreadIfNeeded() {
     // Si un thread précédent est encore joinable, on le rejoint d'abord
     if (gCameraThread.joinable()) {
@@ -93,6 +99,8 @@ Java_com_example_edgecomputer_MainActivity_setSurface(
     // Crée le manager CV + branche la window
     gCv = std::make_unique<CV_Manager>();
     gCv->SetNativeWindow(gWindow);
+    gCv->SetPowerState(gBatteryPct, gCharging, gThermalStatus);
+    gCv->SetDeviceId(gDeviceId);
 
     // Setup camera (Native_Camera + Image_Reader + capture session)
     gCv->SetUpCamera();
@@ -146,6 +154,35 @@ Java_com_example_edgecomputer_MainActivity_flipCamera(
     startCameraThreadIfNeeded();
 }
 
+/**
+ * Java: public native void setPowerState(int batteryPct, boolean charging, int thermalStatus);
+ * Batterie (ACTION_BATTERY_CHANGED) et statut thermique (PowerManager) : le
+ * cote de l'analyse en tient compte.
+ */
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_edgecomputer_MainActivity_setPowerState(
+        JNIEnv* /*env*/, jobject /*thiz*/, jint battery_pct, jboolean charging, jint thermal_status) {
+
+    gBatteryPct = battery_pct;
+    gCharging = charging;
+    gThermalStatus = thermal_status;
+    if (gCv) {
+        gCv->SetPowerState(gBatteryPct, gCharging, gThermalStatus);
+    }
+}
+
+/**
+ * Java: public native void setDeviceId(long deviceId);
+ * Identifiant stable du telephone (ANDROID_ID) : le serveur range les
+ * enregistrements par telephone, meme derriere un NAT. Pris en compte a la
+ * prochaine connexion (setSurface).
+ */
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_edgecomputer_MainActivity_setDeviceId(
+        JNIEnv* /*env*/, jobject /*thiz*/, jlong device_id) {
+    gDeviceId = (uint64_t)device_id;
+}
+
 /**
  * Optionnel mais pratique :
  * Java: public native void release();
@@ -0,0 +1,294 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Decode_Service.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <jpeglib.h>
+
+// Echelles IDCT de libjpeg : scale_num / SCALE_DENOM
+#define SCALE_DENOM 8
+
+struct Jpeg_Error {
+    jpeg_error_mgr mgr;
+    jmp_buf jump;
+};
+
+static void onJpegError(j_common_ptr cinfo) {
+    longjmp(reinterpret_cast<Jpeg_Error *>(cinfo->err)->jump, 1);
+}
+
+static void onJpegMessage(j_common_ptr) {
+    // Avertissements (donnees tronquees...) : la frame decodee reste utilisable
+}
+
+// Taille finale : une dimension a 0 suit le ratio de l'autre, les deux a 0 = taille native.
+// Jamais plus grande que la source : une demande trop grande est ramenee dedans, ratio conserve
+static void targetSize(int src_w, int src_h, int want_w, int want_h, int &w, int &h) {
+    int64_t tw, th;
+    if (want_w <= 0 && want_h <= 0) {
+        tw = src_w;
+        th = src_h;
+    } else if (want_h <= 0) {
+        tw = want_w;
+        th = std::max<int64_t>(1, (int64_t)src_h * want_w / src_w);
+    } else if (want_w <= 0) {
+        tw = std::max<int64_t>(1, (int64_t)src_w * want_h / src_h);
+        th = want_h;
+    } else {
+        tw = want_w;
+        th = want_h;
+    }
+    if (tw > src_w || th > src_h) {
+        if (tw * src_h >= th * src_w) {
+            th = std::max<int64_t>(1, th * src_w / tw);
+            tw = src_w;
+        } else {
+            tw = std::max<int64_t>(1, tw * src_h / th);
+            th = src_h;
+        }
+    }
+    w = (int)tw;
+    h = (int)th;
+}
+
+// Moyenne par zones (reduction)
+static void resampleArea(const uint8_t *src, int sw, int sh, int ch,
+                         uint8_t *dst, int dw, int dh) {
+    for (int y = 0; y < dh; y++) {
+        int y0 = (int)((int64_t)y * sh / dh);
+        int y1 = std::max(y0 + 1, (int)((int64_t)(y + 1) * sh / dh));
+        for (int x = 0; x < dw; x++) {
+            int x0 = (int)((int64_t)x * sw / dw);
+            int x1 = std::max(x0 + 1, (int)((int64_t)(x + 1) * sw / dw));
+            int area = (y1 - y0) * (x1 - x0);
+            for (int c = 0; c < ch; c++) {
+                int sum = 0;
+                for (int yy = y0; yy < y1; yy++) {
+                    const uint8_t *row = src + ((size_t)yy * sw + x0) * ch + c;
+                    for (int xx = x0; xx < x1; xx++, row += ch) {
+                        sum += *row;
+                    }
+                }
+                dst[((size_t)y * dw + x) * ch + c] = (uint8_t)((sum + area / 2) / area);
+            }
+        }
+    }
+}
+
+/**
+ * Decode a la plus petite echelle M/8 qui couvre encore la taille demandee.
+ * @param scaled  sortie de libjpeg (declaree par l'appelant : rien a detruire
+ *                dans cette fonction si libjpeg saute au setjmp)
+ */
+static bool decodeScaled(const uint8_t *data, size_t len, const Decode_Request &req,
+                         std::vector<uint8_t> &scaled, Decoded_Image &out) {
+    jpeg_decompress_struct cinfo;
+    Jpeg_Error err;
+    cinfo.err = jpeg_std_error(&err.mgr);
+    err.mgr.error_exit = onJpegError;
+    err.mgr.output_message = onJpegMessage;
+
+    if (setjmp(err.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, const_cast<unsigned char *>(data), (unsigned long)len);
+    jpeg_read_header(&cinfo, TRUE);
+
+    int dst_w, dst_h;
+    targetSize((int)cinfo.image_width, (int)cinfo.image_height, req.width, req.height, dst_w, dst_h);
+
+    // Plus petite echelle dont la sortie couvre dst (libjpeg arrondit au superieur)
+    int num = 1;
+    while (num < SCALE_DENOM &&
+           (((int64_t)cinfo.image_width * num + SCALE_DENOM - 1) / SCALE_DENOM < dst_w ||
+            ((int64_t)cinfo.image_height * num + SCALE_DENOM - 1) / SCALE_DENOM < dst_h)) {
+        num++;
+    }
+    cinfo.scale_num = num;
+    cinfo.scale_denom = SCALE_DENOM;
+    cinfo.out_color_space = req.gray ? JCS_GRAYSCALE : JCS_RGB;
+
+    jpeg_start_decompress(&cinfo);
+    int w = (int)cinfo.output_width;
+    int h = (int)cinfo.output_height;
+    int ch = cinfo.output_components;
+    size_t stride = (size_t)w * ch;
+
+    // Taille exacte : libjpeg ecrit directement dans l'image finale
+    bool exact = (w == dst_w && h == dst_h);
+    std::vector<uint8_t> &target = exact ? out.pixels : scaled;
+    target.resize(stride * h);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = target.data() + stride * cinfo.output_scanline;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+
+    if (!exact) {
+        out.pixels.resize((size_t)dst_w * dst_h * ch);
+        resampleArea(scaled.data(), w, h, ch, out.pixels.data(), dst_w, dst_h);
+    }
+    out.width = dst_w;
+    out.height = dst_h;
+    out.channels = ch;
+    out.scale_num = num;
+    return true;
+}
+
+// Redresse image d'apres image.orientation ; scratch = tampon de travail, echange avec les pixels
+static void orientPixels(Decoded_Image &image, std::vector<uint8_t> &scratch) {
+    uint8_t orientation = image.orientation;
+    int w = image.width;
+    int h = image.height;
+    int ch = image.channels;
+    int out_w = (orientation & 1) ? h : w;
+    int out_h = (orientation & 1) ? w : h;
+
+    // Transformation affine : pixel source de (0, 0), puis pas en x et en y de l'image droite
+    float x0 = 0.5f, y0 = 0.5f, x1 = 1.5f, y1 = 0.5f, x2 = 0.5f, y2 = 1.5f;
+    UnorientPoint(orientation, (float)w, (float)h, x0, y0);
+    UnorientPoint(orientation, (float)w, (float)h, x1, y1);
+    UnorientPoint(orientation, (float)w, (float)h, x2, y2);
+    long origin = ((long)y0 * w + (long)x0) * ch;
+    long step_x = ((long)(y1 - y0) * w + (long)(x1 - x0)) * ch;
+    long step_y = ((long)(y2 - y0) * w + (long)(x2 - x0)) * ch;
+
+    scratch.resize((size_t)out_w * out_h * ch);
+    uint8_t *dst = scratch.data();
+    for (int y = 0; y < out_h; y++) {
+        const uint8_t *src = image.pixels.data() + origin + y * step_y;
+        for (int x = 0; x < out_w; x++, src += step_x, dst += ch) {
+            memcpy(dst, src, ch);
+        }
+    }
+    image.pixels.swap(scratch);
+    image.width = out_w;
+    image.height = out_h;
+    image.orientation = 0;
+}
+
+bool Decode_Service::DecodeJpeg(const uint8_t *data, size_t length, const Decode_Request &req,
+                                Decoded_Image &out, uint8_t orientation) {
+    std::vector<uint8_t> scaled;
+    // Taille demandee pour l'image droite : celle de l'image recue est transposee
+    Decode_Request want = req;
+    if (req.upright && (orientation & 1)) std::swap(want.width, want.height);
+    if (!decodeScaled(data, length, want, scaled, out)) return false;
+
+    out.orientation = orientation;
+    if (req.upright && orientation != 0) orientPixels(out, scaled);
+    return true;
+}
+
+Decode_Service::Decode_Service(size_t history, size_t cache)
+        : history_(std::max<size_t>(history, 1)), cache_size_(std::max<size_t>(cache, 1)) {
+}
+
+void Decode_Service::Publish(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &frame) {
+    if (frame->header.codec != CODEC_JPEG) return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stream &stream = streams_[stream_id];
+    stream.frames.push_front(frame);
+    if (stream.frames.size() > history_) {
+        stream.frames.pop_back();
+    }
+}
+
+void Decode_Service::EndStream(uint32_t stream_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    streams_.erase(stream_id);
+}
+
+std::shared_ptr<const Decoded_Image> Decode_Service::Decode(const Decode_Request &req) {
+    // Le decodage se fait hors verrou : Publish() (boucle d'ingestion) n'attend jamais.
+    // Une demande identique deja en cours est attendue au lieu d'etre refaite.
+    std::shared_ptr<const Ingest_Frame> frame;
+    std::shared_future<std::shared_ptr<const Decoded_Image>> pending;
+    std::promise<std::shared_ptr<const Decoded_Image>> promise;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = streams_.find(req.stream_id);
+        if (it == streams_.end() || it->second.frames.empty()) {
+            stats_.failures++;
+            return nullptr;
+        }
+        Stream &stream = it->second;
+
+        if (req.latest) {
+            frame = stream.frames.front();
+        } else {
+            for (const auto &f : stream.frames) {
+                if (f->header.sequence == req.sequence) {
+                    frame = f;
+                    break;
+                }
+            }
+        }
+        if (!frame) {
+            stats_.failures++;
+            return nullptr;
+        }
+
+        uint32_t seq = frame->header.sequence;
+        for (auto c = stream.cache.begin(); c != stream.cache.end(); ++c) {
+            if (c->sequence == seq && c->width == req.width && c->height == req.height &&
+                c->gray == req.gray && c->upright == req.upright) {
+                Cached hit = *c;
+                stream.cache.erase(c);
+                stream.cache.push_front(hit);
+                stats_.cache_hits++;
+                pending = hit.image;
+                break;
+            }
+        }
+        if (!pending.valid()) {
+            // Entree en cours : visible des autres demandeurs avant la fin du decodage
+            stream.cache.push_front(Cached{seq, req.width, req.height, req.gray, req.upright,
+                                           promise.get_future().share()});
+            if (stream.cache.size() > cache_size_) {
+                stream.cache.pop_back();
+            }
+        }
+    }
+    if (pending.valid()) {
+        return pending.get();
+    }
+
+    uint32_t seq = frame->header.sequence;
+    uint64_t t0 = ProtoClockMicros();
+    auto image = std::make_shared<Decoded_Image>();
+    image->stream_id = req.stream_id;
+    image->sequence = seq;
+    bool ok = DecodeJpeg(frame->payload.data(), frame->payload.size(), req, *image,
+                         frame->header.orientation);
+    uint64_t elapsed = ProtoClockMicros() - t0;
+
+    // Un JPEG illisible le reste : l'echec est garde en cache comme une image
+    promise.set_value(ok ? std::shared_ptr<const Decoded_Image>(image) : nullptr);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!ok) {
+        LOGE("stream %u: jpeg decode failed on seq=%u", req.stream_id, seq);
+        stats_.failures++;
+        return nullptr;
+    }
+    stats_.decodes++;
+    stats_.decode_us += elapsed;
+    return image;
+}
+
+Decode_Stats Decode_Service::Stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
@@ -0,0 +1,299 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Dnn_Detector.h"
+#include "headers/Decode_Service.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <opencv2/core.hpp>
+
+// Colonnes d'une ligne DetectionOutput : image, classe, confiance, x1, y1, x2, y2
+#define DETECTION_COLUMNS 7
+
+Dnn_Detector::Dnn_Detector(const Dnn_Config &config)
+        : config_(config),
+          period_us_(config.fps > 0 ? (uint64_t)(1e6 / config.fps) : 0) {
+    config_.batch = std::max(config_.batch, 1);
+}
+
+Dnn_Detector::~Dnn_Detector() {
+    Stop();
+}
+
+bool Dnn_Detector::Start() {
+    try {
+        net_ = cv::dnn::readNet(config_.model, config_.config);
+    } catch (const cv::Exception &e) {
+        LOGE("dnn: cannot load %s: %s", config_.model.c_str(), e.what());
+        return false;
+    }
+    if (net_.empty()) {
+        LOGE("dnn: cannot load %s", config_.model.c_str());
+        return false;
+    }
+    net_.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+    net_.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+    if (config_.threads > 0) {
+        cv::setNumThreads(config_.threads);
+    }
+
+    thread_ = std::thread(&Dnn_Detector::analyzeLoop, this);
+    LOGI("dnn: %s, batch %d within %d ms, %.1f fps per stream, %d threads", config_.model.c_str(),
+         config_.batch, config_.window_ms, config_.fps, cv::getNumThreads());
+    return true;
+}
+
+void Dnn_Detector::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+        Dnn_Stats stats = Stats();
+        LOGI("dnn stopped: %llu frames in %llu batches (%.1f per batch), %llu replaced, "
+             "decode %.2f ms/frame, forward %.2f ms/frame",
+             (unsigned long long)stats.frames, (unsigned long long)stats.batches,
+             stats.batches ? (double)stats.frames / (double)stats.batches : 0.0,
+             (unsigned long long)stats.replaced,
+             stats.frames ? (double)stats.decode_us / 1000.0 / (double)stats.frames : 0.0,
+             stats.frames ? (double)stats.infer_us / 1000.0 / (double)stats.frames : 0.0);
+    }
+}
+
+void Dnn_Detector::Publish(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &frame) {
+    if (frame->header.codec != CODEC_JPEG) return;
+
+    bool ready;
+    bool replaced;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Stream &s = streams_[stream_id];
+        replaced = s.pending != nullptr;
+        s.pending = frame;
+        ready = s.next_us <= frame->recv_us;
+    }
+    if (replaced) {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.replaced++;
+    }
+    if (ready) {
+        cv_.notify_one();
+    }
+}
+
+void Dnn_Detector::EndStream(uint32_t stream_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    streams_.erase(stream_id);
+}
+
+Dnn_Stats Dnn_Detector::Stats() {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return stats_;
+}
+
+size_t Dnn_Detector::readyCount(uint64_t now, uint64_t &earliest) const {
+    size_t ready = 0;
+    earliest = UINT64_MAX;
+    for (auto &entry : streams_) {
+        const Stream &s = entry.second;
+        if (!s.pending) continue;
+        if (s.next_us <= now) {
+            ready++;
+        } else {
+            earliest = std::min(earliest, s.next_us);
+        }
+    }
+    return ready;
+}
+
+void Dnn_Detector::analyzeLoop() {
+    std::vector<Job> jobs;
+    std::vector<std::pair<uint64_t, uint32_t>> ready;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+
+            // Au moins un flux pret, ou la prochaine echeance d'un flux limite par fps
+            for (;;) {
+                if (stop_) return;
+                uint64_t now = ProtoClockMicros();
+                uint64_t earliest;
+                if (readyCount(now, earliest) > 0) break;
+                if (earliest == UINT64_MAX) {
+                    cv_.wait(lock);
+                } else {
+                    cv_.wait_for(lock, std::chrono::microseconds(earliest - now));
+                }
+            }
+
+            // Fenetre pour completer le lot : au plus window_ms apres le premier flux pret
+            auto deadline = std::chrono::steady_clock::now() +
+                            std::chrono::milliseconds(config_.window_ms);
+            uint64_t earliest;
+            while (!stop_ && readyCount(ProtoClockMicros(), earliest) < (size_t)config_.batch) {
+                if (cv_.wait_until(lock, deadline) == std::cv_status::timeout) break;
+            }
+            if (stop_) return;
+
+            // Les flux qui attendent depuis le plus longtemps d'abord
+            uint64_t now = ProtoClockMicros();
+            ready.clear();
+            for (auto &entry : streams_) {
+                if (entry.second.pending && entry.second.next_us <= now) {
+                    ready.emplace_back(entry.second.next_us, entry.first);
+                }
+            }
+            std::sort(ready.begin(), ready.end());
+            if (ready.size() > (size_t)config_.batch) ready.resize(config_.batch);
+
+            jobs.clear();
+            for (auto &item : ready) {
+                Stream &s = streams_[item.second];
+                jobs.push_back(Job{item.second, std::move(s.pending)});
+                s.pending.reset();
+                s.next_us = now + period_us_;
+            }
+        }
+        runBatch(jobs);
+    }
+}
+
+std::shared_ptr<Ingest_Frame> Dnn_Detector::encodeResults(const Ingest_Frame &frame,
+                                                          const Detection_Result &result) {
+    size_t count = std::min<size_t>(result.detections.size(), UINT16_MAX);
+    std::vector<Result_Object> objects(count);
+    std::string labels;
+    float w = frame.header.width;
+    float h = frame.header.height;
+    for (size_t i = 0; i < count; i++) {
+        const Detection &d = result.detections[i];
+        const char *label = d.class_id >= 0 && d.class_id < VOC_CLASSES ? VOC_LABELS[d.class_id] : "";
+        Result_Object &o = objects[i];
+        o.kind = RESULT_OBJECT;
+        o.class_id = (uint16_t)d.class_id;
+        o.confidence = d.confidence;
+        o.box[0] = (int16_t)(d.x * w);
+        o.box[1] = (int16_t)(d.y * h);
+        o.box[2] = (int16_t)(d.w * w);
+        o.box[3] = (int16_t)(d.h * h);
+        o.text_offset = (uint16_t)labels.size();
+        o.text_length = (uint16_t)strlen(label);
+        labels += label;
+    }
+
+    auto message = std::make_shared<Ingest_Frame>();
+    message->payload = EncodeResults(ANALYSIS_SERVER, result.infer_us / std::max(result.batch, 1u),
+                                     objects.data(), (uint16_t)count, labels.data(),
+                                     (uint32_t)labels.size());
+    InitHeaderV2(&message->header, MSG_RESULTS, (uint32_t)message->payload.size());
+    message->header.sequence = frame.header.sequence;
+    message->header.capture_ts_us = frame.header.capture_ts_us;
+    message->header.width = frame.header.width;
+    message->header.height = frame.header.height;
+    message->recv_us = result.done_us;
+    return message;
+}
+
+void Dnn_Detector::runBatch(std::vector<Job> &jobs) {
+    // Decodage direct a la taille d'entree du reseau, sans passer par la taille native ;
+    // redresse pour le reseau (frames en orientation capteur), a cette petite taille
+    Decode_Request req;
+    req.width = config_.input_width;
+    req.height = config_.input_height;
+    req.upright = true;
+
+    uint64_t t0 = ProtoClockMicros();
+    std::vector<Decoded_Image> decoded(jobs.size());
+    std::vector<cv::Mat> images;
+    std::vector<const Job *> owners;
+    uint64_t failures = 0;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const Ingest_Frame &frame = *jobs[i].frame;
+        if (!Decode_Service::DecodeJpeg(frame.payload.data(), frame.payload.size(), req, decoded[i],
+                                        frame.header.orientation)) {
+            failures++;
+            continue;
+        }
+        images.emplace_back(decoded[i].height, decoded[i].width, CV_8UC3, decoded[i].pixels.data());
+        owners.push_back(&jobs[i]);
+    }
+    uint64_t t1 = ProtoClockMicros();
+
+    cv::Mat out;
+    if (!images.empty()) {
+        try {
+            // Decode en RGB, le reseau (Caffe) attend du BGR : swapRB
+            cv::Mat blob = cv::dnn::blobFromImages(
+                    images, config_.scale, cv::Size(config_.input_width, config_.input_height),
+                    cv::Scalar(config_.mean, config_.mean, config_.mean), true, false);
+            net_.setInput(blob);
+            out = net_.forward();
+        } catch (const cv::Exception &e) {
+            LOGE("dnn: forward failed on %zu frames: %s", images.size(), e.what());
+            failures += images.size();
+            images.clear();
+        }
+    }
+    uint64_t t2 = ProtoClockMicros();
+
+    std::vector<Detection_Result> results(images.size());
+    for (size_t i = 0; i < images.size(); i++) {
+        const Ingest_Frame &frame = *owners[i]->frame;
+        results[i].stream_id = owners[i]->stream_id;
+        results[i].sequence = frame.header.sequence;
+        results[i].capture_ts_us = frame.header.capture_ts_us;
+        results[i].done_us = t2;
+        results[i].batch = (uint32_t)images.size();
+        results[i].infer_us = (uint32_t)(t2 - t1);
+    }
+
+    // DetectionOutput : [1, 1, lignes, 7], chaque ligne porte l'indice de son image dans le lot
+    if (!images.empty() && out.dims == 4 && out.size[3] == DETECTION_COLUMNS) {
+        const float *row = out.ptr<float>();
+        for (int r = 0; r < out.size[2]; r++, row += DETECTION_COLUMNS) {
+            int image = (int)row[0];
+            if (image < 0 || image >= (int)results.size() || row[2] < config_.threshold) continue;
+
+            float x1 = std::min(std::max(row[3], 0.0f), 1.0f);
+            float y1 = std::min(std::max(row[4], 0.0f), 1.0f);
+            float x2 = std::min(std::max(row[5], 0.0f), 1.0f);
+            float y2 = std::min(std::max(row[6], 0.0f), 1.0f);
+            // Boite de l'image droite -> frame telle que recue (coordonnees normalisees)
+            uint8_t orientation = owners[image]->frame->header.orientation;
+            UnorientPoint(orientation, 1.0f, 1.0f, x1, y1);
+            UnorientPoint(orientation, 1.0f, 1.0f, x2, y2);
+            results[image].detections.push_back(
+                    Detection{(int)row[1], row[2], std::min(x1, x2), std::min(y1, y2),
+                              std::fabs(x2 - x1), std::fabs(y2 - y1)});
+        }
+    } else if (!images.empty()) {
+        LOGE("dnn: unexpected output (%d dims), not an SSD DetectionOutput", out.dims);
+    }
+
+    for (size_t i = 0; i < results.size(); i++) {
+        for (Detection_Sink *sink : sinks_) {
+            sink->OnDetections(results[i]);
+        }
+        if (!results_sinks_.empty()) {
+            std::shared_ptr<const Ingest_Frame> message = encodeResults(*owners[i]->frame, results[i]);
+            for (Frame_Sink *sink : results_sinks_) {
+                sink->PublishResults(results[i].stream_id, message);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    if (!images.empty()) stats_.batches++;
+    stats_.frames += images.size();
+    stats_.failures += failures;
+    stats_.decode_us += t1 - t0;
+    stats_.infer_us += t2 - t1;
+}
@@ -0,0 +1,243 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Frame_Ring.h"
+#include "Util.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// Essais de PinLatest() quand l'emplacement le plus recent est reecrit entre-temps
+#define PIN_ATTEMPTS 4
+
+Frame_Ring_Writer::~Frame_Ring_Writer() {
+    Close();
+}
+
+bool Frame_Ring_Writer::Create(const std::string &name, uint32_t stream_id,
+                               uint32_t slot_count, uint32_t slot_bytes) {
+    size_t bytes = RingBytes(slot_count, slot_bytes);
+    // Nouveau fichier, jamais tronque sous un lecteur : un reste d'une execution precedente
+    // (memes numeros de flux) est seulement detache du nom
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOGE("shm_open %s failed: %s", name.c_str(), strerror(errno));
+        return false;
+    }
+    if (ftruncate(fd, (off_t)bytes) < 0) {
+        LOGE("ftruncate %s failed: %s", name.c_str(), strerror(errno));
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void *map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        LOGE("mmap %s failed: %s", name.c_str(), strerror(errno));
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    name_ = name;
+    base_ = (uint8_t *)map;
+    bytes_ = bytes;
+
+    // Fichier neuf, tout a zero : seul l'en-tete est a remplir
+    auto *hdr = (Ring_Header *)base_;
+    hdr->version = SHARED_STREAM_VERSION;
+    hdr->stream_id = stream_id;
+    hdr->slot_count = slot_count;
+    hdr->slot_bytes = slot_bytes;
+    hdr->slot_stride = RingSlotStride(slot_bytes);
+    hdr->latest = slot_count - 1;  // la premiere frame ira dans l'emplacement 0
+    __atomic_store_n(&hdr->magic, FRAME_RING_MAGIC, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool Frame_Ring_Writer::HasReaders() const {
+    if (base_ == nullptr) return false;
+    return __atomic_load_n(&((const Ring_Header *)base_)->readers, __ATOMIC_ACQUIRE) > 0;
+}
+
+bool Frame_Ring_Writer::Publish(const Ingest_Frame &frame) {
+    if (base_ == nullptr) return false;
+    auto *hdr = (Ring_Header *)base_;
+    size_t length = frame.payload.size();
+    if (length > hdr->slot_bytes) {
+        __atomic_add_fetch(&hdr->dropped, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    // Seul ecrivain : latest et published ne changent que par ici
+    uint64_t published = hdr->published;
+    for (uint32_t k = 1; k <= hdr->slot_count; k++) {
+        uint32_t i = (hdr->latest + k) % hdr->slot_count;
+        auto *slot = (Ring_Slot *)(base_ + RING_SLOTS_OFFSET + (size_t)i * hdr->slot_stride);
+        if (__atomic_load_n(&slot->pins, __ATOMIC_ACQUIRE) != 0) continue;
+
+        // seq impair puis relecture de pins, le lecteur fait l'inverse : l'un des deux voit l'autre
+        uint32_t seq = slot->seq;
+        __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&slot->pins, __ATOMIC_SEQ_CST) != 0) {
+            // Epingle entre-temps : rien n'a ete touche, seq revient a sa valeur
+            __atomic_store_n(&slot->seq, seq, __ATOMIC_RELEASE);
+            continue;
+        }
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        slot->index = published + 1;
+        slot->recv_us = frame.recv_us;
+        slot->header = frame.header;
+        slot->length = (uint32_t)length;
+        memcpy((uint8_t *)slot + sizeof(Ring_Slot), frame.payload.data(), length);
+
+        __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+        __atomic_store_n(&hdr->latest, i, __ATOMIC_RELEASE);
+        __atomic_store_n(&hdr->published, published + 1, __ATOMIC_RELEASE);
+        notify();
+        return true;
+    }
+
+    // Tous les emplacements sont epingles par des lecteurs lents
+    __atomic_add_fetch(&hdr->dropped, 1, __ATOMIC_RELAXED);
+    return false;
+}
+
+void Frame_Ring_Writer::Close() {
+    if (base_ == nullptr) return;
+    __atomic_store_n(&((Ring_Header *)base_)->closed, 1u, __ATOMIC_RELEASE);
+    notify();
+    munmap(base_, bytes_);
+    shm_unlink(name_.c_str());
+    base_ = nullptr;
+}
+
+void Frame_Ring_Writer::notify() {
+    auto *hdr = (Ring_Header *)base_;
+    // Increment puis lecture de waiters ; Wait() fait l'inverse : l'un des deux voit l'autre
+    __atomic_add_fetch(&hdr->notify, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&hdr->waiters, __ATOMIC_SEQ_CST) != 0) {
+        // Futex partage (pas de FUTEX_PRIVATE_FLAG) : les lecteurs sont dans d'autres processus
+        syscall(SYS_futex, &hdr->notify, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+}
+
+Ring_Pin::~Ring_Pin() {
+    if (slot != nullptr) {
+        __atomic_sub_fetch(&slot->pins, 1, __ATOMIC_RELEASE);
+    }
+}
+
+Frame_Ring_Reader::~Frame_Ring_Reader() {
+    if (base_ != nullptr) {
+        __atomic_sub_fetch(&((Ring_Header *)base_)->readers, 1u, __ATOMIC_RELEASE);
+        munmap(base_, bytes_);
+    }
+}
+
+bool Frame_Ring_Reader::Open(const std::string &name) {
+    int fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) {
+        LOGE("shm_open %s failed: %s", name.c_str(), strerror(errno));
+        return false;
+    }
+
+    // En-tete d'abord : la taille totale en depend
+    Ring_Header hdr{};
+    if (pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) || hdr.magic != FRAME_RING_MAGIC ||
+        hdr.version != SHARED_STREAM_VERSION || hdr.slot_count == 0 ||
+        hdr.slot_stride != RingSlotStride(hdr.slot_bytes)) {
+        LOGE("%s: not a frame ring", name.c_str());
+        close(fd);
+        return false;
+    }
+    size_t bytes = RingBytes(hdr.slot_count, hdr.slot_bytes);
+    void *map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        LOGE("mmap %s failed: %s", name.c_str(), strerror(errno));
+        return false;
+    }
+    base_ = (uint8_t *)map;
+    bytes_ = bytes;
+    __atomic_add_fetch(&((Ring_Header *)base_)->readers, 1u, __ATOMIC_ACQ_REL);
+    return true;
+}
+
+uint64_t Frame_Ring_Reader::Published() const {
+    return __atomic_load_n(&header()->published, __ATOMIC_ACQUIRE);
+}
+
+bool Frame_Ring_Reader::Closed() const {
+    return __atomic_load_n(&header()->closed, __ATOMIC_ACQUIRE) != 0;
+}
+
+std::shared_ptr<const Ring_Pin> Frame_Ring_Reader::PinLatest() const {
+    for (int attempt = 0; attempt < PIN_ATTEMPTS; attempt++) {
+        if (Published() == 0) return nullptr;
+        Ring_Slot *s = slot(__atomic_load_n(&header()->latest, __ATOMIC_ACQUIRE));
+
+        __atomic_add_fetch(&s->pins, 1, __ATOMIC_SEQ_CST);
+        uint32_t seq = __atomic_load_n(&s->seq, __ATOMIC_SEQ_CST);
+        if (seq != 0 && (seq & 1u) == 0) {
+            // Epingle et complet : l'ecrivain n'y touchera plus
+            auto pin = std::make_shared<Ring_Pin>();
+            pin->ring = shared_from_this();
+            pin->slot = s;
+            pin->data = (const uint8_t *)s + sizeof(Ring_Slot);
+            pin->length = s->length;
+            pin->index = s->index;
+            return pin;
+        }
+        __atomic_sub_fetch(&s->pins, 1, __ATOMIC_RELEASE);
+    }
+    return nullptr;
+}
+
+bool Frame_Ring_Reader::Wait(uint64_t seen, int timeout_ms) const {
+    auto *hdr = (Ring_Header *)base_;
+    timespec deadline{};
+    if (timeout_ms >= 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    for (;;) {
+        uint32_t ticket = __atomic_load_n(&hdr->notify, __ATOMIC_ACQUIRE);
+        if (Published() > seen || Closed()) return true;
+
+        timespec left{};
+        if (timeout_ms >= 0) {
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            left.tv_sec = deadline.tv_sec - now.tv_sec;
+            left.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+            if (left.tv_nsec < 0) {
+                left.tv_sec--;
+                left.tv_nsec += 1000000000L;
+            }
+            if (left.tv_sec < 0) return false;
+        }
+
+        __atomic_add_fetch(&hdr->waiters, 1, __ATOMIC_SEQ_CST);
+        // Publication entre la lecture de ticket et ici : notify a change, FUTEX_WAIT rend la main
+        if (__atomic_load_n(&hdr->notify, __ATOMIC_SEQ_CST) == ticket) {
+            syscall(SYS_futex, &hdr->notify, FUTEX_WAIT, ticket, timeout_ms >= 0 ? &left : nullptr,
+                    nullptr, 0);
+        }
+        __atomic_sub_fetch(&hdr->waiters, 1, __ATOMIC_SEQ_CST);
+    }
+}
@@ -0,0 +1,328 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Impair_Relay.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Lecture par appel
+#define RELAY_CHUNK 65536
+
+// Octets retenus par sens avant de suspendre la lecture, sans limite de debit
+#define RELAY_QUEUE_LIMIT (8u << 20)
+
+// Tampon du goulet d'etranglement quand le debit est limite, en ms au debit max
+#define RELAY_BOTTLENECK_MS 100
+
+// Charge utile d'un segment TCP, pour convertir la perte par paquet
+#define RELAY_MSS 1448
+
+static uint64_t monoMicros() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+Impair_Relay::Impair_Relay(const std::string &host, int port, const Impairment &impairment)
+        : host_(host), port_(port), impairment_(impairment) {
+    // Au debit max, retenir plus que latence + tampon du goulet ne ferait que
+    // cacher la congestion a l'emetteur
+    queue_limit_ = RELAY_QUEUE_LIMIT;
+    if (impairment_.rate_kbps > 0) {
+        uint64_t ms = (uint64_t)(impairment_.delay_ms + impairment_.jitter_ms + RELAY_BOTTLENECK_MS);
+        queue_limit_ = std::max<size_t>(RELAY_CHUNK, (size_t)((uint64_t)impairment_.rate_kbps * ms / 8u));
+    }
+}
+
+Impair_Relay::~Impair_Relay() {
+    Stop();
+}
+
+bool Impair_Relay::Start() {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        LOGE("relay socket failed: %s", strerror(errno));
+        return false;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = 0;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(listen_fd_, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd_, SOMAXCONN) < 0 ||
+        getsockname(listen_fd_, (sockaddr *)&addr, &len) < 0) {
+        LOGE("relay listen failed: %s", strerror(errno));
+        return false;
+    }
+    listen_port_ = ntohs(addr.sin_port);
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+
+    LOGI("relay 127.0.0.1:%d -> %s:%d (delay %d+-%d ms, %d kbit/s, loss %.2f%%)", listen_port_,
+         host_.c_str(), port_, impairment_.delay_ms, impairment_.jitter_ms, impairment_.rate_kbps,
+         impairment_.loss * 100.0);
+    stop_ = false;
+    thread_ = std::thread(&Impair_Relay::loop, this);
+    return true;
+}
+
+void Impair_Relay::Stop() {
+    stop_ = true;
+    if (thread_.joinable()) thread_.join();
+
+    // Chaque lien est reference par ses deux fd
+    while (!links_.empty()) {
+        closeLink(links_.begin()->second.get());
+    }
+    if (epoll_fd_ >= 0) {
+        close(epoll_fd_);
+        epoll_fd_ = -1;
+    }
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        listen_fd_ = -1;
+    }
+}
+
+void Impair_Relay::loop() {
+    epoll_event events[64];
+    while (!stop_) {
+        // Reveil a la prochaine echeance, et au plus tard toutes les 100 ms pour stop_
+        int timeout = 100;
+        uint64_t due = nextDue();
+        if (due != 0) {
+            uint64_t now = monoMicros();
+            timeout = due <= now ? 0 : (int)std::min<uint64_t>((due - now + 999) / 1000, 100);
+        }
+
+        int n = epoll_wait(epoll_fd_, events, 64, timeout);
+        if (n < 0 && errno != EINTR) {
+            LOGE("relay epoll_wait failed: %s", strerror(errno));
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd_) {
+                acceptAll();
+                continue;
+            }
+            auto it = links_.find(fd);
+            if (it == links_.end()) continue;  // ferme plus haut dans ce lot
+
+            std::shared_ptr<Link> link = it->second;
+            bool keep = !(events[i].events & EPOLLERR);
+            if (keep && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP))) {
+                keep = readSide(link.get(), fd == link->client ? link->up : link->down);
+            }
+            if (keep && (events[i].events & EPOLLOUT)) {
+                (fd == link->client ? link->down : link->up).blocked = false;
+            }
+            if (!keep) {
+                closeLink(link.get());
+            }
+        }
+
+        // Morceaux arrives a echeance
+        std::vector<std::shared_ptr<Link>> done;
+        for (auto &entry : links_) {
+            Link *link = entry.second.get();
+            if (entry.first != link->client) continue;  // un passage par lien
+            bool keep = writeSide(link->up) && writeSide(link->down);
+            if (keep && link->up.shut && link->down.shut) keep = false;
+            if (keep) {
+                updateEvents(link);
+            } else {
+                done.push_back(entry.second);
+            }
+        }
+        for (auto &link : done) {
+            closeLink(link.get());
+        }
+    }
+}
+
+void Impair_Relay::acceptAll() {
+    for (;;) {
+        int client = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                LOGE("relay accept4 failed: %s", strerror(errno));
+            }
+            return;
+        }
+
+        // Connexion bloquante au serveur (locale ou LAN : immediate)
+        int server = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port_);
+        if (server < 0 || inet_pton(AF_INET, host_.c_str(), &addr.sin_addr) != 1 ||
+            connect(server, (sockaddr *)&addr, sizeof(addr)) < 0) {
+            LOGE("relay connect %s:%d failed: %s", host_.c_str(), port_, strerror(errno));
+            if (server >= 0) close(server);
+            close(client);
+            continue;
+        }
+        int one = 1;
+        setsockopt(server, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(server, F_SETFL, fcntl(server, F_GETFL) | O_NONBLOCK);
+
+        auto link = std::make_shared<Link>();
+        link->client = client;
+        link->server = server;
+        link->up.src = client;
+        link->up.dst = server;
+        link->down.src = server;
+        link->down.dst = client;
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = client;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, client, &ev);
+        ev.data.fd = server;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, server, &ev);
+        links_[client] = link;
+        links_[server] = link;
+    }
+}
+
+uint64_t Impair_Relay::dueFor(Direction &dir, size_t bytes) {
+    uint64_t now = monoMicros();
+
+    // Emission au debit max, a la suite du morceau precedent
+    uint64_t sent = now;
+    if (impairment_.rate_kbps > 0) {
+        sent = std::max(now, dir.link_free_us) + (uint64_t)bytes * 8000u / (uint64_t)impairment_.rate_kbps;
+        dir.link_free_us = sent;
+    }
+
+    int64_t delay_us = (int64_t)impairment_.delay_ms * 1000;
+    if (impairment_.jitter_ms > 0) {
+        std::uniform_int_distribution<int64_t> jitter(-impairment_.jitter_ms * 1000, impairment_.jitter_ms * 1000);
+        delay_us = std::max<int64_t>(0, delay_us + jitter(rng_));
+    }
+
+    // Au moins un paquet perdu dans le morceau : tout le flux attend la retransmission
+    if (impairment_.loss > 0) {
+        double packets = std::ceil((double)bytes / RELAY_MSS);
+        double hit = 1.0 - std::pow(1.0 - impairment_.loss, packets);
+        if (std::uniform_real_distribution<double>(0.0, 1.0)(rng_) < hit) {
+            delay_us += (int64_t)impairment_.loss_stall_ms * 1000;
+        }
+    }
+
+    uint64_t due = std::max(sent + (uint64_t)delay_us, dir.last_due_us);
+    dir.last_due_us = due;
+    return due;
+}
+
+bool Impair_Relay::readSide(Link *link, Direction &dir) {
+    while (!dir.eof && dir.queued < queue_limit_) {
+        Chunk chunk;
+        chunk.data.resize(RELAY_CHUNK);
+        ssize_t r = recv(dir.src, chunk.data.data(), chunk.data.size(), 0);
+        if (r == 0) {
+            dir.eof = true;
+            break;
+        }
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        chunk.data.resize((size_t)r);
+        chunk.due_us = dueFor(dir, (size_t)r);
+        dir.queued += (size_t)r;
+        dir.chunks.push_back(std::move(chunk));
+    }
+    updateEvents(link);
+    return true;
+}
+
+bool Impair_Relay::writeSide(Direction &dir) {
+    uint64_t now = monoMicros();
+    while (!dir.blocked && !dir.chunks.empty() && dir.chunks.front().due_us <= now) {
+        Chunk &chunk = dir.chunks.front();
+        ssize_t w = send(dir.dst, chunk.data.data() + chunk.sent, chunk.data.size() - chunk.sent,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                dir.blocked = true;
+                break;
+            }
+            return false;
+        }
+        chunk.sent += (size_t)w;
+        dir.queued -= (size_t)w;
+        if (chunk.sent == chunk.data.size()) {
+            dir.chunks.pop_front();
+        }
+    }
+    // Fin de flux transmise une fois tout relaye
+    if (dir.eof && dir.chunks.empty() && !dir.shut) {
+        shutdown(dir.dst, SHUT_WR);
+        dir.shut = true;
+    }
+    return true;
+}
+
+void Impair_Relay::updateEvents(Link *link) {
+    // Lecture du client : sens montant ; ecriture vers le client : sens descendant
+    const int fds[2] = {link->client, link->server};
+    const Direction *reading[2] = {&link->up, &link->down};
+    const Direction *writing[2] = {&link->down, &link->up};
+    for (int i = 0; i < 2; i++) {
+        epoll_event ev{};
+        // Apres la fin de flux, plus rien a lire : ni EPOLLIN ni EPOLLRDHUP (level-triggered)
+        if (!reading[i]->eof) ev.events |= EPOLLRDHUP;
+        if (!reading[i]->eof && reading[i]->queued < queue_limit_) ev.events |= EPOLLIN;
+        if (writing[i]->blocked) ev.events |= EPOLLOUT;
+        ev.data.fd = fds[i];
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fds[i], &ev);
+    }
+}
+
+uint64_t Impair_Relay::nextDue() const {
+    uint64_t due = 0;
+    for (auto &entry : links_) {
+        const Link *link = entry.second.get();
+        if (entry.first != link->client) continue;
+        for (const Direction *dir : {&link->up, &link->down}) {
+            if (dir->blocked || dir->chunks.empty()) continue;
+            uint64_t t = dir->chunks.front().due_us;
+            if (due == 0 || t < due) due = t;
+        }
+    }
+    return due;
+}
+
+void Impair_Relay::closeLink(Link *link) {
+    int client = link->client;
+    int server = link->server;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, client, nullptr);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, server, nullptr);
+    close(client);
+    close(server);
+    links_.erase(client);
+    links_.erase(server);  // detruit link
+}
@@ -0,0 +1,392 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Ingest_Server.h"
+#include "Util.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+// Evenements traites par epoll_wait
+#define MAX_EVENTS 64
+
+// Octets lus au plus sur une connexion par reveil (level-triggered : le reste attend le tour suivant)
+#define READ_BUDGET (1u << 20)
+
+// Caps acceptees : pas de canal de retour ni de flux strie ici
+#define SERVER_CAPS (CAP_CHECKSUM | CAP_REPEAT | CAP_RESULTS | CAP_DEVICE_ID | CAP_ORIENTATION)
+
+// Tampon de reception noyau demande par connexion
+#define SOCKET_RCVBUF (1 << 20)
+
+Ingest_Server::Ingest_Server(int port, int report_sec)
+        : port_(port), report_sec_(report_sec) {
+}
+
+Ingest_Server::~Ingest_Server() {
+    for (auto &entry : connections_) {
+        close(entry.first);
+    }
+    connections_.clear();
+    if (wake_fd_ >= 0) close(wake_fd_);
+    if (epoll_fd_ >= 0) close(epoll_fd_);
+    if (listen_fd_ >= 0) close(listen_fd_);
+}
+
+void Ingest_Server::SetWorker(int index, int count) {
+    worker_ = index;
+    id_stride_ = (uint32_t)count;
+    next_id_ = (uint32_t)index + 1;
+}
+
+bool Ingest_Server::Start() {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        LOGE("socket failed: %s", strerror(errno));
+        return false;
+    }
+
+    int one = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (id_stride_ > 1) {
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port_);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(listen_fd_, (sockaddr *)&addr, sizeof(addr)) < 0) {
+        LOGE("bind port %d failed: %s", port_, strerror(errno));
+        return false;
+    }
+    if (listen(listen_fd_, SOMAXCONN) < 0) {
+        LOGE("listen failed: %s", strerror(errno));
+        return false;
+    }
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        LOGE("epoll_create1 failed: %s", strerror(errno));
+        return false;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        LOGE("eventfd failed: %s", strerror(errno));
+        return false;
+    }
+    ev.data.fd = wake_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+
+    if (mjpeg_ && !mjpeg_->Start(epoll_fd_)) {
+        return false;
+    }
+
+    last_report_ = std::chrono::steady_clock::now();
+    if (id_stride_ > 1) {
+        LOGI("[worker %d] ingest listening on port %d", worker_, port_);
+    } else {
+        LOGI("ingest listening on port %d", port_);
+    }
+    return true;
+}
+
+void Ingest_Server::Wake() {
+    uint64_t one = 1;
+    ssize_t r = write(wake_fd_, &one, sizeof(one));
+    (void)r;
+}
+
+void Ingest_Server::Run(const std::atomic_bool &stop) {
+    epoll_event events[MAX_EVENTS];
+    const auto report_every = std::chrono::seconds(report_sec_);
+
+    while (!stop) {
+        int timeout_ms = -1;
+        if (report_sec_ > 0) {
+            auto left = last_report_ + report_every - std::chrono::steady_clock::now();
+            timeout_ms = (int)std::max<int64_t>(
+                    0, std::chrono::duration_cast<std::chrono::milliseconds>(left).count());
+        }
+
+        int n = epoll_wait(epoll_fd_, events, MAX_EVENTS, timeout_ms);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOGE("epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd_) {
+                acceptAll();
+                continue;
+            }
+            if (fd == wake_fd_) {
+                // Seul usage : l'arret, vu en haut de boucle
+                continue;
+            }
+            auto it = connections_.find(fd);
+            if (it == connections_.end()) {
+                if (mjpeg_) mjpeg_->HandleEvent(fd, events[i].events);
+                continue;
+            }
+
+            Connection *c = it->second.get();
+            bool keep = !(events[i].events & EPOLLERR);
+            if (keep && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP))) {
+                keep = readConnection(c);
+            }
+            if (!keep) {
+                closeConnection(c);
+            }
+        }
+
+        if (report_sec_ > 0 && std::chrono::steady_clock::now() - last_report_ >= report_every) {
+            report();
+        }
+    }
+}
+
+void Ingest_Server::acceptAll() {
+    for (;;) {
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        int fd = accept4(listen_fd_, (sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                LOGE("accept4 failed: %s", strerror(errno));
+            }
+            return;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        int rcvbuf = SOCKET_RCVBUF;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+        auto c = std::make_unique<Connection>();
+        c->fd = fd;
+        c->id = next_id_;
+        next_id_ += id_stride_;
+        char ip[INET_ADDRSTRLEN] = {0};
+        inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+        c->peer = std::string(ip) + ":" + std::to_string(ntohs(addr.sin_port));
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            LOGE("epoll_ctl add failed: %s", strerror(errno));
+            close(fd);
+            continue;
+        }
+
+        LOGI("[%s] connected, stream %u", c->peer.c_str(), c->id);
+        for (Frame_Sink *sink : sinks_) {
+            sink->BeginStream(c->id, c->peer);
+        }
+        connections_[fd] = std::move(c);
+        stats_.accepted++;
+        stats_.connections++;
+    }
+}
+
+bool Ingest_Server::readConnection(Connection *c) {
+    size_t budget = READ_BUDGET;
+
+    while (budget > 0) {
+        // WriteSpace() peut deplacer le buffer : WritePtr() apres
+        size_t space = std::min(c->parser.WriteSpace(), budget);
+        ssize_t r = recv(c->fd, c->parser.WritePtr(), space, 0);
+        if (r == 0) {
+            LOGI("[%s] disconnected", c->peer.c_str());
+            return false;
+        }
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            LOGE("[%s] recv failed: %s", c->peer.c_str(), strerror(errno));
+            return false;
+        }
+        c->parser.Commit((size_t)r);
+        stats_.bytes += (uint64_t)r;
+        budget -= (size_t)r;
+
+        Parsed_Message msg;
+        int status;
+        while ((status = c->parser.Next(msg)) > 0) {
+            if (!handleMessage(c, msg)) return false;
+        }
+        if (status < 0) {
+            LOGE("[%s] invalid stream, closing", c->peer.c_str());
+            stats_.errors++;
+            return false;
+        }
+
+        // Lecture partielle : la socket est videe
+        if ((size_t)r < space) break;
+    }
+    return true;
+}
+
+bool Ingest_Server::handleMessage(Connection *c, const Parsed_Message &msg) {
+    const FrameHeaderV2 &hdr = msg.header;
+    c->v2 = c->v2 || !msg.legacy;
+
+    if (!msg.checksum_ok) {
+        // Frame corrompue : on la saute, le flux reste aligne
+        LOGE("[%s] checksum mismatch on seq=%u", c->peer.c_str(), hdr.sequence);
+        stats_.errors++;
+        return true;
+    }
+
+    switch (hdr.type) {
+        case MSG_HELLO: {
+            HelloPayload hello{};
+            if (hdr.payload_len >= sizeof(hello)) {
+                memcpy(&hello, msg.payload, sizeof(hello));
+            }
+            // DeviceHello en dernier, apres un eventuel StripeHello
+            size_t offset = sizeof(hello) + ((hello.caps & CAP_STRIPED) ? sizeof(StripeHello) : 0);
+            DeviceHello device{};
+            if ((hello.caps & CAP_DEVICE_ID) && hdr.payload_len >= offset + sizeof(device)) {
+                memcpy(&device, msg.payload + offset, sizeof(device));
+            }
+            if (device.device_id != 0) {
+                char key[17];
+                snprintf(key, sizeof(key), "%016llx", (unsigned long long)device.device_id);
+                LOGI("[%s] device %s", c->peer.c_str(), key);
+                for (Frame_Sink *sink : sinks_) {
+                    sink->IdentifyStream(c->id, key);
+                }
+            }
+            return sendHelloAck(c, hello.caps);
+        }
+        case MSG_DIMS:
+            c->width = hdr.width;
+            c->height = hdr.height;
+            LOGI("[%s] dims %ux%u", c->peer.c_str(), hdr.width, hdr.height);
+            return true;
+        case MSG_JPEG: {
+            auto frame = std::make_shared<Ingest_Frame>();
+            frame->header = hdr;
+            if (hdr.width == 0 && hdr.height == 0) {
+                frame->header.width = c->width;
+                frame->header.height = c->height;
+            }
+            if (msg.legacy) {
+                // v1 : pas de numero sur le fil, on numerote a la reception
+                frame->header.sequence = (uint32_t)c->frames + 1;
+            }
+            frame->payload.assign(msg.payload, msg.payload + hdr.payload_len);
+            frame->recv_us = ProtoClockMicros();
+            c->latest = std::move(frame);
+            for (Frame_Sink *sink : sinks_) {
+                sink->Publish(c->id, c->latest);
+            }
+            c->frames++;
+            stats_.frames++;
+            return true;
+        }
+        case MSG_RESULTS: {
+            const Results_Header *header;
+            const Result_Object *objects;
+            const char *text;
+            if (!ParseResults(msg.payload, hdr.payload_len, &header, &objects, &text)) {
+                LOGE("[%s] malformed results for seq=%u, ignored", c->peer.c_str(), hdr.sequence);
+                stats_.errors++;
+                return true;
+            }
+            auto results = std::make_shared<Ingest_Frame>();
+            results->header = hdr;
+            results->payload.assign(msg.payload, msg.payload + hdr.payload_len);
+            results->recv_us = ProtoClockMicros();
+            for (Frame_Sink *sink : sinks_) {
+                sink->PublishResults(c->id, results);
+            }
+            stats_.results++;
+            return true;
+        }
+        case MSG_REPEAT:
+            c->repeats++;
+            stats_.repeats++;
+            return true;
+        default:
+            // Type inconnu mais bien delimite (v2) : ignore
+            return true;
+    }
+}
+
+bool Ingest_Server::sendHelloAck(Connection *c, uint32_t client_caps) {
+    uint8_t msg[sizeof(FrameHeaderV2) + sizeof(HelloPayload)];
+    FrameHeaderV2 hdr;
+    InitHeaderV2(&hdr, MSG_HELLO_ACK, sizeof(HelloPayload));
+    HelloPayload ack = { client_caps & SERVER_CAPS };
+    memcpy(msg, &hdr, sizeof(hdr));
+    memcpy(msg + sizeof(hdr), &ack, sizeof(ack));
+
+    // Quelques dizaines d'octets sur une socket neuve : le tampon d'envoi est vide
+    ssize_t w = send(c->fd, msg, sizeof(msg), MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (w != (ssize_t)sizeof(msg)) {
+        LOGE("[%s] hello ack failed: %s", c->peer.c_str(), strerror(errno));
+        return false;
+    }
+    LOGI("[%s] hello caps=0x%x accepted=0x%x", c->peer.c_str(), client_caps, ack.caps);
+    return true;
+}
+
+void Ingest_Server::closeConnection(Connection *c) {
+    int fd = c->fd;
+    LOGI("[%s] closed after %llu frames, %llu repeats", c->peer.c_str(),
+         (unsigned long long)c->frames, (unsigned long long)c->repeats);
+    for (Frame_Sink *sink : sinks_) {
+        sink->EndStream(c->id);
+    }
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections_.erase(fd);  // detruit c
+    stats_.connections--;
+}
+
+void Ingest_Server::report() {
+    auto now = std::chrono::steady_clock::now();
+    double sec = std::chrono::duration<double>(now - last_report_).count();
+    if (sec <= 0) return;
+
+    double fps = (double)(stats_.frames - last_stats_.frames) / sec;
+    double mbps = (double)(stats_.bytes - last_stats_.bytes) * 8.0 / sec / 1e6;
+    // Un prefixe par worker, dans la meme ligne : les threads ecrivent en meme temps
+    std::string tag = id_stride_ > 1 ? "[worker " + std::to_string(worker_) + "] " : "";
+    LOGI("%sstreams=%u frames/s=%.1f repeats/s=%.1f results/s=%.1f Mbit/s=%.1f errors=%llu",
+         tag.c_str(), stats_.connections, fps, (double)(stats_.repeats - last_stats_.repeats) / sec,
+         (double)(stats_.results - last_stats_.results) / sec, mbps, (unsigned long long)stats_.errors);
+    if (mjpeg_) {
+        const Mjpeg_Stats &out = mjpeg_->Stats();
+        LOGI("%sviewers=%u parts/s=%.1f skipped/s=%.1f out Mbit/s=%.1f evicted=%llu", tag.c_str(),
+             out.viewers,
+             (double)(out.parts - last_mjpeg_.parts) / sec,
+             (double)(out.skipped - last_mjpeg_.skipped) / sec,
+             (double)(out.bytes - last_mjpeg_.bytes) * 8.0 / sec / 1e6,
+             (unsigned long long)out.evicted);
+        last_mjpeg_ = out;
+    }
+    fflush(stdout);
+
+    last_stats_ = stats_;
+    last_report_ = now;
+}
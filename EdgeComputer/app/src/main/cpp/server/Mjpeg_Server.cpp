@@ -0,0 +1,942 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Mjpeg_Server.h"
+#include "Jpeg_Exif.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+#include <unordered_set>
+
+// Requete HTTP max (on n'attend qu'une ligne GET et quelques en-tetes)
+#define MAX_REQUEST 8192
+
+// Reponse max de GET /results : la suite est a demander avec un from plus tard
+#define MAX_RESULTS_BYTES (4u << 20)
+
+// Cote max demande a GET /frame (w, h) ; au-dela : 400
+#define MAX_FRAME_SIDE 8192
+
+// Meme format que server.py
+#define BOUNDARY "--frame"
+#define PART_TRAILER "\r\n"
+
+static const char STREAM_RESPONSE[] =
+        "HTTP/1.0 200 OK\r\n"
+        "Content-Type: multipart/x-mixed-replace; boundary=frame\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Connection: close\r\n"
+        "\r\n";
+
+static const char LIVE_RESULTS_RESPONSE[] =
+        "HTTP/1.0 200 OK\r\n"
+        "Content-Type: application/octet-stream\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Connection: close\r\n"
+        "\r\n";
+
+static const char NOT_FOUND_RESPONSE[] =
+        "HTTP/1.0 404 Not Found\r\n"
+        "Content-Length: 0\r\n"
+        "Connection: close\r\n"
+        "\r\n";
+
+static const char BAD_REQUEST_RESPONSE[] =
+        "HTTP/1.0 400 Bad Request\r\n"
+        "Content-Length: 0\r\n"
+        "Connection: close\r\n"
+        "\r\n";
+
+// Valeur entiere d'un parametre "name=value" de la query string
+static long queryInt(const std::string &query, const char *name, long fallback) {
+    size_t len = strlen(name);
+    size_t pos = 0;
+    while (pos < query.size()) {
+        size_t next = query.find('&', pos);
+        if (next == std::string::npos) next = query.size();
+        if (next - pos > len && query.compare(pos, len, name) == 0 && query[pos + len] == '=') {
+            return strtol(query.c_str() + pos + len + 1, nullptr, 10);
+        }
+        pos = next + 1;
+    }
+    return fallback;
+}
+
+// Valeur decimale d'un parametre "name=value" de la query string
+static double queryDouble(const std::string &query, const char *name, double fallback) {
+    size_t len = strlen(name);
+    size_t pos = 0;
+    while (pos < query.size()) {
+        size_t next = query.find('&', pos);
+        if (next == std::string::npos) next = query.size();
+        if (next - pos > len && query.compare(pos, len, name) == 0 && query[pos + len] == '=') {
+            return strtod(query.c_str() + pos + len + 1, nullptr);
+        }
+        pos = next + 1;
+    }
+    return fallback;
+}
+
+// Chaine brute d'un parametre "name=value" de la query string
+static std::string queryString(const std::string &query, const char *name) {
+    size_t len = strlen(name);
+    size_t pos = 0;
+    while (pos < query.size()) {
+        size_t next = query.find('&', pos);
+        if (next == std::string::npos) next = query.size();
+        if (next - pos > len && query.compare(pos, len, name) == 0 && query[pos + len] == '=') {
+            return query.substr(pos + len + 1, next - pos - len - 1);
+        }
+        pos = next + 1;
+    }
+    return "";
+}
+
+// Horloge murale, la meme que l'index des enregistrements
+static uint64_t wallMicros() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+size_t Mjpeg_Server::Part::size() const {
+    return head.size() + length + (trailer ? strlen(PART_TRAILER) : 0);
+}
+
+Mjpeg_Server::Mjpeg_Server(int port, int evict_ms)
+        : port_(port), evict_us_((uint64_t)evict_ms * 1000u) {
+}
+
+Mjpeg_Server::~Mjpeg_Server() {
+    for (auto &entry : viewers_) {
+        close(entry.first);
+    }
+    viewers_.clear();  // ferme aussi les timerfd de relecture
+    if (listen_fd_ >= 0) close(listen_fd_);
+    if (evict_timer_fd_ >= 0) close(evict_timer_fd_);
+    if (results_fd_ >= 0) close(results_fd_);
+}
+
+bool Mjpeg_Server::Start(int epoll_fd) {
+    epoll_fd_ = epoll_fd;
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        LOGE("http socket failed: %s", strerror(errno));
+        return false;
+    }
+
+    int one = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (directory_ != nullptr && directory_->Workers() > 1) {
+        // Meme port pour tous les workers, le noyau repartit les connexions
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port_);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(listen_fd_, (sockaddr *)&addr, sizeof(addr)) < 0) {
+        LOGE("http bind port %d failed: %s", port_, strerror(errno));
+        return false;
+    }
+    if (listen(listen_fd_, SOMAXCONN) < 0) {
+        LOGE("http listen failed: %s", strerror(errno));
+        return false;
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+
+    if (directory_ != nullptr) {
+        wake_fd_ = directory_->WakeFd(worker_);
+        ev.data.fd = wake_fd_;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+    }
+
+    results_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (results_fd_ < 0) {
+        LOGE("eventfd failed: %s", strerror(errno));
+        return false;
+    }
+    ev.data.fd = results_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, results_fd_, &ev);
+
+    if (evict_us_ > 0) {
+        // Balayage periodique : un client bloque est coupe meme sans nouvelle frame
+        evict_timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (evict_timer_fd_ >= 0) {
+            itimerspec its{};
+            its.it_interval.tv_sec = (time_t)(evict_us_ / 2 / 1000000u);
+            its.it_interval.tv_nsec = (long)(evict_us_ / 2 % 1000000u) * 1000L;
+            if (its.it_interval.tv_sec == 0 && its.it_interval.tv_nsec == 0) {
+                its.it_interval.tv_nsec = 1000L;
+            }
+            its.it_value = its.it_interval;
+            timerfd_settime(evict_timer_fd_, 0, &its, nullptr);
+            ev.data.fd = evict_timer_fd_;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, evict_timer_fd_, &ev);
+        } else {
+            LOGE("timerfd_create failed: %s", strerror(errno));
+        }
+    }
+
+    LOGI("mjpeg on http://0.0.0.0:%d", port_);
+    return true;
+}
+
+bool Mjpeg_Server::HandleEvent(int fd, uint32_t events) {
+    if (fd == listen_fd_) {
+        acceptAll();
+        return true;
+    }
+    if (fd == wake_fd_) {
+        onWake();
+        return true;
+    }
+    if (fd == results_fd_) {
+        uint64_t count;
+        ssize_t ignored = read(results_fd_, &count, sizeof(count));
+        (void)ignored;
+        drainResults();
+        return true;
+    }
+    if (fd == evict_timer_fd_) {
+        uint64_t expirations;
+        ssize_t ignored = read(evict_timer_fd_, &expirations, sizeof(expirations));
+        (void)ignored;
+        evictStalled();
+        return true;
+    }
+    auto timer = timers_.find(fd);
+    if (timer != timers_.end()) {
+        Viewer *v = viewers_[timer->second].get();
+        v->playback->OnTimer();
+        if (!flush(v)) {
+            closeViewer(v);
+        }
+        return true;
+    }
+    auto it = viewers_.find(fd);
+    if (it == viewers_.end()) return false;
+
+    Viewer *v = it->second.get();
+    bool keep = !(events & EPOLLERR);
+    if (keep && (events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP))) {
+        keep = readRequest(v);
+    }
+    if (keep && (events & EPOLLOUT)) {
+        keep = flush(v);
+    }
+    if (!keep) {
+        closeViewer(v);
+    }
+    return true;
+}
+
+void Mjpeg_Server::acceptAll() {
+    for (;;) {
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        int fd = accept4(listen_fd_, (sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                LOGE("http accept4 failed: %s", strerror(errno));
+            }
+            return;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        auto v = std::make_unique<Viewer>();
+        v->fd = fd;
+        char ip[INET_ADDRSTRLEN] = {0};
+        inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+        v->peer = std::string(ip) + ":" + std::to_string(ntohs(addr.sin_port));
+        v->accepted_us = ProtoClockMicros();
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            LOGE("http epoll_ctl add failed: %s", strerror(errno));
+            close(fd);
+            continue;
+        }
+        viewers_[fd] = std::move(v);
+    }
+}
+
+bool Mjpeg_Server::readRequest(Viewer *v) {
+    char buf[2048];
+    for (;;) {
+        ssize_t r = recv(v->fd, buf, sizeof(buf), 0);
+        if (r == 0) return false;
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        // Une fois la requete traitee, ce que le client envoie est ignore
+        if (!v->answered) {
+            v->request.append(buf, (size_t)r);
+        }
+    }
+    if (v->answered) return true;
+
+    size_t end = v->request.find("\r\n\r\n");
+    if (end == std::string::npos) {
+        return v->request.size() < MAX_REQUEST;
+    }
+
+    // "GET <chemin> HTTP/1.x"
+    std::string path;
+    if (v->request.compare(0, 4, "GET ") == 0) {
+        size_t stop = v->request.find(' ', 4);
+        if (stop != std::string::npos) {
+            path = v->request.substr(4, stop - 4);
+        }
+    }
+    std::string query;
+    size_t mark = path.find('?');
+    if (mark != std::string::npos) {
+        query = path.substr(mark + 1);
+        path.resize(mark);
+    }
+
+    bool found = false;
+    if (path == "/frame" && decoder_ != nullptr) {
+        v->answered = true;
+        v->close_after = true;
+        v->response = frameResponse(query);
+        v->request.clear();
+        return flush(v);
+    }
+    if (path == "/stats") {
+        std::string body = statsJson();
+        v->answered = true;
+        v->close_after = true;
+        v->response = "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+                      std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        v->request.clear();
+        return flush(v);
+    }
+    if (path == "/results" && queryInt(query, "live", 0) != 0) {
+        LOGI("[http %s] live results of stream %ld", v->peer.c_str(), queryInt(query, "stream", 0));
+        v->stream_id = (uint32_t)std::max(queryInt(query, "stream", 0), 0L);
+        v->answered = true;
+        v->live_results = true;
+        v->response = LIVE_RESULTS_RESPONSE;
+        v->request.clear();
+        v->request.shrink_to_fit();
+        live_results_++;
+        return flush(v);
+    }
+    if (path == "/results" && recorder_ != nullptr) {
+        v->answered = true;
+        v->close_after = true;
+        v->response = resultsResponse(query);
+        v->request.clear();
+        return flush(v);
+    }
+    if (path == "/playback" && recorder_ != nullptr) {
+        v->request.clear();
+        v->request.shrink_to_fit();
+        if (!startPlayback(v, query)) {
+            send(v->fd, NOT_FOUND_RESPONSE, sizeof(NOT_FOUND_RESPONSE) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+            return false;
+        }
+        v->answered = true;
+        v->response = STREAM_RESPONSE;
+        return flush(v);
+    }
+    if (path == "/") {
+        v->stream_id = 0;
+        found = true;
+    } else if (path.compare(0, 8, "/stream/") == 0) {
+        char *stop = nullptr;
+        unsigned long id = strtoul(path.c_str() + 8, &stop, 10);
+        found = id > 0 && stop != nullptr && *stop == '\0';
+        v->stream_id = (uint32_t)id;
+    }
+    v->request.clear();
+    v->request.shrink_to_fit();
+
+    if (!found) {
+        send(v->fd, NOT_FOUND_RESPONSE, sizeof(NOT_FOUND_RESPONSE) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+        return false;
+    }
+
+    LOGI("[http %s] viewer on %s", v->peer.c_str(), path.c_str());
+    if (directory_ != nullptr) {
+        // Flux d'un autre worker : sa derniere frame arrive dans latest_
+        follow(resolve(v->stream_id));
+    }
+    v->answered = true;
+    v->streaming = true;
+    v->response = STREAM_RESPONSE;
+    stats_.viewers++;
+
+    // Derniere frame du flux tout de suite, comme server.py
+    auto latest = latest_.find(resolve(v->stream_id));
+    if (latest != latest_.end()) {
+        v->pending = latest->second;
+    }
+    return flush(v);
+}
+
+bool Mjpeg_Server::flush(Viewer *v) {
+    static const char trailer[] = PART_TRAILER;
+
+    while (!v->response.empty()) {
+        ssize_t w = send(v->fd, v->response.data(), v->response.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                setWantWrite(v, true);
+                return true;
+            }
+            return false;
+        }
+        v->response.erase(0, (size_t)w);
+    }
+    if (v->close_after) return false;
+
+    if (v->playback) {
+        switch (v->playback->Pump(v->fd)) {
+            case PUMP_DONE:
+                return false;
+            case PUMP_WAIT_WRITE:
+                setWantWrite(v, true);
+                return true;
+            case PUMP_WAIT_TIMER:
+                setWantWrite(v, false);
+                return true;
+        }
+    }
+
+    for (;;) {
+        if (!v->current) {
+            if (!v->pending) {
+                setWantWrite(v, false);
+                return true;
+            }
+            v->current = std::move(v->pending);
+            v->pending.reset();
+            v->offset = 0;
+            v->current_since_us = ProtoClockMicros();
+        }
+
+        // boundary + en-tetes, JPEG, fin de partie : un seul appel, repris a offset
+        const Part &part = *v->current;
+        iovec iov[3];
+        iov[0].iov_base = (void *)part.head.data();
+        iov[0].iov_len = part.head.size();
+        iov[1].iov_base = (void *)part.data;
+        iov[1].iov_len = part.length;
+        iov[2].iov_base = (void *)trailer;
+        iov[2].iov_len = part.trailer ? sizeof(trailer) - 1 : 0;
+
+        int first = 0;
+        size_t skip = v->offset;
+        while (first < 3 && skip >= iov[first].iov_len) {
+            skip -= iov[first].iov_len;
+            first++;
+        }
+        iov[first].iov_base = (uint8_t *)iov[first].iov_base + skip;
+        iov[first].iov_len -= skip;
+
+        msghdr msg{};
+        msg.msg_iov = iov + first;
+        msg.msg_iovlen = 3 - first;
+        ssize_t w = sendmsg(v->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                setWantWrite(v, true);
+                return true;
+            }
+            return false;
+        }
+
+        v->offset += (size_t)w;
+        v->stats.bytes += (uint64_t)w;
+        stats_.bytes += (uint64_t)w;
+        if (v->offset < part.size()) {
+            // Tampon d'envoi plein : la suite au prochain EPOLLOUT
+            setWantWrite(v, true);
+            return true;
+        }
+        v->current.reset();
+        v->stats.parts++;
+        stats_.parts++;
+    }
+}
+
+void Mjpeg_Server::setWantWrite(Viewer *v, bool on) {
+    if (v->want_write == on) return;
+
+    // Bloque : de l'armement d'EPOLLOUT jusqu'a ce que la boite soit videe
+    uint64_t now = ProtoClockMicros();
+    if (on) {
+        v->stats.stalls++;
+        v->stall_since_us = now;
+    } else {
+        v->stats.stall_us += now - v->stall_since_us;
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP | (on ? EPOLLOUT : 0u);
+    ev.data.fd = v->fd;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, v->fd, &ev);
+    v->want_write = on;
+}
+
+void Mjpeg_Server::deliver(Viewer *v, const std::shared_ptr<const Part> &part) {
+    if (v->want_write) {
+        // Client en retard : coupe s'il n'arrive plus a faire passer une seule frame
+        if (stalled(v, ProtoClockMicros())) {
+            evict(v);
+            return;
+        }
+        // La frame en attente n'est jamais partie : la plus recente la remplace
+        if (v->pending) {
+            v->stats.skipped++;
+            stats_.skipped++;
+        }
+        v->pending = part;
+        return;
+    }
+
+    v->pending = part;
+    if (!flush(v)) {
+        closeViewer(v);
+    }
+}
+
+bool Mjpeg_Server::stalled(const Viewer *v, uint64_t now) const {
+    if (evict_us_ == 0) return false;
+    // Une frame qui ne passe pas
+    if (v->current && now - v->current_since_us > evict_us_) return true;
+    // Requete jamais terminee ou en-tetes de reponse jamais partis
+    return (!v->answered || !v->response.empty()) && now - v->accepted_us > evict_us_;
+}
+
+void Mjpeg_Server::evict(Viewer *v) {
+    LOGE("[http %s] evicted: blocked for more than %llu ms", v->peer.c_str(),
+         (unsigned long long)(evict_us_ / 1000u));
+    stats_.evicted++;
+    closeViewer(v);
+}
+
+void Mjpeg_Server::evictStalled() {
+    uint64_t now = ProtoClockMicros();
+    std::vector<Viewer *> stuck;
+    for (auto &entry : viewers_) {
+        if (stalled(entry.second.get(), now)) {
+            stuck.push_back(entry.second.get());
+        }
+    }
+    for (Viewer *v : stuck) {
+        evict(v);
+    }
+}
+
+void Mjpeg_Server::closeViewer(Viewer *v) {
+    int fd = v->fd;
+    if (v->streaming) {
+        LOGI("[http %s] viewer closed: %llu frames, %llu skipped, %llu bytes, %llu stalls",
+             v->peer.c_str(), (unsigned long long)v->stats.parts,
+             (unsigned long long)v->stats.skipped, (unsigned long long)v->stats.bytes,
+             (unsigned long long)v->stats.stalls);
+        stats_.viewers--;
+        followed_dirty_ = directory_ != nullptr;
+    }
+    if (v->live_results) {
+        LOGI("[http %s] live results closed: %llu sent, %llu skipped", v->peer.c_str(),
+             (unsigned long long)v->stats.parts, (unsigned long long)v->stats.skipped);
+        live_results_--;
+    }
+    if (v->playback) {
+        LOGI("[http %s] playback closed: %llu frames", v->peer.c_str(),
+             (unsigned long long)v->playback->FramesSent());
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, v->playback->TimerFd(), nullptr);
+        timers_.erase(v->playback->TimerFd());
+    }
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    viewers_.erase(fd);  // detruit v
+}
+
+std::string Mjpeg_Server::frameResponse(const std::string &query) {
+    Decode_Request req;
+    req.stream_id = resolve((uint32_t)queryInt(query, "stream", 0));
+    long seq = queryInt(query, "seq", -1);
+    req.latest = seq < 0;
+    req.sequence = (uint32_t)std::max(seq, 0L);
+    long w = queryInt(query, "w", 0);
+    long h = queryInt(query, "h", 0);
+    if (w < 0 || h < 0 || w > MAX_FRAME_SIDE || h > MAX_FRAME_SIDE) return BAD_REQUEST_RESPONSE;
+    req.width = (int)w;
+    req.height = (int)h;
+    req.gray = queryInt(query, "gray", 0) != 0;
+    req.upright = queryInt(query, "upright", 0) != 0;
+
+    // Decodage synchrone dans la boucle : reserve aux miniatures et au debug
+    std::shared_ptr<const Decoded_Image> image = decoder_->Decode(req);
+    if (!image) return NOT_FOUND_RESPONSE;
+
+    // Netpbm : en-tete texte + pixels bruts, lisible partout sans encodeur
+    std::string head = (image->channels == 1 ? "P5\n" : "P6\n") + std::to_string(image->width) +
+                       " " + std::to_string(image->height) + "\n255\n";
+    size_t size = head.size() + image->pixels.size();
+    std::string response = "HTTP/1.0 200 OK\r\nContent-Type: " +
+                           std::string(image->channels == 1 ? "image/x-portable-graymap"
+                                                            : "image/x-portable-pixmap") +
+                           "\r\nContent-Length: " + std::to_string(size) +
+                           "\r\nX-Frame-Sequence: " + std::to_string(image->sequence) +
+                           "\r\nX-Frame-Orientation: " + std::to_string(image->orientation) +
+                           "\r\nConnection: close\r\n\r\n" + head;
+    response.append((const char *)image->pixels.data(), image->pixels.size());
+    return response;
+}
+
+bool Mjpeg_Server::recordingRange(const std::string &query, std::string &device, uint64_t &from_us,
+                                  uint64_t &to_us) const {
+    // Le telephone par son IP, ou par un flux en cours
+    device = queryString(query, "device");
+    if (device.empty()) {
+        uint32_t stream_id = resolve((uint32_t)queryInt(query, "stream", 0));
+        auto it = devices_.find(stream_id);
+        if (it != devices_.end()) {
+            device = it->second;
+        } else if (directory_ != nullptr && directory_->Find(stream_id) >= 0) {
+            device = directory_->Device(directory_->Find(stream_id));
+        } else {
+            return false;
+        }
+    }
+
+    // Secondes Unix ; negatif = relatif a maintenant (from=-60 : la derniere minute)
+    uint64_t now = wallMicros();
+    auto toMicros = [now](double sec) -> uint64_t {
+        if (sec < 0) {
+            uint64_t back = (uint64_t)(-sec * 1e6);
+            return back < now ? now - back : 0;
+        }
+        return (uint64_t)(sec * 1e6);
+    };
+    from_us = toMicros(queryDouble(query, "from", -60));
+    to_us = toMicros(queryDouble(query, "to", (double)now / 1e6));
+    return to_us >= from_us;
+}
+
+std::string Mjpeg_Server::resultsResponse(const std::string &query) {
+    std::string device;
+    uint64_t from_us;
+    uint64_t to_us;
+    if (!recordingRange(query, device, from_us, to_us)) return NOT_FOUND_RESPONSE;
+
+    // Messages MSG_RESULTS tels que recus (FrameHeaderV2 + payload), lus au .rix de chaque segment
+    std::string body;
+    size_t count = 0;
+    bool truncated = false;
+    for (const Segment_Info &info : recorder_->Segments(device, from_us, to_us)) {
+        int rix = open((info.path + ".rix").c_str(), O_RDONLY | O_CLOEXEC);
+        int seg = open((info.path + ".seg").c_str(), O_RDONLY | O_CLOEXEC);
+        Record_Index_Header header{};
+        if (rix >= 0 && seg >= 0 && pread(rix, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+            header.magic == RECORD_RESULTS_MAGIC) {
+            // count lu avant les entrees : une entree comptee est deja ecrite (voir Recorder)
+            uint32_t n = std::min(header.count, header.capacity);
+            std::vector<Record_Index_Entry> entries(n);
+            ssize_t want = (ssize_t)(n * sizeof(Record_Index_Entry));
+            if (pread(rix, entries.data(), (size_t)want, sizeof(header)) == want) {
+                for (const Record_Index_Entry &e : entries) {
+                    if (e.time_us < from_us || e.time_us > to_us) continue;
+                    size_t len = sizeof(FrameHeaderV2) + e.length;
+                    if (body.size() + len > MAX_RESULTS_BYTES) {
+                        truncated = true;
+                        break;
+                    }
+                    size_t at = body.size();
+                    body.resize(at + len);
+                    if (pread(seg, &body[at], len, (off_t)(e.offset - sizeof(FrameHeaderV2))) != (ssize_t)len) {
+                        body.resize(at);
+                        continue;
+                    }
+                    count++;
+                }
+            }
+        }
+        if (rix >= 0) close(rix);
+        if (seg >= 0) close(seg);
+        if (truncated) break;
+    }
+
+    return "HTTP/1.0 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: " +
+           std::to_string(body.size()) + "\r\nX-Results-Count: " + std::to_string(count) +
+           (truncated ? "\r\nX-Results-Truncated: 1" : "") + "\r\nConnection: close\r\n\r\n" + body;
+}
+
+bool Mjpeg_Server::startPlayback(Viewer *v, const std::string &query) {
+    std::string device;
+    uint64_t from_us;
+    uint64_t to_us;
+    if (!recordingRange(query, device, from_us, to_us)) return false;
+    double speed = queryDouble(query, "speed", 1);
+
+    std::vector<Segment_Info> segments = recorder_->Segments(device, from_us, to_us);
+    if (segments.empty()) return false;
+
+    auto playback = std::make_unique<Playback_Session>(std::move(segments), from_us, to_us, speed);
+    if (!playback->Open()) return false;
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = playback->TimerFd();
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, playback->TimerFd(), &ev) < 0) {
+        LOGE("http epoll_ctl add timer failed: %s", strerror(errno));
+        return false;
+    }
+    timers_[playback->TimerFd()] = v->fd;
+    v->playback = std::move(playback);
+
+    LOGI("[http %s] playback of %s, %.1f s at x%.2f", v->peer.c_str(), device.c_str(),
+         (double)(to_us - from_us) / 1e6, speed);
+    return true;
+}
+
+std::string Mjpeg_Server::statsJson() const {
+    uint64_t now = ProtoClockMicros();
+    std::string json = "{\"viewers\": [";
+    bool first = true;
+    for (auto &entry : viewers_) {
+        const Viewer &v = *entry.second;
+        if (!v.streaming) continue;
+
+        uint64_t stall_us = v.stats.stall_us + (v.want_write ? now - v.stall_since_us : 0);
+        char item[384];
+        snprintf(item, sizeof(item),
+                 "%s{\"peer\": \"%s\", \"stream\": %u, \"frames\": %llu, \"skipped\": %llu, "
+                 "\"bytes\": %llu, \"stalls\": %llu, \"stall_ms\": %llu}",
+                 first ? "" : ", ", v.peer.c_str(), resolve(v.stream_id),
+                 (unsigned long long)v.stats.parts, (unsigned long long)v.stats.skipped,
+                 (unsigned long long)v.stats.bytes, (unsigned long long)v.stats.stalls,
+                 (unsigned long long)(stall_us / 1000u));
+        json += item;
+        first = false;
+    }
+    char tail[128];
+    snprintf(tail, sizeof(tail), "], \"skipped\": %llu, \"evicted\": %llu",
+             (unsigned long long)stats_.skipped, (unsigned long long)stats_.evicted);
+    json += tail;
+    if (monitor_ != nullptr) {
+        json += ", \"streams\": " + monitor_->Json();
+    }
+    return json + "}\n";
+}
+
+uint32_t Mjpeg_Server::resolve(uint32_t stream_id) const {
+    return stream_id == 0 ? default_stream_ : stream_id;
+}
+
+void Mjpeg_Server::BeginStream(uint32_t stream_id, const std::string &peer) {
+    // Meme cle que le Recorder : l'IP sans le port, jusqu'a IdentifyStream
+    devices_[stream_id] = peer.substr(0, peer.rfind(':'));
+}
+
+void Mjpeg_Server::IdentifyStream(uint32_t stream_id, const std::string &device) {
+    devices_[stream_id] = device;
+}
+
+std::shared_ptr<const Mjpeg_Server::Part> Mjpeg_Server::makePart(const uint8_t *data, size_t length,
+                                                                 uint8_t orientation,
+                                                                 std::shared_ptr<const void> hold) {
+    // Frame en orientation capteur : le navigateur la redresse d'apres l'EXIF
+    std::string exif;
+    size_t skip = JpegOrientationPrefix(data, length, orientation, exif);
+
+    auto part = std::make_shared<Part>();
+    part->head = BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: " +
+                 std::to_string(exif.size() + length - skip) + "\r\n\r\n" + exif;
+    part->data = data + skip;
+    part->length = length - skip;
+    part->hold = std::move(hold);
+    return part;
+}
+
+void Mjpeg_Server::Publish(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &frame) {
+    if (frame->header.codec != CODEC_JPEG) return;
+
+    auto part = makePart(frame->payload.data(), frame->payload.size(), frame->header.orientation,
+                         frame);
+    latest_[stream_id] = part;
+    if (default_stream_ == 0) {
+        default_stream_ = stream_id;
+    }
+    broadcast(stream_id, part);
+}
+
+void Mjpeg_Server::broadcast(uint32_t stream_id, const std::shared_ptr<const Part> &part) {
+    // closeViewer() peut retirer un client pendant le parcours
+    std::vector<Viewer *> targets;
+    for (auto &entry : viewers_) {
+        Viewer *v = entry.second.get();
+        if (v->streaming && resolve(v->stream_id) == stream_id) {
+            targets.push_back(v);
+        }
+    }
+    for (Viewer *v : targets) {
+        deliver(v, part);
+    }
+}
+
+void Mjpeg_Server::PublishResults(uint32_t stream_id,
+                                  const std::shared_ptr<const Ingest_Frame> &results) {
+    if (live_results_ == 0 || results_fd_ < 0) return;
+    {
+        std::lock_guard<std::mutex> lock(results_mutex_);
+        results_inbox_.emplace_back(stream_id, results);
+    }
+    uint64_t one = 1;
+    ssize_t ignored = write(results_fd_, &one, sizeof(one));
+    (void)ignored;
+}
+
+void Mjpeg_Server::drainResults() {
+    std::vector<std::pair<uint32_t, std::shared_ptr<const Ingest_Frame>>> inbox;
+    {
+        std::lock_guard<std::mutex> lock(results_mutex_);
+        inbox.swap(results_inbox_);
+    }
+    for (auto &item : inbox) {
+        // Message tel que recu ou enregistre : FrameHeaderV2 puis payload, sans boundary
+        const Ingest_Frame &results = *item.second;
+        auto part = std::make_shared<Part>();
+        part->head.assign((const char *)&results.header, sizeof(results.header));
+        part->data = results.payload.data();
+        part->length = results.payload.size();
+        part->hold = item.second;
+        part->trailer = false;
+
+        std::vector<Viewer *> targets;
+        for (auto &entry : viewers_) {
+            Viewer *v = entry.second.get();
+            if (v->live_results && resolve(v->stream_id) == item.first) {
+                targets.push_back(v);
+            }
+        }
+        for (Viewer *v : targets) {
+            deliver(v, part);
+        }
+    }
+}
+
+void Mjpeg_Server::EndStream(uint32_t stream_id) {
+    latest_.erase(stream_id);
+    devices_.erase(stream_id);
+    if (default_stream_ != stream_id) return;
+
+    // Le flux par defaut passe au plus ancien telephone restant
+    default_stream_ = 0;
+    for (auto &entry : latest_) {
+        if (default_stream_ == 0 || entry.first < default_stream_) {
+            default_stream_ = entry.first;
+        }
+    }
+}
+
+void Mjpeg_Server::onWake() {
+    directory_->Drain(worker_);
+
+    uint32_t generation = directory_->Generation();
+    if (generation != generation_ || followed_dirty_) {
+        generation_ = generation;
+        followed_dirty_ = false;
+        // Flux par defaut commun a tous les workers
+        default_stream_ = directory_->DefaultStream();
+
+        std::unordered_set<uint32_t> wanted;
+        for (auto &entry : viewers_) {
+            if (entry.second->streaming) wanted.insert(resolve(entry.second->stream_id));
+        }
+        std::vector<uint32_t> gone;
+        for (auto &entry : remote_) {
+            if (!wanted.count(entry.first) || entry.second.ring->Closed()) gone.push_back(entry.first);
+        }
+        for (uint32_t stream_id : gone) {
+            unfollow(stream_id);
+        }
+        // Clients du flux par defaut quand il passe a un autre worker
+        for (uint32_t stream_id : wanted) {
+            follow(stream_id);
+        }
+    }
+    pollRemote();
+}
+
+void Mjpeg_Server::follow(uint32_t stream_id) {
+    if (stream_id == 0 || devices_.count(stream_id) || remote_.count(stream_id)) return;
+    int entry = directory_->Find(stream_id);
+    if (entry < 0 || directory_->Owner(entry) == (uint32_t)worker_) return;
+
+    Remote remote;
+    remote.ring = std::make_shared<Frame_Ring_Reader>();
+    if (!remote.ring->Open(directory_->RingName(stream_id))) return;
+    remote.entry = entry;
+    directory_->Watch(entry, worker_, true);
+    remote_[stream_id] = remote;
+    LOGI("[worker %d] following stream %u of worker %u", worker_, stream_id,
+         directory_->Owner(entry));
+    pollRemote();
+}
+
+void Mjpeg_Server::unfollow(uint32_t stream_id) {
+    auto it = remote_.find(stream_id);
+    if (it == remote_.end()) return;
+    // L'entree a pu etre liberee et reprise par un autre flux
+    if (directory_->Find(stream_id) == it->second.entry) {
+        directory_->Watch(it->second.entry, worker_, false);
+    }
+    // Les parties en cours d'envoi gardent leur emplacement epingle
+    latest_.erase(stream_id);
+    remote_.erase(it);
+}
+
+void Mjpeg_Server::pollRemote() {
+    std::vector<std::pair<uint32_t, std::shared_ptr<const Part>>> fresh;
+    for (auto &entry : remote_) {
+        Remote &remote = entry.second;
+        if (remote.ring->Published() == remote.seen) continue;
+        std::shared_ptr<const Ring_Pin> pin = remote.ring->PinLatest();
+        if (!pin || pin->index == remote.seen) continue;
+
+        remote.seen = pin->index;
+        auto part = makePart(pin->data, pin->length, pin->slot->header.orientation, pin);
+        latest_[entry.first] = part;
+        fresh.emplace_back(entry.first, part);
+    }
+    for (auto &item : fresh) {
+        broadcast(item.first, item.second);
+    }
+}
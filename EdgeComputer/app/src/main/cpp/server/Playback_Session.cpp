@@ -0,0 +1,246 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Playback_Session.h"
+#include "Jpeg_Exif.h"
+#include "Protocol.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+// Trou maximal entre deux frames relues (telephone deconnecte, pause...)
+#define MAX_GAP_US 1000000u
+
+#define PART_TRAILER "\r\n"
+
+static uint64_t monoMicros() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+Playback_Session::Playback_Session(std::vector<Segment_Info> segments, uint64_t from_us,
+                                   uint64_t to_us, double speed)
+        : segments_(std::move(segments)), from_us_(from_us), to_us_(to_us), speed_(speed) {
+}
+
+Playback_Session::~Playback_Session() {
+    closeSegment();
+    if (timer_fd_ >= 0) close(timer_fd_);
+}
+
+bool Playback_Session::Open() {
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd_ < 0) {
+        LOGE("timerfd_create failed: %s", strerror(errno));
+        return false;
+    }
+    return openSegment(0) && nextEntry(last_);
+}
+
+bool Playback_Session::openSegment(size_t k) {
+    closeSegment();
+
+    // Un segment supprime par la retention entre-temps est simplement saute
+    for (; k < segments_.size(); k++) {
+        const std::string &path = segments_[k].path;
+        int idx = open((path + ".idx").c_str(), O_RDONLY | O_CLOEXEC);
+        if (idx < 0) continue;
+        struct stat st;
+        void *map = MAP_FAILED;
+        if (fstat(idx, &st) == 0 && (size_t)st.st_size >= sizeof(Record_Index_Header)) {
+            map = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, idx, 0);
+        }
+        close(idx);
+        if (map == MAP_FAILED) continue;
+
+        const auto *header = static_cast<const Record_Index_Header *>(map);
+        int fd = open((path + ".seg").c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0 || header->magic != RECORD_INDEX_MAGIC ||
+            RecordIndexBytes(header->capacity) > (size_t)st.st_size) {
+            if (fd >= 0) close(fd);
+            munmap(map, (size_t)st.st_size);
+            continue;
+        }
+
+        segment_ = k;
+        seg_fd_ = fd;
+        index_ = header;
+        index_bytes_ = (size_t)st.st_size;
+
+        // Premiere entree >= from_us : l'index est trie par heure de reception
+        const auto *table = reinterpret_cast<const Record_Index_Entry *>(index_ + 1);
+        uint32_t count = indexCount();
+        pos_ = (uint32_t)(std::lower_bound(table, table + count, from_us_,
+                                           [](const Record_Index_Entry &e, uint64_t t) {
+                                               return e.time_us < t;
+                                           }) - table);
+        return true;
+    }
+    return false;
+}
+
+void Playback_Session::closeSegment() {
+    if (index_ != nullptr) {
+        munmap((void *)index_, index_bytes_);
+        index_ = nullptr;
+    }
+    if (seg_fd_ >= 0) {
+        close(seg_fd_);
+        seg_fd_ = -1;
+    }
+}
+
+uint32_t Playback_Session::indexCount() const {
+    // Index corrompu ou ecrit par un autre : jamais de lecture au-dela de la table
+    return std::min(__atomic_load_n(&index_->count, __ATOMIC_ACQUIRE), index_->capacity);
+}
+
+bool Playback_Session::nextEntry(Record_Index_Entry &entry) {
+    while (index_ != nullptr) {
+        uint32_t count = indexCount();
+        if (pos_ < count) {
+            entry = reinterpret_cast<const Record_Index_Entry *>(index_ + 1)[pos_++];
+            return entry.time_us <= to_us_;
+        }
+        if (!openSegment(segment_ + 1)) {
+            closeSegment();
+            return false;
+        }
+    }
+    return false;
+}
+
+void Playback_Session::schedule(const Record_Index_Entry &next) {
+    // Ecart d'origine : horloge de capture si les deux frames en ont une coherente
+    uint64_t delta;
+    if (last_.capture_us != 0 && next.capture_us > last_.capture_us &&
+        next.capture_us - last_.capture_us <= MAX_GAP_US) {
+        delta = next.capture_us - last_.capture_us;
+    } else {
+        delta = next.time_us > last_.time_us
+                ? std::min<uint64_t>(next.time_us - last_.time_us, MAX_GAP_US) : 0;
+    }
+    media_us_ += delta;
+    last_ = next;
+
+    if (speed_ <= 0) {
+        due_ = true;
+        return;
+    }
+    uint64_t due = start_mono_us_ + (uint64_t)((double)media_us_ / speed_);
+    if (due <= monoMicros()) {
+        due_ = true;  // en retard : pas de rattrapage par saut, on envoie tout de suite
+        return;
+    }
+
+    itimerspec its{};
+    its.it_value.tv_sec = (time_t)(due / 1000000u);
+    its.it_value.tv_nsec = (long)(due % 1000000u) * 1000;
+    timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &its, nullptr);
+    due_ = false;
+}
+
+void Playback_Session::OnTimer() {
+    uint64_t expirations;
+    if (read(timer_fd_, &expirations, sizeof(expirations)) == (ssize_t)sizeof(expirations)) {
+        due_ = true;
+    }
+}
+
+size_t Playback_Session::orientationPrefix(const Record_Index_Entry &entry, std::string &prefix) {
+    prefix.clear();
+    if (entry.offset < sizeof(FrameHeaderV2)) return 0;
+
+    uint8_t buf[sizeof(FrameHeaderV2) + JPEG_ORIENTATION_PEEK];
+    size_t want = sizeof(FrameHeaderV2) + std::min<size_t>(entry.length, JPEG_ORIENTATION_PEEK);
+    ssize_t n = pread(seg_fd_, buf, want, (off_t)(entry.offset - sizeof(FrameHeaderV2)));
+    if (n != (ssize_t)want) return 0;
+
+    FrameHeaderV2 header;
+    memcpy(&header, buf, sizeof(header));
+    if (header.magic != PROTO_MAGIC) return 0;
+    return JpegOrientationPrefix(buf + sizeof(header), want - sizeof(header), header.orientation,
+                                 prefix);
+}
+
+pump_status Playback_Session::Pump(int sock) {
+    static const char trailer[] = PART_TRAILER;
+
+    for (;;) {
+        switch (phase_) {
+            case PHASE_IDLE: {
+                if (!due_) return PUMP_WAIT_TIMER;
+                if (!started_) {
+                    start_mono_us_ = monoMicros();
+                    started_ = true;
+                }
+                // last_ = frame a envoyer (chargee par Open() ou schedule())
+                std::string exif;
+                size_t skip = orientationPrefix(last_, exif);
+                head_ = "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: " +
+                        std::to_string(exif.size() + last_.length - skip) + "\r\n\r\n" + exif;
+                head_sent_ = 0;
+                body_offset_ = (off_t)(last_.offset + skip);
+                body_left_ = last_.length - skip;
+                tail_sent_ = 0;
+                phase_ = PHASE_HEAD;
+                break;
+            }
+
+            case PHASE_HEAD: {
+                ssize_t w = send(sock, head_.data() + head_sent_, head_.size() - head_sent_,
+                                 MSG_NOSIGNAL | MSG_DONTWAIT | MSG_MORE);
+                if (w < 0) {
+                    if (errno == EINTR) continue;
+                    return (errno == EAGAIN || errno == EWOULDBLOCK) ? PUMP_WAIT_WRITE : PUMP_DONE;
+                }
+                head_sent_ += (size_t)w;
+                if (head_sent_ == head_.size()) phase_ = PHASE_BODY;
+                break;
+            }
+
+            case PHASE_BODY: {
+                // Segment -> socket dans le noyau
+                ssize_t w = sendfile(sock, seg_fd_, &body_offset_, body_left_);
+                if (w < 0) {
+                    if (errno == EINTR) continue;
+                    return (errno == EAGAIN || errno == EWOULDBLOCK) ? PUMP_WAIT_WRITE : PUMP_DONE;
+                }
+                if (w == 0) return PUMP_DONE;  // segment tronque
+                body_left_ -= (size_t)w;
+                if (body_left_ == 0) phase_ = PHASE_TAIL;
+                break;
+            }
+
+            case PHASE_TAIL: {
+                ssize_t w = send(sock, trailer + tail_sent_, sizeof(trailer) - 1 - tail_sent_,
+                                 MSG_NOSIGNAL | MSG_DONTWAIT);
+                if (w < 0) {
+                    if (errno == EINTR) continue;
+                    return (errno == EAGAIN || errno == EWOULDBLOCK) ? PUMP_WAIT_WRITE : PUMP_DONE;
+                }
+                tail_sent_ += (size_t)w;
+                if (tail_sent_ < sizeof(trailer) - 1) break;
+
+                frames_sent_++;
+                phase_ = PHASE_IDLE;
+                Record_Index_Entry next;
+                if (!nextEntry(next)) return PUMP_DONE;
+                schedule(next);
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,554 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Recorder.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+
+// Frames ou resultats par pwritev (deux iovec chacun : header + payload)
+#define WRITE_BATCH 256
+
+// Une entree d'index pour 4 Ko de segment au moins : des JPEG plus petits remplissent l'index d'abord
+#define MIN_INDEX_CAPACITY 1024u
+#define INDEX_BYTES_PER_ENTRY 4096u
+
+// Retention verifiee au plus une fois par seconde
+#define RETENTION_PERIOD_US 1000000u
+
+static uint64_t wallMicros() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static uint64_t fileBytes(const std::string &path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? (uint64_t)st.st_size : 0;
+}
+
+static void removeSegmentFiles(const std::string &path) {
+    unlink((path + ".seg").c_str());
+    unlink((path + ".idx").c_str());
+    unlink((path + ".rix").c_str());
+}
+
+// Cree un index vide de capacity entrees et le projette en memoire. @return nullptr si echec
+static Record_Index_Header *createIndex(const std::string &file, uint32_t magic, uint32_t capacity,
+                                        uint64_t segment_bytes, uint64_t time_us) {
+    size_t bytes = RecordIndexBytes(capacity);
+    int fd = open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    void *map = MAP_FAILED;
+    if (fd >= 0 && ftruncate(fd, (off_t)bytes) == 0) {
+        map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (fd >= 0) close(fd);  // la projection reste valide
+    if (map == MAP_FAILED) {
+        LOGE("index %s: %s", file.c_str(), strerror(errno));
+        return nullptr;
+    }
+
+    Record_Index_Header *index = static_cast<Record_Index_Header *>(map);
+    index->magic = magic;
+    index->version = RECORD_INDEX_VERSION;
+    index->capacity = capacity;
+    index->segment_bytes = segment_bytes;
+    index->first_us = time_us;
+    index->last_us = time_us;
+    __atomic_store_n(&index->count, 0u, __ATOMIC_RELEASE);
+    return index;
+}
+
+// Entrees valides d'un index sur disque, 0 s'il est absent ou illisible
+static uint32_t indexCount(const std::string &file, uint32_t magic, Record_Index_Header *out) {
+    Record_Index_Header header{};
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    bool valid = fd >= 0 && pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+                 header.magic == magic && header.version == RECORD_INDEX_VERSION;
+    if (fd >= 0) close(fd);
+    if (!valid) return 0;
+    if (out != nullptr) *out = header;
+    return header.count;
+}
+
+// Ajoute n entrees deja ecrites dans le segment ; count publie en dernier
+static void appendEntries(Record_Index_Header *index, const Record_Index_Entry *entries, uint32_t n) {
+    if (n == 0) return;
+    uint32_t count = index->count;
+    Record_Index_Entry *table = reinterpret_cast<Record_Index_Entry *>(index + 1);
+    memcpy(table + count, entries, n * sizeof(Record_Index_Entry));
+    if (count == 0) index->first_us = entries[0].time_us;
+    index->last_us = entries[n - 1].time_us;
+    __atomic_store_n(&index->count, count + n, __ATOMIC_RELEASE);
+}
+
+Recorder::Recorder(const Recorder_Config &config)
+        : config_(config),
+          index_capacity_(std::max<uint32_t>(MIN_INDEX_CAPACITY,
+                                             (uint32_t)(config.segment_bytes / INDEX_BYTES_PER_ENTRY))) {
+}
+
+Recorder::~Recorder() {
+    Stop();
+}
+
+bool Recorder::Start() {
+    if (mkdir(config_.dir.c_str(), 0755) < 0 && errno != EEXIST) {
+        LOGE("record dir %s: %s", config_.dir.c_str(), strerror(errno));
+        return false;
+    }
+    scanExisting();
+    writer_ = std::thread(&Recorder::writerLoop, this);
+    LOGI("recording to %s (segments %llu MB)", config_.dir.c_str(),
+         (unsigned long long)(config_.segment_bytes >> 20));
+    return true;
+}
+
+void Recorder::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        stop_ = true;
+    }
+    queue_cv_.notify_one();
+    if (writer_.joinable()) {
+        writer_.join();
+        Recorder_Stats stats = Stats();
+        LOGI("recorder stopped: %llu frames, %llu results, %llu bytes, %llu dropped, %llu segments, "
+             "%llu evicted",
+             (unsigned long long)stats.frames, (unsigned long long)stats.results,
+             (unsigned long long)stats.bytes,
+             (unsigned long long)stats.dropped, (unsigned long long)stats.segments,
+             (unsigned long long)stats.evicted);
+    }
+}
+
+void Recorder::BeginStream(uint32_t stream_id, const std::string &peer) {
+    // Dossier = IP seule : le port change a chaque reconnexion. Un telephone qui
+    // s'identifie au HELLO (derriere un NAT, flotte en local) a son propre dossier
+    std::lock_guard<std::mutex> lock(devices_mutex_);
+    devices_[stream_id] = peer.substr(0, peer.rfind(':'));
+}
+
+void Recorder::IdentifyStream(uint32_t stream_id, const std::string &device) {
+    std::lock_guard<std::mutex> lock(devices_mutex_);
+    devices_[stream_id] = device;
+}
+
+void Recorder::Publish(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &frame) {
+    if (frame->header.codec != CODEC_JPEG) return;
+    enqueue(stream_id, frame);
+}
+
+void Recorder::PublishResults(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &results) {
+    enqueue(stream_id, results);
+}
+
+void Recorder::enqueue(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &frame) {
+    std::string device;
+    {
+        std::lock_guard<std::mutex> lock(devices_mutex_);
+        auto it = devices_.find(stream_id);
+        if (it == devices_.end()) return;
+        device = it->second;
+    }
+
+    size_t size = frame->payload.size();
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (backlog_bytes_ + size <= config_.max_backlog) {
+            queue_.push_back(Pending{std::move(device), frame});
+            backlog_bytes_ += size;
+            size = 0;
+        }
+    }
+    if (size > 0) {
+        // Disque en retard : la frame est perdue pour l'enregistrement, pas pour le direct
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.dropped++;
+        return;
+    }
+    queue_cv_.notify_one();
+}
+
+void Recorder::EndStream(uint32_t stream_id) {
+    std::lock_guard<std::mutex> lock(devices_mutex_);
+    devices_.erase(stream_id);
+}
+
+void Recorder::writerLoop() {
+    std::vector<Pending> batch;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) break;  // stop_ et plus rien a ecrire
+            batch.swap(queue_);
+            backlog_bytes_ = 0;
+        }
+
+        // Regroupe par telephone, dans l'ordre d'arrivee
+        std::map<std::string, std::vector<const Pending *>> by_device;
+        for (const Pending &p : batch) {
+            by_device[p.device].push_back(&p);
+        }
+        for (auto &entry : by_device) {
+            writeDevice(entry.first, entry.second);
+        }
+        batch.clear();
+
+        uint64_t now = wallMicros();
+        if (now - last_retention_us_ >= RETENTION_PERIOD_US) {
+            enforceRetention();
+            last_retention_us_ = now;
+        }
+    }
+
+    for (auto &entry : open_) {
+        closeSegment(entry.first, entry.second);
+    }
+    open_.clear();
+}
+
+void Recorder::writeDevice(const std::string &device, std::vector<const Pending *> &frames) {
+    // Reception (horloge protocole) -> horloge murale
+    uint64_t wall_offset = wallMicros() - ProtoClockMicros();
+    size_t i = 0;
+
+    while (i < frames.size()) {
+        const Ingest_Frame &first = *frames[i]->frame;
+        uint64_t need = sizeof(FrameHeaderV2) + first.payload.size();
+        if (need > config_.segment_bytes) {
+            LOGE("[%s] frame of %zu bytes larger than a segment, not recorded",
+                 device.c_str(), first.payload.size());
+            i++;
+            continue;
+        }
+
+        Open_Segment *seg = segmentFor(device, need, first.recv_us + wall_offset);
+        if (seg == nullptr) {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.dropped += frames.size() - i;
+            return;
+        }
+
+        // Frames (et resultats) consecutifs qui tiennent dans ce segment : un seul pwritev
+        iovec iov[WRITE_BATCH * 2];
+        Record_Index_Entry entries[WRITE_BATCH];
+        Record_Index_Entry result_entries[WRITE_BATCH];
+        uint32_t frame_count = 0;
+        uint32_t result_count = 0;
+        uint64_t pos = seg->used;
+        int n = 0;
+        while (i < frames.size() && n < WRITE_BATCH) {
+            const Ingest_Frame &f = *frames[i]->frame;
+            bool results = f.header.type == MSG_RESULTS;
+            uint64_t len = sizeof(FrameHeaderV2) + f.payload.size();
+            if (pos + len > config_.segment_bytes) break;
+            if (results ? seg->results->count + result_count >= seg->results->capacity
+                        : seg->index->count + frame_count >= seg->index->capacity) {
+                break;
+            }
+
+            iov[2 * n].iov_base = (void *)&f.header;
+            iov[2 * n].iov_len = sizeof(FrameHeaderV2);
+            iov[2 * n + 1].iov_base = (void *)f.payload.data();
+            iov[2 * n + 1].iov_len = f.payload.size();
+            Record_Index_Entry &entry = results ? result_entries[result_count++] : entries[frame_count++];
+            entry.time_us = f.recv_us + wall_offset;
+            entry.capture_us = f.header.capture_ts_us;
+            entry.offset = pos + sizeof(FrameHeaderV2);
+            entry.length = (uint32_t)f.payload.size();
+            entry.sequence = f.header.sequence;
+            pos += len;
+            n++;
+            i++;
+        }
+
+        // pwritev peut s'arreter en cours de route : on reprend la ou il en est
+        uint64_t total = pos - seg->used;
+        uint64_t done = 0;
+        iovec *cur = iov;
+        int left = 2 * n;
+        while (done < total) {
+            ssize_t w = pwritev(seg->fd, cur, left, (off_t)(seg->used + done));
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            if (w == 0) {
+                errno = EIO;
+                break;
+            }
+            done += (uint64_t)w;
+            while (left > 0 && (size_t)w >= cur->iov_len) {
+                w -= (ssize_t)cur->iov_len;
+                cur++;
+                left--;
+            }
+            if (left > 0) {
+                cur->iov_base = (uint8_t *)cur->iov_base + w;
+                cur->iov_len -= (size_t)w;
+            }
+        }
+        if (done < total) {
+            LOGE("[%s] segment write failed: %s", device.c_str(), strerror(errno));
+            closeSegment(device, *seg);
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.dropped += n;
+            continue;
+        }
+
+        // Index apres les donnees : une entree visible pointe toujours sur des octets ecrits
+        Record_Index_Header *index = seg->index;
+        appendEntries(index, entries, frame_count);
+        appendEntries(seg->results, result_entries, result_count);
+        seg->used = pos;
+
+        {
+            std::lock_guard<std::mutex> lock(segments_mutex_);
+            for (Segment_Info &info : segments_[device]) {
+                if (info.path == seg->path) {
+                    info.first_us = index->first_us;
+                    info.last_us = index->last_us;
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.frames += frame_count;
+        stats_.results += result_count;
+        stats_.bytes += total;
+    }
+}
+
+Recorder::Open_Segment *Recorder::segmentFor(const std::string &device, uint64_t need,
+                                             uint64_t time_us) {
+    Open_Segment &seg = open_[device];
+    if (seg.fd >= 0 && (seg.used + need > config_.segment_bytes ||
+                        seg.index->count >= seg.index->capacity ||
+                        seg.results->count >= seg.results->capacity)) {
+        closeSegment(device, seg);
+    }
+    if (seg.fd < 0) {
+        if (!openSegment(device, seg, time_us)) return nullptr;
+        // Un segment de plus sur le disque : budget en octets verifie tout de suite
+        enforceRetention();
+    }
+    return &seg;
+}
+
+bool Recorder::openSegment(const std::string &device, Open_Segment &seg, uint64_t time_us) {
+    std::string dir = config_.dir + "/" + device;
+    if (mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST) {
+        LOGE("record dir %s: %s", dir.c_str(), strerror(errno));
+        return false;
+    }
+
+    // Nom = premier horodatage, decale d'une µs si deja pris
+    int fd = -1;
+    std::string path;
+    for (int attempt = 0; attempt < 16 && fd < 0; attempt++) {
+        path = dir + "/" + std::to_string(time_us + attempt);
+        fd = open((path + ".seg").c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd < 0 && errno != EEXIST) break;
+    }
+    if (fd < 0) {
+        LOGE("segment %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    // Preallocation : pas d'extension de fichier (ni de metadonnees) a chaque ecriture
+    if (fallocate(fd, 0, 0, (off_t)config_.segment_bytes) < 0) {
+        if (errno != EOPNOTSUPP || ftruncate(fd, (off_t)config_.segment_bytes) < 0) {
+            LOGE("segment %s: preallocation failed: %s", path.c_str(), strerror(errno));
+            close(fd);
+            removeSegmentFiles(path);
+            return false;
+        }
+    }
+
+    size_t index_bytes = RecordIndexBytes(index_capacity_);
+    Record_Index_Header *index = createIndex(path + ".idx", RECORD_INDEX_MAGIC, index_capacity_,
+                                             config_.segment_bytes, time_us);
+    Record_Index_Header *results = index == nullptr ? nullptr
+            : createIndex(path + ".rix", RECORD_RESULTS_MAGIC, index_capacity_, config_.segment_bytes,
+                          time_us);
+    if (results == nullptr) {
+        if (index != nullptr) munmap(index, index_bytes);
+        close(fd);
+        removeSegmentFiles(path);
+        return false;
+    }
+
+    seg.path = path;
+    seg.fd = fd;
+    seg.index = index;
+    seg.results = results;
+    seg.index_bytes = index_bytes;
+    seg.used = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(segments_mutex_);
+        segments_[device].push_back(Segment_Info{device, path, time_us, time_us,
+                                                 config_.segment_bytes + 2 * index_bytes, true});
+    }
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.segments++;
+    return true;
+}
+
+void Recorder::closeSegment(const std::string &device, Open_Segment &seg) {
+    if (seg.fd < 0) return;
+    // Segment vide : ni frame ni resultat
+    uint32_t count = seg.index->count + seg.results->count;
+    munmap(seg.index, seg.index_bytes);
+    munmap(seg.results, seg.index_bytes);
+    close(seg.fd);
+
+    {
+        std::lock_guard<std::mutex> lock(segments_mutex_);
+        std::vector<Segment_Info> &list = segments_[device];
+        for (auto it = list.begin(); it != list.end(); ++it) {
+            if (it->path != seg.path) continue;
+            if (count == 0) {
+                list.erase(it);
+            } else {
+                it->open = false;
+            }
+            break;
+        }
+    }
+    if (count == 0) {
+        removeSegmentFiles(seg.path);
+    }
+
+    seg = Open_Segment();
+}
+
+void Recorder::enforceRetention() {
+    if (config_.max_bytes == 0 && config_.max_age_sec == 0) return;
+
+    std::vector<std::string> victims;
+    {
+        std::lock_guard<std::mutex> lock(segments_mutex_);
+        uint64_t total = 0;
+        for (auto &entry : segments_) {
+            for (const Segment_Info &info : entry.second) {
+                total += info.bytes;
+            }
+        }
+
+        uint64_t oldest_kept = config_.max_age_sec > 0
+                               ? wallMicros() - config_.max_age_sec * 1000000u : 0;
+        for (;;) {
+            // Plus ancien segment termine, tous telephones confondus
+            std::vector<Segment_Info> *list = nullptr;
+            size_t pos = 0;
+            for (auto &entry : segments_) {
+                for (size_t k = 0; k < entry.second.size(); k++) {
+                    const Segment_Info &info = entry.second[k];
+                    if (info.open) continue;
+                    if (list == nullptr || info.last_us < (*list)[pos].last_us) {
+                        list = &entry.second;
+                        pos = k;
+                    }
+                }
+            }
+            if (list == nullptr) break;
+
+            const Segment_Info &oldest = (*list)[pos];
+            bool over_bytes = config_.max_bytes > 0 && total > config_.max_bytes;
+            bool too_old = oldest.last_us < oldest_kept;
+            if (!over_bytes && !too_old) break;
+
+            total -= oldest.bytes;
+            victims.push_back(oldest.path);
+            list->erase(list->begin() + (long)pos);
+        }
+    }
+
+    // Hors verrou : une relecture en cours garde ses descripteurs ouverts
+    for (const std::string &path : victims) {
+        LOGI("retention: removing %s", path.c_str());
+        removeSegmentFiles(path);
+    }
+    if (!victims.empty()) {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.evicted += victims.size();
+    }
+}
+
+void Recorder::scanExisting() {
+    DIR *root = opendir(config_.dir.c_str());
+    if (root == nullptr) return;
+
+    size_t found = 0;
+    while (dirent *d = readdir(root)) {
+        if (d->d_name[0] == '.') continue;
+        std::string device = d->d_name;
+        std::string dir = config_.dir + "/" + device;
+        DIR *sub = opendir(dir.c_str());
+        if (sub == nullptr) continue;
+
+        std::vector<Segment_Info> list;
+        while (dirent *f = readdir(sub)) {
+            std::string name = f->d_name;
+            if (name.size() <= 4 || name.compare(name.size() - 4, 4, ".idx") != 0) continue;
+            std::string path = dir + "/" + name.substr(0, name.size() - 4);
+
+            Record_Index_Header header{};
+            uint32_t count = indexCount(path + ".idx", RECORD_INDEX_MAGIC, &header);
+            if (header.magic != RECORD_INDEX_MAGIC ||
+                count + indexCount(path + ".rix", RECORD_RESULTS_MAGIC, nullptr) == 0) {
+                removeSegmentFiles(path);
+                continue;
+            }
+            list.push_back(Segment_Info{device, path, header.first_us, header.last_us,
+                                        fileBytes(path + ".seg") + fileBytes(path + ".idx") +
+                                        fileBytes(path + ".rix"), false});
+        }
+        closedir(sub);
+
+        std::sort(list.begin(), list.end(), [](const Segment_Info &a, const Segment_Info &b) {
+            return a.first_us < b.first_us;
+        });
+        found += list.size();
+        if (!list.empty()) {
+            std::lock_guard<std::mutex> lock(segments_mutex_);
+            segments_[device] = std::move(list);
+        }
+    }
+    closedir(root);
+
+    if (found > 0) {
+        LOGI("recorder: %zu existing segments", found);
+    }
+}
+
+std::vector<Segment_Info> Recorder::Segments(const std::string &device, uint64_t from_us,
+                                             uint64_t to_us) {
+    std::vector<Segment_Info> result;
+    std::lock_guard<std::mutex> lock(segments_mutex_);
+    auto it = segments_.find(device);
+    if (it == segments_.end()) return result;
+    for (const Segment_Info &info : it->second) {
+        if (info.last_us >= from_us && info.first_us <= to_us) {
+            result.push_back(info);
+        }
+    }
+    return result;
+}
+
+Recorder_Stats Recorder::Stats() {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return stats_;
+}
@@ -0,0 +1,91 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Shm_Client.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+Shm_Client::Shm_Client(int port)
+        : name_("/edge_ingest." + std::to_string(port)) {
+}
+
+Shm_Client::~Shm_Client() {
+    if (base_ != nullptr) munmap((void *)base_, bytes_);
+}
+
+bool Shm_Client::Open() {
+    int fd = shm_open(name_.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        LOGE("shm_open %s failed: %s (edge_ingest without -a or -w?)", name_.c_str(),
+             strerror(errno));
+        return false;
+    }
+    struct stat st{};
+    Directory_Header hdr{};
+    if (fstat(fd, &st) < 0 || pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+        hdr.magic != STREAM_DIRECTORY_MAGIC || hdr.version != SHARED_STREAM_VERSION ||
+        (size_t)st.st_size < DirectoryBytes(hdr.capacity)) {
+        LOGE("%s: not a stream directory", name_.c_str());
+        close(fd);
+        return false;
+    }
+    size_t bytes = DirectoryBytes(hdr.capacity);
+    void *map = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        LOGE("mmap %s failed: %s", name_.c_str(), strerror(errno));
+        return false;
+    }
+    base_ = (const uint8_t *)map;
+    bytes_ = bytes;
+    return true;
+}
+
+std::vector<Shared_Stream_Info> Shm_Client::Streams() const {
+    std::vector<Shared_Stream_Info> streams;
+    const auto *hdr = (const Directory_Header *)base_;
+    const auto *entries = (const Directory_Entry *)(base_ + sizeof(Directory_Header));
+    for (uint32_t i = 0; i < hdr->capacity; i++) {
+        const Directory_Entry &e = entries[i];
+        if (__atomic_load_n(&e.state, __ATOMIC_ACQUIRE) != ENTRY_ACTIVE) continue;
+        streams.push_back(Shared_Stream_Info{e.stream_id, e.worker, e.started_us,
+                                             std::string(e.peer, strnlen(e.peer, sizeof(e.peer))),
+                                             std::string(e.ring, strnlen(e.ring, sizeof(e.ring)))});
+    }
+    std::sort(streams.begin(), streams.end(),
+              [](const Shared_Stream_Info &a, const Shared_Stream_Info &b) {
+                  return a.stream_id < b.stream_id;
+              });
+    return streams;
+}
+
+uint32_t Shm_Client::Generation() const {
+    return __atomic_load_n(&((const Directory_Header *)base_)->generation, __ATOMIC_ACQUIRE);
+}
+
+std::shared_ptr<Frame_Ring_Reader> Shm_Client::Attach(uint32_t stream_id) const {
+    std::vector<Shared_Stream_Info> streams = Streams();
+    if (streams.empty()) return nullptr;
+    if (stream_id == 0) stream_id = streams.front().stream_id;
+
+    for (const Shared_Stream_Info &s : streams) {
+        if (s.stream_id != stream_id) continue;
+        auto ring = std::make_shared<Frame_Ring_Reader>();
+        if (!ring->Open(s.ring)) return nullptr;
+        return ring;
+    }
+    return nullptr;
+}
+
+bool Shm_Client::Decode(const Ring_Pin &pin, const Decode_Request &req, Decoded_Image &out) {
+    out.stream_id = pin.ring->StreamId();
+    out.sequence = pin.slot->header.sequence;
+    return Decode_Service::DecodeJpeg(pin.data, pin.length, req, out, pin.slot->header.orientation);
+}
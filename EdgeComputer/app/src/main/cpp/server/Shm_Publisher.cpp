@@ -0,0 +1,42 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Shm_Publisher.h"
+
+void Shm_Publisher::BeginStream(uint32_t stream_id, const std::string &peer) {
+    auto s = std::make_unique<Stream>();
+    // Anneau cree avant l'entree : un lecteur qui trouve le flux peut l'ouvrir
+    if (!s->ring.Create(directory_->RingName(stream_id), stream_id)) return;
+    s->entry = directory_->Add(stream_id, worker_, peer);
+    streams_[stream_id] = std::move(s);
+}
+
+void Shm_Publisher::IdentifyStream(uint32_t stream_id, const std::string &device) {
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end()) return;
+    directory_->SetDevice(it->second->entry, device);
+}
+
+void Shm_Publisher::Publish(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &frame) {
+    if (frame->header.codec != CODEC_JPEG) return;
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end()) return;
+
+    Stream &s = *it->second;
+    // Personne ne lit l'anneau : pas de copie (un lecteur qui arrive attend la frame suivante)
+    if (!s.ring.HasReaders()) return;
+    if (s.ring.Publish(*frame)) {
+        directory_->Notify(s.entry);
+    }
+}
+
+void Shm_Publisher::EndStream(uint32_t stream_id) {
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end()) return;
+
+    // Anneau ferme d'abord : les workers reveilles par Remove() le voient termine
+    it->second->ring.Close();
+    directory_->Remove(it->second->entry);
+    streams_.erase(it);
+}
@@ -0,0 +1,190 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Stream_Directory.h"
+#include "Protocol.h"
+#include "Util.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+
+Stream_Directory::Stream_Directory(int port, int workers)
+        : name_("/edge_ingest." + std::to_string(port)), workers_(workers) {
+}
+
+Stream_Directory::~Stream_Directory() {
+    for (int fd : wake_fds_) {
+        close(fd);
+    }
+    if (base_ != nullptr) {
+        // Un lecteur qui garde la projection voit l'annuaire vide
+        for (int i = 0; i < DIRECTORY_CAPACITY; i++) {
+            __atomic_store_n(&entry(i)->state, (uint32_t)ENTRY_FREE, __ATOMIC_RELEASE);
+        }
+        __atomic_add_fetch(&header()->generation, 1, __ATOMIC_RELEASE);
+        munmap(base_, bytes_);
+        shm_unlink(name_.c_str());
+    }
+}
+
+bool Stream_Directory::Create() {
+    if (workers_ < 1 || workers_ > MAX_WORKERS) {
+        LOGE("directory: %d workers, 1 to %d supported", workers_, MAX_WORKERS);
+        return false;
+    }
+
+    // Un annuaire reste d'un arret brutal est remplace, pas tronque sous ses lecteurs
+    size_t bytes = DirectoryBytes(DIRECTORY_CAPACITY);
+    shm_unlink(name_.c_str());
+    int fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOGE("shm_open %s failed: %s", name_.c_str(), strerror(errno));
+        return false;
+    }
+    if (ftruncate(fd, (off_t)bytes) < 0) {
+        LOGE("ftruncate %s failed: %s", name_.c_str(), strerror(errno));
+        close(fd);
+        return false;
+    }
+    void *map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        LOGE("mmap %s failed: %s", name_.c_str(), strerror(errno));
+        return false;
+    }
+    base_ = (uint8_t *)map;
+    bytes_ = bytes;
+
+    header()->version = SHARED_STREAM_VERSION;
+    header()->capacity = DIRECTORY_CAPACITY;
+    header()->workers = (uint32_t)workers_;
+    __atomic_store_n(&header()->magic, STREAM_DIRECTORY_MAGIC, __ATOMIC_RELEASE);
+
+    for (int w = 0; w < workers_; w++) {
+        int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (efd < 0) {
+            LOGE("eventfd failed: %s", strerror(errno));
+            return false;
+        }
+        wake_fds_.push_back(efd);
+    }
+    LOGI("stream directory /dev/shm%s, %d workers", name_.c_str(), workers_);
+    return true;
+}
+
+void Stream_Directory::Drain(int worker) const {
+    uint64_t count;
+    while (read(wake_fds_[worker], &count, sizeof(count)) == (ssize_t)sizeof(count)) {
+    }
+}
+
+std::string Stream_Directory::RingName(uint32_t stream_id) const {
+    return name_ + "." + std::to_string(stream_id);
+}
+
+int Stream_Directory::Add(uint32_t stream_id, int worker, const std::string &peer) {
+    for (int i = 0; i < DIRECTORY_CAPACITY; i++) {
+        Directory_Entry *e = entry(i);
+        uint32_t expected = ENTRY_FREE;
+        if (!__atomic_compare_exchange_n(&e->state, &expected, (uint32_t)ENTRY_CLAIMED, false,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        e->stream_id = stream_id;
+        e->worker = (uint32_t)worker;
+        e->started_us = ProtoClockMicros();
+        __atomic_store_n(&e->watchers, 0ull, __ATOMIC_RELAXED);
+        snprintf(e->peer, sizeof(e->peer), "%s", peer.c_str());
+        snprintf(e->device, sizeof(e->device), "%s", peer.substr(0, peer.rfind(':')).c_str());
+        snprintf(e->ring, sizeof(e->ring), "%s", RingName(stream_id).c_str());
+        __atomic_store_n(&e->state, (uint32_t)ENTRY_ACTIVE, __ATOMIC_RELEASE);
+
+        __atomic_add_fetch(&header()->generation, 1, __ATOMIC_RELEASE);
+        wakeAll();
+        return i;
+    }
+    LOGE("directory full, stream %u not shared", stream_id);
+    return -1;
+}
+
+void Stream_Directory::SetDevice(int i, const std::string &device) {
+    if (i < 0) return;
+    // Fixee au HELLO, avant la premiere frame : aucun lecteur n'a encore de raison de la lire
+    snprintf(entry(i)->device, sizeof(entry(i)->device), "%s", device.c_str());
+}
+
+void Stream_Directory::Remove(int i) {
+    if (i < 0) return;
+    __atomic_store_n(&entry(i)->state, (uint32_t)ENTRY_FREE, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&header()->generation, 1, __ATOMIC_RELEASE);
+    wakeAll();
+}
+
+void Stream_Directory::Notify(int i) const {
+    if (i < 0) return;
+    uint64_t watchers = __atomic_load_n(&entry(i)->watchers, __ATOMIC_ACQUIRE);
+    for (int w = 0; watchers != 0; w++, watchers >>= 1) {
+        if (watchers & 1u) wake(w);
+    }
+}
+
+int Stream_Directory::Find(uint32_t stream_id) const {
+    for (int i = 0; i < DIRECTORY_CAPACITY; i++) {
+        Directory_Entry *e = entry(i);
+        if (__atomic_load_n(&e->state, __ATOMIC_ACQUIRE) == ENTRY_ACTIVE && e->stream_id == stream_id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint32_t Stream_Directory::Owner(int i) const {
+    return entry(i)->worker;
+}
+
+std::string Stream_Directory::Peer(int i) const {
+    return std::string(entry(i)->peer, strnlen(entry(i)->peer, sizeof(entry(i)->peer)));
+}
+
+std::string Stream_Directory::Device(int i) const {
+    return std::string(entry(i)->device, strnlen(entry(i)->device, sizeof(entry(i)->device)));
+}
+
+void Stream_Directory::Watch(int i, int worker, bool on) {
+    uint64_t bit = 1ull << worker;
+    if (on) {
+        __atomic_or_fetch(&entry(i)->watchers, bit, __ATOMIC_ACQ_REL);
+    } else {
+        __atomic_and_fetch(&entry(i)->watchers, ~bit, __ATOMIC_ACQ_REL);
+    }
+}
+
+uint32_t Stream_Directory::DefaultStream() const {
+    uint32_t best = 0;
+    for (int i = 0; i < DIRECTORY_CAPACITY; i++) {
+        Directory_Entry *e = entry(i);
+        if (__atomic_load_n(&e->state, __ATOMIC_ACQUIRE) != ENTRY_ACTIVE) continue;
+        if (best == 0 || e->stream_id < best) best = e->stream_id;
+    }
+    return best;
+}
+
+uint32_t Stream_Directory::Generation() const {
+    return __atomic_load_n(&header()->generation, __ATOMIC_ACQUIRE);
+}
+
+void Stream_Directory::wakeAll() const {
+    for (int w = 0; w < workers_; w++) {
+        wake(w);
+    }
+}
+
+void Stream_Directory::wake(int worker) const {
+    uint64_t one = 1;
+    ssize_t r = write(wake_fds_[worker], &one, sizeof(one));
+    (void)r;  // compteur sature : le worker est deja reveille
+}
@@ -0,0 +1,201 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Stream_Monitor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+void Latency_Histogram::Add(double ms) {
+    ms = std::max(ms, 0.0);
+    // Seau i : ms <= LATENCY_BOUNDS_MS[i] (bisect_left cote Python)
+    size_t i = std::lower_bound(LATENCY_BOUNDS_MS, LATENCY_BOUNDS_MS + LATENCY_BUCKETS - 1, ms) -
+               LATENCY_BOUNDS_MS;
+    counts[i]++;
+    total++;
+    sum_ms += ms;
+}
+
+std::string Latency_Histogram::Json() const {
+    char item[64];
+    std::string json = "{\"count\": " + std::to_string(total) + ", \"mean_ms\": ";
+    if (total > 0) {
+        snprintf(item, sizeof(item), "%.2f", sum_ms / (double)total);
+        json += item;
+    } else {
+        json += "null";
+    }
+    json += ", \"buckets_ms\": {";
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        if (i + 1 < LATENCY_BUCKETS) {
+            snprintf(item, sizeof(item), "%s\"<=%g\": %llu", i ? ", " : "", LATENCY_BOUNDS_MS[i],
+                     (unsigned long long)counts[i]);
+        } else {
+            snprintf(item, sizeof(item), ", \">%g\": %llu", LATENCY_BOUNDS_MS[i - 1],
+                     (unsigned long long)counts[i]);
+        }
+        json += item;
+    }
+    return json + "}}";
+}
+
+// {"analysed": .., "capture_to_result": {..}, "last": {"sequence": .., "objects": [..]}}
+static std::string detectionsJson(const Detection_Result &last, uint64_t analysed,
+                                  const Latency_Histogram &latency) {
+    char item[160];
+    snprintf(item, sizeof(item), "{\"analysed\": %llu, \"capture_to_result\": ",
+             (unsigned long long)analysed);
+    std::string json = item + latency.Json();
+    snprintf(item, sizeof(item), ", \"last\": {\"sequence\": %u, \"batch\": %u, \"infer_ms\": %.2f, \"objects\": [",
+             last.sequence, last.batch, (double)last.infer_us / 1000.0);
+    json += item;
+    for (size_t i = 0; i < last.detections.size(); i++) {
+        const Detection &d = last.detections[i];
+        const char *label = d.class_id >= 0 && d.class_id < VOC_CLASSES ? VOC_LABELS[d.class_id] : "?";
+        snprintf(item, sizeof(item),
+                 "%s{\"class\": %d, \"label\": \"%s\", \"confidence\": %.3f, \"box\": [%.4f, %.4f, %.4f, %.4f]}",
+                 i ? ", " : "", d.class_id, label, d.confidence, d.x, d.y, d.w, d.h);
+        json += item;
+    }
+    return json + "]}}";
+}
+
+// {"received": .., "last": {"sequence": .., "site": .., "cost_ms": .., "objects": [..]}}
+static std::string resultsJson(const Ingest_Frame &last, uint64_t received) {
+    const Results_Header *header;
+    const Result_Object *objects;
+    const char *text;
+    std::string json = "{\"received\": " + std::to_string(received);
+    if (!ParseResults(last.payload.data(), last.payload.size(), &header, &objects, &text)) {
+        return json + "}";
+    }
+
+    char item[192];
+    snprintf(item, sizeof(item),
+             ", \"last\": {\"sequence\": %u, \"size\": [%u, %u], \"site\": \"%s\", \"cost_ms\": %.2f, \"objects\": [",
+             last.header.sequence, last.header.width, last.header.height,
+             header->site == ANALYSIS_SERVER ? "server" : "device", (double)header->cost_us / 1000.0);
+    json += item;
+    for (uint16_t i = 0; i < header->count; i++) {
+        const Result_Object &o = objects[i];
+        snprintf(item, sizeof(item),
+                 "%s{\"kind\": %u, \"class\": %u, \"confidence\": %.3f, \"box\": [%d, %d, %d, %d], \"points\": [",
+                 i ? ", " : "", o.kind, o.class_id, o.confidence, o.box[0], o.box[1], o.box[2], o.box[3]);
+        json += item;
+        for (int p = 0; p < o.point_count; p++) {
+            snprintf(item, sizeof(item), "%s[%d, %d]", p ? ", " : "", o.polygon[p][0], o.polygon[p][1]);
+            json += item;
+        }
+        json += "]";
+        if (o.text_length > 0) {
+            // Texte libre : seuls les caracteres imprimables passent dans le JSON
+            json += ", \"text\": \"";
+            for (uint16_t k = 0; k < o.text_length; k++) {
+                char ch = text[o.text_offset + k];
+                json += (ch >= 0x20 && ch != '"' && ch != '\\') ? ch : '?';
+            }
+            json += "\"";
+        }
+        json += "}";
+    }
+    return json + "]}}";
+}
+
+// {"count": .., "mean": .., "buckets": {"<4": .., .., ">=16384": ..}}, scores = variance du laplacien
+static std::string sharpnessJson(const uint64_t *buckets, uint64_t count, uint64_t sum) {
+    char item[64];
+    // Octet moyen ramene a l'echelle du score (inverse de SharpnessByte)
+    snprintf(item, sizeof(item), "{\"count\": %llu, \"mean\": %.0f, \"buckets\": {",
+             (unsigned long long)count, exp2((double)sum / (double)count / 16.0) - 1.0);
+    std::string json = item;
+    for (int i = 0; i < SHARPNESS_BUCKETS; i++) {
+        if (i + 1 < SHARPNESS_BUCKETS) {
+            snprintf(item, sizeof(item), "%s\"<%llu\": %llu", i ? ", " : "", 1ull << (2 * (i + 1)),
+                     (unsigned long long)buckets[i]);
+        } else {
+            snprintf(item, sizeof(item), ", \">=%llu\": %llu", 1ull << (2 * i),
+                     (unsigned long long)buckets[i]);
+        }
+        json += item;
+    }
+    return json + "}}";
+}
+
+void Stream_Monitor::BeginStream(uint32_t stream_id, const std::string &peer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    streams_[stream_id].peer = peer;
+}
+
+void Stream_Monitor::Publish(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &frame) {
+    uint64_t capture_us = frame->header.capture_ts_us;
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stream &s = streams_[stream_id];
+    s.frames++;
+    s.bytes += frame->payload.size();
+    s.orientation = frame->header.orientation;
+    if (frame->header.sharpness != 0) {
+        s.sharpness[SharpnessBucket(frame->header.sharpness)]++;
+        s.sharpness_count++;
+        s.sharpness_sum += frame->header.sharpness;
+    }
+
+    if (capture_us != 0 && capture_us <= frame->recv_us &&
+        frame->recv_us - capture_us < MAX_PLAUSIBLE_LATENCY_US) {
+        s.latency.Add((double)(frame->recv_us - capture_us) / 1000.0);
+    }
+}
+
+void Stream_Monitor::OnDetections(const Detection_Result &result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = streams_.find(result.stream_id);
+    if (it == streams_.end()) return;  // flux termine pendant l'analyse
+    Stream &s = it->second;
+    s.analysed++;
+    s.last = result;
+
+    if (result.capture_ts_us != 0 && result.capture_ts_us <= result.done_us &&
+        result.done_us - result.capture_ts_us < MAX_PLAUSIBLE_LATENCY_US) {
+        s.result_latency.Add((double)(result.done_us - result.capture_ts_us) / 1000.0);
+    }
+}
+
+void Stream_Monitor::PublishResults(uint32_t stream_id,
+                                    const std::shared_ptr<const Ingest_Frame> &results) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end()) return;
+    it->second.results++;
+    it->second.last_results = results;
+}
+
+void Stream_Monitor::EndStream(uint32_t stream_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    streams_.erase(stream_id);
+}
+
+std::string Stream_Monitor::Json() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string json = "{";
+    bool first = true;
+    for (auto &entry : streams_) {
+        const Stream &s = entry.second;
+        json += (first ? "\"" : ", \"") + s.peer + "\": {\"stream\": " + std::to_string(entry.first) +
+                ", \"frames\": " + std::to_string(s.frames) + ", \"bytes\": " + std::to_string(s.bytes) +
+                ", \"orientation\": " + std::to_string(s.orientation) +
+                ", \"capture_to_receive\": " + s.latency.Json();
+        if (s.sharpness_count > 0) {
+            json += ", \"sharpness\": " + sharpnessJson(s.sharpness, s.sharpness_count, s.sharpness_sum);
+        }
+        if (s.analysed > 0) {
+            json += ", \"detections\": " + detectionsJson(s.last, s.analysed, s.result_latency);
+        }
+        if (s.last_results) {
+            json += ", \"results\": " + resultsJson(*s.last_results, s.results);
+        }
+        json += "}";
+        first = false;
+    }
+    return json + "}";
+}
@@ -0,0 +1,131 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#include "headers/Stream_Parser.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Place libre minimale pour qu'un recv() vaille l'appel systeme
+#define MIN_READ_SPACE (64u * 1024u)
+
+// Premier octet d'un header v2 ('E') : jamais un type v1
+#define V2_FIRST_BYTE (PROTO_MAGIC & 0xFFu)
+
+// Taille des messages v1 hors payload
+#define V1_DIMS_LEN 9    // type + int32 w + int32 h
+#define V1_JPEG_LEN 5    // type + int32 size
+#define V1_REPEAT_LEN 1  // type seul
+
+Stream_Parser::Stream_Parser(size_t initial_capacity)
+        : buf_(std::max<size_t>(initial_capacity, MIN_READ_SPACE)) {
+}
+
+uint8_t *Stream_Parser::WritePtr() {
+    return buf_.data() + end_;
+}
+
+size_t Stream_Parser::WriteSpace() {
+    if (begin_ == end_) {
+        begin_ = end_ = 0;  // tout consomme : on repart du debut sans rien deplacer
+    }
+
+    // Le message en tete doit tenir en entier, avec de la marge pour lire la suite
+    size_t want = std::max(need_, Buffered()) + MIN_READ_SPACE;
+    if (buf_.size() - end_ < MIN_READ_SPACE || buf_.size() - begin_ < want) {
+        compact();
+        if (buf_.size() < want) {
+            buf_.resize(want);
+        }
+    }
+    return buf_.size() - end_;
+}
+
+void Stream_Parser::Commit(size_t n) {
+    end_ += n;
+}
+
+void Stream_Parser::compact() {
+    if (begin_ == 0) return;
+    size_t left = end_ - begin_;
+    if (left > 0) {
+        memmove(buf_.data(), buf_.data() + begin_, left);
+    }
+    begin_ = 0;
+    end_ = left;
+}
+
+int Stream_Parser::Next(Parsed_Message &out) {
+    size_t avail = end_ - begin_;
+    if (avail == 0) return 0;
+
+    const uint8_t *p = buf_.data() + begin_;
+    size_t hdr_len;
+    size_t payload_len = 0;
+    out.payload = nullptr;
+    out.checksum_ok = true;
+
+    if (p[0] == V2_FIRST_BYTE) {
+        hdr_len = sizeof(FrameHeaderV2);
+        if (avail < hdr_len) {
+            need_ = hdr_len;
+            return 0;
+        }
+        memcpy(&out.header, p, hdr_len);
+        if (!IsValidHeaderV2(&out.header)) return -1;
+        payload_len = out.header.payload_len;
+        out.legacy = false;
+    } else {
+        // v1 : la longueur depend du type
+        uint8_t type = p[0];
+        InitHeaderV2(&out.header, type, 0);
+        out.legacy = true;
+
+        if (type == MSG_DIMS) {
+            hdr_len = V1_DIMS_LEN;
+            if (avail < hdr_len) {
+                need_ = hdr_len;
+                return 0;
+            }
+            int32_t w, h;
+            memcpy(&w, p + 1, sizeof(w));
+            memcpy(&h, p + 5, sizeof(h));
+            out.header.width = (uint16_t)w;
+            out.header.height = (uint16_t)h;
+        } else if (type == MSG_JPEG) {
+            hdr_len = V1_JPEG_LEN;
+            if (avail < hdr_len) {
+                need_ = hdr_len;
+                return 0;
+            }
+            int32_t size;
+            memcpy(&size, p + 1, sizeof(size));
+            if (size < 0 || (uint32_t)size > PROTO_MAX_PAYLOAD) return -1;
+            payload_len = (size_t)size;
+            out.header.payload_len = (uint32_t)size;
+            out.header.flags = FLAG_KEYFRAME;
+            out.header.codec = CODEC_JPEG;
+        } else if (type == MSG_REPEAT) {
+            hdr_len = V1_REPEAT_LEN;
+        } else {
+            return -1;
+        }
+    }
+
+    size_t total = hdr_len + payload_len;
+    if (avail < total) {
+        need_ = total;
+        return 0;
+    }
+    need_ = 0;
+
+    if (payload_len > 0) {
+        out.payload = p + hdr_len;
+    }
+    if (!out.legacy && (out.header.flags & FLAG_CHECKSUM)) {
+        out.checksum_ok = Crc32(out.payload, payload_len) == out.header.checksum;
+    }
+    begin_ += total;
+    return 1;
+}
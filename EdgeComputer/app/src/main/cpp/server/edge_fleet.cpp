@@ -0,0 +1,602 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+// Generateur de charge : N telephones simules vers edge_ingest (ou server.py)
+//   edge_fleet [-h host] [-p port] [-m http_port] [-n devices] [-f fps] [-t sec]
+//              [-W width] [-H height] [-q quality] [-S mean_kb] [-V sd_kb] [-j jitter_ms]
+//              [-i jpeg_dir|record_dir] [-Q queue] [-T tcp|striped|udp] [-k stripes] [-c]
+//              [-d delay_ms] [-x delay_jitter_ms] [-b kbit_s] [-l loss_pct] [-L stall_ms]
+// Chaque device est un SocketClient, comme sur le telephone. -S 0 : taille
+// naturelle des JPEG synthetiques. -d / -x / -b / -l passent par un relais
+// local qui degrade le lien (TCP) ; en UDP seule la perte (-l) est simulee.
+// -L : blocage suppose par perte en TCP (hypothese du relais, voir Impair_Relay.h)
+// http_port = 0 : pas de lecture de GET /stats (ni acceptation ni latence)
+
+#include "headers/Impair_Relay.h"
+#include "headers/Recording.h"
+#include "headers/Stream_Monitor.h"
+#include "Protocol.h"
+#include "SocketTcp.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <jpeglib.h>
+#include <memory>
+#include <netinet/in.h>
+#include <queue>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+// Frames distinctes envoyees en boucle (tailles tirees une fois)
+#define POOL_SIZE 64
+
+// Images synthetiques de base, chacune avec son bruit
+#define SYNTHETIC_BASES 8
+
+// Frames max chargees depuis -i
+#define MAX_LOADED_FRAMES 256
+
+// Attente des connexions avant de lancer le chronometre
+#define CONNECT_TIMEOUT_MS 5000
+
+// Donnees max d'un segment COM (longueur sur 16 bits, elle-meme comprise)
+#define JPEG_COM_MAX 65533
+
+// DeviceHello du device k : FLEET_DEVICE_ID + k, un enregistrement par device simule
+#define FLEET_DEVICE_ID 0xf1ee700000000000ull
+
+static std::atomic_bool g_stop{false};
+
+static void onSignal(int) {
+    g_stop = true;
+}
+
+typedef std::shared_ptr<const std::vector<uint8_t>> Payload;
+
+struct Fleet_Config {
+    std::string host = "127.0.0.1";
+    int port = 9999;
+    int http_port = 8080;
+    int devices = 10;
+    double fps = 30;
+    int duration_sec = 30;
+    int width = 640;
+    int height = 480;
+    int quality = 80;
+    double mean_kb = 0;    // 0 = taille naturelle
+    double sd_kb = 0;
+    int jitter_ms = 0;     // +- sur l'intervalle entre frames
+    std::string input;
+    size_t queue = 1;      // comme Transmit_Stage::AddDestination
+    transport_mode transport = TRANSPORT_TCP;
+    int stripes = 4;
+    bool checksum = false;
+    Impairment impairment;
+};
+
+// Compteurs cote serveur, sommes sur tous les flux de GET /stats
+struct Server_Totals {
+    bool ok = false;
+    uint64_t frames = 0;
+    uint64_t latency_count = 0;
+    double latency_sum_ms = 0;
+    uint64_t buckets[LATENCY_BUCKETS] = {0};
+};
+
+// Scene synthetique : degrade + bruit, pour que l'encodeur travaille comme sur une vraie image
+static std::vector<uint8_t> encodeSynthetic(int width, int height, int quality, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> noise(-24, 24);
+    std::vector<uint8_t> rgb((size_t)width * height * 3);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t *p = &rgb[((size_t)y * width + x) * 3];
+            int base = (x * 255 / width + (int)seed * 17) & 0xFF;
+            p[0] = (uint8_t)std::min(255, std::max(0, base + noise(rng)));
+            p[1] = (uint8_t)std::min(255, std::max(0, (y * 255 / height) + noise(rng)));
+            p[2] = (uint8_t)std::min(255, std::max(0, ((x ^ y) & 0xFF) + noise(rng)));
+        }
+    }
+
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    unsigned char *out = nullptr;
+    unsigned long out_size = 0;
+    jpeg_mem_dest(&cinfo, &out, &out_size);
+    cinfo.image_width = (JDIMENSION)width;
+    cinfo.image_height = (JDIMENSION)height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = &rgb[(size_t)cinfo.next_scanline * width * 3];
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    std::vector<uint8_t> jpeg(out, out + out_size);
+    jpeg_destroy_compress(&cinfo);
+    free(out);
+    return jpeg;
+}
+
+// Amene un JPEG a target octets (a 3 pres) avec des segments COM : reste decodable
+static std::vector<uint8_t> padJpeg(const std::vector<uint8_t> &jpeg, size_t target) {
+    std::vector<uint8_t> out(jpeg.begin(), jpeg.begin() + 2);  // SOI
+    size_t left = target > jpeg.size() ? target - jpeg.size() : 0;
+    while (left >= 4) {
+        size_t data = std::min<size_t>(left - 4, JPEG_COM_MAX);
+        size_t length = data + 2;
+        out.push_back(0xFF);
+        out.push_back(0xFE);
+        out.push_back((uint8_t)(length >> 8));
+        out.push_back((uint8_t)(length & 0xFF));
+        out.insert(out.end(), data, 0);
+        left -= data + 4;
+    }
+    out.insert(out.end(), jpeg.begin() + 2, jpeg.end());
+    return out;
+}
+
+static bool readFile(const std::string &path, std::vector<uint8_t> &data) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr) return false;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data.resize(size > 0 ? (size_t)size : 0);
+    bool ok = size > 0 && fread(data.data(), 1, data.size(), f) == data.size();
+    fclose(f);
+    return ok;
+}
+
+// Frames d'un enregistrement (dossier d'un telephone) ou de fichiers .jpg
+static std::vector<Payload> loadFrames(const std::string &dir) {
+    std::vector<std::string> names;
+    DIR *d = opendir(dir.c_str());
+    if (d == nullptr) {
+        LOGE("cannot open %s: %s", dir.c_str(), strerror(errno));
+        return {};
+    }
+    while (dirent *e = readdir(d)) {
+        names.emplace_back(e->d_name);
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+
+    std::vector<Payload> frames;
+    for (const std::string &name : names) {
+        if (frames.size() >= MAX_LOADED_FRAMES) break;
+        std::string path = dir + "/" + name;
+        auto endsWith = [&name](const char *ext) {
+            size_t n = strlen(ext);
+            return name.size() > n && name.compare(name.size() - n, n, ext) == 0;
+        };
+
+        if (endsWith(".jpg") || endsWith(".jpeg")) {
+            auto jpeg = std::make_shared<std::vector<uint8_t>>();
+            if (readFile(path, *jpeg)) frames.push_back(jpeg);
+        } else if (endsWith(".idx")) {
+            // Enregistrement : les JPEG sont lus dans le .seg aux positions de l'index
+            std::vector<uint8_t> index;
+            if (!readFile(path, index) || index.size() < sizeof(Record_Index_Header)) continue;
+            Record_Index_Header header;
+            memcpy(&header, index.data(), sizeof(header));
+            if (header.magic != RECORD_INDEX_MAGIC) continue;
+            int fd = open((path.substr(0, path.size() - 4) + ".seg").c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) continue;
+            uint32_t count = std::min<uint32_t>(header.count, header.capacity);
+            for (uint32_t k = 0; k < count && frames.size() < MAX_LOADED_FRAMES; k++) {
+                Record_Index_Entry entry;
+                size_t at = sizeof(Record_Index_Header) + (size_t)k * sizeof(Record_Index_Entry);
+                if (at + sizeof(entry) > index.size()) break;
+                memcpy(&entry, index.data() + at, sizeof(entry));
+                auto jpeg = std::make_shared<std::vector<uint8_t>>(entry.length);
+                if (pread(fd, jpeg->data(), entry.length, (off_t)entry.offset) == (ssize_t)entry.length) {
+                    frames.push_back(jpeg);
+                }
+            }
+            close(fd);
+        }
+    }
+    return frames;
+}
+
+static std::vector<Payload> syntheticFrames(const Fleet_Config &config) {
+    std::vector<std::vector<uint8_t>> bases;
+    for (unsigned k = 0; k < SYNTHETIC_BASES; k++) {
+        bases.push_back(encodeSynthetic(config.width, config.height, config.quality, k + 1));
+    }
+    LOGI("fleet: synthetic %dx%d q%d, natural size %.1f kB", config.width, config.height,
+         config.quality, (double)bases[0].size() / 1024.0);
+
+    // Tailles tirees une fois pour toutes (loi normale, jamais sous la taille naturelle)
+    std::mt19937 rng(42);
+    std::normal_distribution<double> size_kb(config.mean_kb, config.sd_kb);
+    std::vector<Payload> frames;
+    for (int k = 0; k < POOL_SIZE; k++) {
+        const std::vector<uint8_t> &base = bases[k % SYNTHETIC_BASES];
+        if (config.mean_kb <= 0) {
+            frames.push_back(std::make_shared<std::vector<uint8_t>>(base));
+            continue;
+        }
+        size_t target = (size_t)std::max(0.0, size_kb(rng) * 1024.0);
+        frames.push_back(std::make_shared<std::vector<uint8_t>>(padJpeg(base, target)));
+    }
+    return frames;
+}
+
+// Corps de GET /stats, vide en cas d'echec
+static std::string fetchStats(const std::string &host, int port) {
+    int sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) return "";
+    timeval tv{2, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    std::string response;
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) == 1 &&
+        connect(sock, (sockaddr *)&addr, sizeof(addr)) == 0) {
+        static const char request[] = "GET /stats HTTP/1.0\r\n\r\n";
+        if (send(sock, request, sizeof(request) - 1, MSG_NOSIGNAL) == (ssize_t)sizeof(request) - 1) {
+            char buf[16384];
+            ssize_t r;
+            while ((r = recv(sock, buf, sizeof(buf), 0)) > 0) {
+                response.append(buf, (size_t)r);
+            }
+        }
+    }
+    close(sock);
+
+    size_t body = response.find("\r\n\r\n");
+    return body == std::string::npos ? "" : response.substr(body + 4);
+}
+
+/**
+ * Somme des flux entrants de GET /stats. edge_ingest et server.py donnent
+ * chacun, par flux, "frames" puis "capture_to_receive" (count, mean_ms,
+ * buckets_ms dans l'ordre de LATENCY_BOUNDS_MS) : pas besoin d'un vrai
+ * parseur JSON.
+ */
+static Server_Totals parseStats(const std::string &json) {
+    Server_Totals totals;
+    if (json.empty()) return totals;
+    totals.ok = true;
+
+    auto valueAfter = [&json](size_t from, const char *key, size_t &at) -> const char * {
+        at = json.find(key, from);
+        if (at == std::string::npos) return nullptr;
+        at += strlen(key);
+        return json.c_str() + at;
+    };
+
+    uint64_t frames = 0;
+    size_t pos = 0;
+    for (;;) {
+        size_t f = json.find("\"frames\": ", pos);
+        size_t c = json.find("\"capture_to_receive\": ", pos);
+        if (c == std::string::npos) break;
+        if (f != std::string::npos && f < c) {
+            // "frames" d'un client MJPEG ou du flux qui suit : seul le dernier compte
+            frames = strtoull(json.c_str() + f + 10, nullptr, 10);
+            pos = f + 10;
+            continue;
+        }
+
+        size_t at;
+        const char *v = valueAfter(c, "\"count\": ", at);
+        if (v == nullptr) break;
+        uint64_t count = strtoull(v, nullptr, 10);
+        v = valueAfter(at, "\"mean_ms\": ", at);
+        double mean = (v != nullptr && *v != 'n') ? strtod(v, nullptr) : 0.0;
+        size_t buckets = json.find("\"buckets_ms\": {", at);
+        if (buckets == std::string::npos) break;
+        at = buckets + 14;  // sur le '{', avant le premier seau
+        for (int i = 0; i < LATENCY_BUCKETS; i++) {
+            at = json.find("\": ", at + 1);
+            if (at == std::string::npos) break;
+            totals.buckets[i] += strtoull(json.c_str() + at + 3, nullptr, 10);
+        }
+
+        totals.frames += frames;
+        totals.latency_count += count;
+        totals.latency_sum_ms += mean * (double)count;
+        frames = 0;
+        pos = at == std::string::npos ? json.size() : at;
+    }
+    return totals;
+}
+
+// Borne superieure du seau qui contient le centile q
+static std::string percentile(const uint64_t *buckets, uint64_t total, double q) {
+    if (total == 0) return "-";
+    uint64_t rank = (uint64_t)std::ceil(q * (double)total);
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            char label[32];
+            if (i + 1 < LATENCY_BUCKETS) {
+                snprintf(label, sizeof(label), "<=%g", LATENCY_BOUNDS_MS[i]);
+            } else {
+                snprintf(label, sizeof(label), ">%g", LATENCY_BOUNDS_MS[i - 1]);
+            }
+            return label;
+        }
+    }
+    return "-";
+}
+
+static uint64_t clientSent(const std::vector<std::unique_ptr<SocketClient>> &clients) {
+    uint64_t sent = 0;
+    for (auto &client : clients) sent += client->FramesSent();
+    return sent;
+}
+
+int main(int argc, char **argv) {
+    Fleet_Config config;
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:m:n:f:t:W:H:q:S:V:j:i:Q:T:k:cd:x:b:l:L:")) != -1) {
+        switch (opt) {
+            case 'h': config.host = optarg; break;
+            case 'p': config.port = atoi(optarg); break;
+            case 'm': config.http_port = atoi(optarg); break;
+            case 'n': config.devices = atoi(optarg); break;
+            case 'f': config.fps = atof(optarg); break;
+            case 't': config.duration_sec = atoi(optarg); break;
+            case 'W': config.width = atoi(optarg); break;
+            case 'H': config.height = atoi(optarg); break;
+            case 'q': config.quality = atoi(optarg); break;
+            case 'S': config.mean_kb = atof(optarg); break;
+            case 'V': config.sd_kb = atof(optarg); break;
+            case 'j': config.jitter_ms = atoi(optarg); break;
+            case 'i': config.input = optarg; break;
+            case 'Q': config.queue = (size_t)std::max(1, atoi(optarg)); break;
+            case 'T':
+                if (strcmp(optarg, "udp") == 0) config.transport = TRANSPORT_UDP;
+                else if (strcmp(optarg, "striped") == 0) config.transport = TRANSPORT_TCP_STRIPED;
+                else config.transport = TRANSPORT_TCP;
+                break;
+            case 'k': config.stripes = atoi(optarg); break;
+            case 'c': config.checksum = true; break;
+            case 'd': config.impairment.delay_ms = atoi(optarg); break;
+            case 'x': config.impairment.jitter_ms = atoi(optarg); break;
+            case 'b': config.impairment.rate_kbps = atoi(optarg); break;
+            case 'l': config.impairment.loss = atof(optarg) / 100.0; break;
+            case 'L': config.impairment.loss_stall_ms = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-h host] [-p port] [-m http_port] [-n devices] [-f fps] [-t sec]"
+                                " [-W width] [-H height] [-q quality] [-S mean_kb] [-V sd_kb] [-j jitter_ms]"
+                                " [-i jpeg_dir|record_dir] [-Q queue] [-T tcp|striped|udp] [-k stripes] [-c]"
+                                " [-d delay_ms] [-x delay_jitter_ms] [-b kbit_s] [-l loss_pct] [-L stall_ms]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+    if (config.devices <= 0 || config.fps <= 0 || config.duration_sec <= 0) {
+        LOGE("devices, fps and duration must be positive");
+        return 2;
+    }
+
+    struct sigaction sa{};
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<Payload> frames = config.input.empty() ? syntheticFrames(config) : loadFrames(config.input);
+    if (frames.empty()) {
+        LOGE("no frames to send");
+        return 1;
+    }
+    double mean_bytes = 0;
+    for (auto &frame : frames) mean_bytes += (double)frame->size();
+    mean_bytes /= (double)frames.size();
+
+    // Degradation du lien : les clients TCP passent par le relais
+    std::string host = config.host;
+    int port = config.port;
+    std::unique_ptr<Impair_Relay> relay;
+    if (config.impairment.Active() && config.transport != TRANSPORT_UDP) {
+        relay = std::make_unique<Impair_Relay>(config.host, config.port, config.impairment);
+        if (!relay->Start()) return 1;
+        host = "127.0.0.1";
+        port = relay->Port();
+    }
+
+    std::vector<std::unique_ptr<SocketClient>> clients;
+    for (int k = 0; k < config.devices; k++) {
+        auto client = std::make_unique<SocketClient>(host, port, config.queue, DROP_OLDEST);
+        client->SetTransport(config.transport);
+        client->SetStripeCount(config.stripes);
+        client->SetChecksum(config.checksum);
+        client->SetDeviceId(FLEET_DEVICE_ID + (uint64_t)k);
+        if (config.transport == TRANSPORT_UDP) {
+            client->Datagrams().SetSimulatedLoss(config.impairment.loss);
+        }
+        client->SendImageDims(config.width, config.height);
+        client->Start();
+        clients.push_back(std::move(client));
+    }
+
+    // Chronometre lance une fois les devices connectes
+    uint64_t wait_until = ProtoClockMicros() + CONNECT_TIMEOUT_MS * 1000u;
+    int connected = 0;
+    while (!g_stop && ProtoClockMicros() < wait_until) {
+        connected = (int)std::count_if(clients.begin(), clients.end(),
+                                       [](const std::unique_ptr<SocketClient> &c) { return c->IsConnected(); });
+        if (connected == config.devices) break;
+        usleep(10000);
+    }
+    LOGI("fleet: %d/%d devices connected, %.0f fps each, %zu frames of %.1f kB on average",
+         connected, config.devices, config.fps, frames.size(), mean_bytes / 1024.0);
+
+    Server_Totals before;
+    if (config.http_port > 0) before = parseStats(fetchStats(config.host, config.http_port));
+
+    // Ordonnanceur unique : prochaine frame de chaque device, phases reparties sur une periode
+    std::mt19937 rng(7);
+    const uint64_t period_us = (uint64_t)(1e6 / config.fps);
+    std::uniform_int_distribution<int64_t> phase(0, (int64_t)period_us - 1);
+    std::uniform_int_distribution<int64_t> jitter(-config.jitter_ms * 1000, config.jitter_ms * 1000);
+    std::uniform_int_distribution<size_t> pick(0, frames.size() - 1);
+    typedef std::pair<uint64_t, int> Due;
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> schedule;
+
+    const uint64_t start_us = ProtoClockMicros();
+    const uint64_t end_us = start_us + (uint64_t)config.duration_sec * 1000000u;
+    for (int k = 0; k < config.devices; k++) {
+        schedule.push({start_us + (uint64_t)phase(rng), k});
+    }
+
+    uint64_t offered = 0;
+    uint64_t offline = 0;
+    uint64_t offered_bytes = 0;
+    uint64_t last_report_us = start_us;
+    uint64_t last_offered = 0;
+    uint64_t last_sent = 0;
+    while (!g_stop && !schedule.empty()) {
+        Due next = schedule.top();
+        if (next.first >= end_us) break;
+
+        uint64_t now = ProtoClockMicros();
+        if (next.first > now) {
+            uint64_t wait = std::min<uint64_t>(next.first - now, 100000u);
+            timespec ts{(time_t)(wait / 1000000u), (long)(wait % 1000000u) * 1000};
+            nanosleep(&ts, nullptr);
+            continue;
+        }
+        schedule.pop();
+
+        SocketClient *client = clients[next.second].get();
+        Payload frame = frames[pick(rng)];
+        if (client->SendEncoded(frame, config.width, config.height, CODEC_JPEG, ProtoClockMicros())) {
+            offered++;
+            offered_bytes += frame->size();
+        } else {
+            offline++;  // pas de session : le telephone n'encoderait pas
+        }
+
+        int64_t step = (int64_t)period_us + (config.jitter_ms > 0 ? jitter(rng) : 0);
+        schedule.push({next.first + (uint64_t)std::max<int64_t>(step, 1), next.second});
+
+        if (now - last_report_us >= 1000000u) {
+            double sec = (double)(now - last_report_us) / 1e6;
+            uint64_t sent = clientSent(clients);
+            connected = (int)std::count_if(clients.begin(), clients.end(),
+                                           [](const std::unique_ptr<SocketClient> &c) { return c->IsConnected(); });
+            LOGI("fleet: t=%.0fs %d/%d connected, offered %.0f fps, sent %.0f fps",
+                 (double)(now - start_us) / 1e6, connected, config.devices,
+                 (double)(offered - last_offered) / sec, (double)(sent - last_sent) / sec);
+            last_report_us = now;
+            last_offered = offered;
+            last_sent = sent;
+        }
+    }
+    double elapsed = (double)(ProtoClockMicros() - start_us) / 1e6;
+
+    // Laisse partir ce qui est encore en file avant de lire les compteurs du serveur
+    uint64_t drain_until = ProtoClockMicros() + 2000000u;
+    uint64_t sent = clientSent(clients);
+    while (ProtoClockMicros() < drain_until) {
+        usleep(100000);
+        uint64_t now_sent = clientSent(clients);
+        if (now_sent == sent) break;
+        sent = now_sent;
+    }
+
+    // Puis ce que le relais et les buffers noyau retiennent : jusqu'a ce que le serveur ne recoive plus rien
+    Server_Totals after;
+    if (config.http_port > 0) {
+        uint64_t settle_until = ProtoClockMicros() + 3000000u;
+        do {
+            usleep(200000 + (useconds_t)config.impairment.delay_ms * 1000u);
+            Server_Totals now = parseStats(fetchStats(config.host, config.http_port));
+            bool settled = now.ok && after.ok && now.frames == after.frames;
+            after = now;
+            if (settled) break;
+        } while (ProtoClockMicros() < settle_until);
+    }
+
+    uint64_t dropped = 0;
+    uint64_t skipped = 0;
+    uint64_t bytes = 0;
+    uint32_t reconnections = 0;
+    for (auto &client : clients) {
+        dropped += client->FramesDropped();
+        skipped += client->FramesSkipped();
+        bytes += client->BytesSent();
+        reconnections += client->Reconnections();
+    }
+    for (auto &client : clients) client->Close();
+    if (relay) relay->Stop();
+
+    static const char *TRANSPORT_NAMES[] = {"tcp", "udp", "striped"};
+    LOGI("fleet: %d devices x %.0f fps for %.1f s over %s", config.devices, config.fps, elapsed,
+         TRANSPORT_NAMES[config.transport]);
+    if (config.impairment.Active()) {
+        // Les resultats TCP sous perte dependent du blocage suppose : il est rappele ici
+        const Impairment &imp = config.impairment;
+        if (config.transport == TRANSPORT_UDP) {
+            LOGI("fleet: link: %.1f %% datagram loss (sender side)", imp.loss * 100.0);
+        } else {
+            LOGI("fleet: link: delay %d ms +- %d ms, max %d kbit/s (0 = none), %.1f %% loss, "
+                 "assumed stall %d ms per lossy chunk (-L)",
+                 imp.delay_ms, imp.jitter_ms, imp.rate_kbps, imp.loss * 100.0, imp.loss_stall_ms);
+        }
+    }
+    LOGI("fleet: client: offered %llu (%.0f fps, %.1f Mbit/s), sent %llu, dropped %llu (queue), "
+         "skipped %llu (latency budget), offline %llu, reconnections %u, %.1f Mbit/s on the wire",
+         (unsigned long long)offered, (double)offered / elapsed, (double)offered_bytes * 8.0 / elapsed / 1e6,
+         (unsigned long long)sent, (unsigned long long)dropped, (unsigned long long)skipped,
+         (unsigned long long)offline, reconnections, (double)bytes * 8.0 / elapsed / 1e6);
+
+    if (!before.ok || !after.ok) {
+        LOGE("fleet: server: no GET /stats on %s:%d", config.host.c_str(), config.http_port);
+        return 0;
+    }
+    uint64_t received = after.frames > before.frames ? after.frames - before.frames : 0;
+    uint64_t buckets[LATENCY_BUCKETS];
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        buckets[i] = after.buckets[i] > before.buckets[i] ? after.buckets[i] - before.buckets[i] : 0;
+    }
+    uint64_t measured = after.latency_count > before.latency_count ? after.latency_count - before.latency_count : 0;
+    double latency_sum = after.latency_sum_ms - before.latency_sum_ms;
+
+    // Debit utile : frames recues x taille moyenne (server.py ne compte pas les octets)
+    LOGI("fleet: server: received %llu (%.1f %% of offered, %.1f %% of sent), about %.1f Mbit/s",
+         (unsigned long long)received, offered ? 100.0 * (double)received / (double)offered : 0.0,
+         sent ? 100.0 * (double)received / (double)sent : 0.0,
+         (double)received * mean_bytes * 8.0 / elapsed / 1e6);
+    if (measured > 0) {
+        LOGI("fleet: server: capture -> receive over %llu frames: mean %.2f ms, p50 %s, p90 %s, p99 %s ms",
+             (unsigned long long)measured, latency_sum / (double)measured,
+             percentile(buckets, measured, 0.50).c_str(), percentile(buckets, measured, 0.90).c_str(),
+             percentile(buckets, measured, 0.99).c_str());
+    } else {
+        LOGI("fleet: server: no latency (v1 devices, or clocks not comparable)");
+    }
+    return 0;
+}
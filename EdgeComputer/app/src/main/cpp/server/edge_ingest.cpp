@@ -0,0 +1,251 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+// Serveur d'ingestion natif :
+//   edge_ingest [-p port] [-m http_port] [-e evict_ms] [-r report_sec] [-w workers] [-a]
+//               [-d record_dir [-s segment_mb] [-B max_mb] [-T max_age_sec]]
+//               [-M model [-C config] [-b batch] [-F fps]]
+// http_port = 0 : pas de redistribution MJPEG ; evict_ms = 0 : jamais couper un client lent
+// Sans -d, rien n'est enregistre ; -B / -T a 0 : pas de limite
+// workers > 1 : une boucle par thread sur les memes ports, flux partages en memoire (/dev/shm)
+// -a : flux publies dans /dev/shm meme avec un seul worker, pour les lecteurs Shm_Client
+// -M : detection d'objets par lots sur tous les flux (build avec OpenCV dnn seulement)
+
+#ifdef EDGE_DNN
+#include "headers/Dnn_Detector.h"
+#endif
+#include "headers/Ingest_Server.h"
+#include "headers/Recorder.h"
+#include "headers/Shm_Publisher.h"
+#include "headers/Stream_Directory.h"
+#include "headers/Stream_Monitor.h"
+#include "Util.h"
+
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <getopt.h>
+#include <memory>
+#include <pthread.h>
+#include <thread>
+#include <vector>
+
+static std::atomic_bool g_stop(false);
+
+static void onSignal(int) {
+    g_stop = true;
+}
+
+// Resultats des telephones d'un worker vers les clients HTTP des autres (/results?live=1)
+struct Results_Relay : public Frame_Sink {
+    std::vector<Mjpeg_Server *> targets;
+
+    void Publish(uint32_t /*stream_id*/, const std::shared_ptr<const Ingest_Frame> & /*frame*/) override {}
+    void PublishResults(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &results) override {
+        for (Mjpeg_Server *mjpeg : targets) {
+            mjpeg->PublishResults(stream_id, results);
+        }
+    }
+    void EndStream(uint32_t /*stream_id*/) override {}
+};
+
+// Une boucle d'ingestion : ses telephones, ses clients HTTP
+struct Worker {
+    Mjpeg_Server mjpeg;
+    Ingest_Server server;
+    std::unique_ptr<Shm_Publisher> publisher;
+    Results_Relay relay;
+
+    Worker(int port, int http_port, int evict_ms, int report_sec)
+            : mjpeg(http_port, evict_ms), server(port, report_sec) {}
+};
+
+int main(int argc, char **argv) {
+    int port = 9999;
+    int http_port = 8080;
+    int evict_ms = 10000;
+    int report_sec = 5;
+    int workers = 1;
+    bool analytics = false;
+    Recorder_Config record;
+#ifdef EDGE_DNN
+    Dnn_Config dnn;
+#endif
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:m:e:r:w:ad:s:B:T:M:C:b:F:")) != -1) {
+        switch (opt) {
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'm':
+                http_port = atoi(optarg);
+                break;
+            case 'e':
+                evict_ms = atoi(optarg);
+                break;
+            case 'r':
+                report_sec = atoi(optarg);
+                break;
+            case 'w':
+                workers = atoi(optarg);
+                break;
+            case 'a':
+                analytics = true;
+                break;
+            case 'd':
+                record.dir = optarg;
+                break;
+            case 's':
+                record.segment_bytes = strtoull(optarg, nullptr, 10) << 20;
+                break;
+            case 'B':
+                record.max_bytes = strtoull(optarg, nullptr, 10) << 20;
+                break;
+            case 'T':
+                record.max_age_sec = strtoull(optarg, nullptr, 10);
+                break;
+#ifdef EDGE_DNN
+            case 'M':
+                dnn.model = optarg;
+                break;
+            case 'C':
+                dnn.config = optarg;
+                break;
+            case 'b':
+                dnn.batch = atoi(optarg);
+                break;
+            case 'F':
+                dnn.fps = atof(optarg);
+                break;
+#else
+            case 'M':
+            case 'C':
+            case 'b':
+            case 'F':
+                LOGE("-%c: built without OpenCV dnn", opt);
+                return 2;
+#endif
+            default:
+                fprintf(stderr, "usage: %s [-p port] [-m http_port] [-e evict_ms] [-r report_sec]"
+                                " [-w workers] [-a] [-d record_dir [-s segment_mb] [-B max_mb] [-T max_age_sec]]"
+                                " [-M model [-C config] [-b batch] [-F fps]]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (workers < 1 || workers > MAX_WORKERS) {
+        LOGE("workers: 1 to %d", MAX_WORKERS);
+        return 2;
+    }
+
+    // Pas de SA_RESTART : epoll_wait rend la main avec EINTR et la boucle voit g_stop
+    struct sigaction sa{};
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Partages par les workers (thread-safe)
+    Decode_Service decoder;
+    Stream_Monitor monitor;
+    Recorder recorder(record);
+    if (!record.dir.empty()) {
+        if (record.segment_bytes == 0 || !recorder.Start()) return 1;
+    }
+#ifdef EDGE_DNN
+    std::unique_ptr<Dnn_Detector> detector;
+    if (!dnn.model.empty()) {
+        detector = std::make_unique<Dnn_Detector>(dnn);
+        detector->AddSink(&monitor);
+        // Detections enregistrees avec les frames, comme les resultats des telephones
+        if (!record.dir.empty()) detector->AddResultsSink(&recorder);
+    }
+#endif
+    bool shared = workers > 1 || analytics;
+    Stream_Directory directory(port, workers);
+    if (shared && !directory.Create()) return 1;
+
+    std::vector<std::unique_ptr<Worker>> pool;
+    for (int w = 0; w < workers; w++) {
+        auto worker = std::make_unique<Worker>(port, http_port, evict_ms, report_sec);
+        Mjpeg_Server &mjpeg = worker->mjpeg;
+        Ingest_Server &server = worker->server;
+        mjpeg.SetDecoder(&decoder);
+        mjpeg.SetMonitor(&monitor);
+        if (shared) {
+            worker->publisher = std::make_unique<Shm_Publisher>(&directory, w);
+            server.AddSink(worker->publisher.get());
+        }
+        if (workers > 1) {
+            server.SetWorker(w, workers);
+            mjpeg.SetDirectory(&directory, w);
+        }
+        server.AddSink(&decoder);
+        server.AddSink(&monitor);
+#ifdef EDGE_DNN
+        if (detector) server.AddSink(detector.get());
+#endif
+        if (http_port > 0) server.SetMjpeg(&mjpeg);
+        if (!record.dir.empty()) {
+            server.AddSink(&recorder);
+            mjpeg.SetRecorder(&recorder);
+        }
+        if (!server.Start()) return 1;
+        pool.push_back(std::move(worker));
+    }
+    if (http_port > 0) {
+        for (auto &worker : pool) {
+            // Un client HTTP peut suivre les resultats d'un flux recu par un autre worker
+            for (auto &other : pool) {
+                if (other != worker) worker->relay.targets.push_back(&other->mjpeg);
+            }
+            if (workers > 1) worker->server.AddSink(&worker->relay);
+#ifdef EDGE_DNN
+            if (detector) detector->AddResultsSink(&worker->mjpeg);
+#endif
+        }
+    }
+#ifdef EDGE_DNN
+    if (detector && !detector->Start()) return 1;
+#endif
+
+    // Signaux pour le thread principal seulement : il reveille les autres a l'arret
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    std::vector<std::thread> threads;
+    for (int w = 1; w < workers; w++) {
+        threads.emplace_back(&Ingest_Server::Run, &pool[w]->server, std::cref(g_stop));
+    }
+    pthread_sigmask(SIG_UNBLOCK, &signals, nullptr);
+
+    pool[0]->server.Run(g_stop);
+    g_stop = true;
+    for (int w = 1; w < workers; w++) {
+        pool[w]->server.Wake();
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    recorder.Stop();
+#ifdef EDGE_DNN
+    if (detector) detector->Stop();
+#endif
+
+    Ingest_Stats stats;
+    for (auto &worker : pool) {
+        const Ingest_Stats &s = worker->server.Stats();
+        stats.accepted += s.accepted;
+        stats.frames += s.frames;
+        stats.bytes += s.bytes;
+        stats.errors += s.errors;
+    }
+    LOGI("stopped: %llu connections, %llu frames, %llu bytes, %llu errors",
+         (unsigned long long)stats.accepted, (unsigned long long)stats.frames,
+         (unsigned long long)stats.bytes, (unsigned long long)stats.errors);
+    return 0;
+}
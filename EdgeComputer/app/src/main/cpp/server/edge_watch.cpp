@@ -0,0 +1,168 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+// Exemple de lecteur Shm_Client : suit un flux publie par edge_ingest (-a ou -w)
+//   edge_watch [-p port] [-s stream] [-t sec] [-W width] [-g] [-o last.jpg] [-l]
+// stream = 0 : flux par defaut ; sec = 0 : jusqu'a Ctrl+C ou la fin du flux
+// -W : decode chaque frame lue a cette largeur (0 = JPEG seul) ; -g : en gris
+// -l : liste les flux publies et sort
+
+#include "Jpeg_Exif.h"
+#include "headers/Shm_Client.h"
+#include "headers/Stream_Monitor.h"
+#include "Protocol.h"
+#include "Util.h"
+
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <getopt.h>
+#include <string>
+
+// Periode d'affichage des compteurs
+#define REPORT_US 1000000u
+
+static std::atomic_bool g_stop{false};
+
+static void onSignal(int) {
+    g_stop = true;
+}
+
+int main(int argc, char **argv) {
+    int port = 9999;
+    uint32_t stream_id = 0;
+    int duration_sec = 0;
+    int width = 0;
+    bool gray = false;
+    bool list = false;
+    std::string output;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:s:t:W:go:l")) != -1) {
+        switch (opt) {
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 's':
+                stream_id = (uint32_t)strtoul(optarg, nullptr, 10);
+                break;
+            case 't':
+                duration_sec = atoi(optarg);
+                break;
+            case 'W':
+                width = atoi(optarg);
+                break;
+            case 'g':
+                gray = true;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'l':
+                list = true;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-p port] [-s stream] [-t sec] [-W width] [-g]"
+                                " [-o last.jpg] [-l]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    struct sigaction sa{};
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    Shm_Client client(port);
+    if (!client.Open()) return 1;
+    if (list) {
+        for (const Shared_Stream_Info &s : client.Streams()) {
+            LOGI("stream %u: %s, worker %u", s.stream_id, s.peer.c_str(), s.worker);
+        }
+        return 0;
+    }
+
+    std::shared_ptr<Frame_Ring_Reader> ring = client.Attach(stream_id);
+    if (!ring) {
+        LOGE("stream %u not published", stream_id);
+        return 1;
+    }
+    LOGI("watching stream %u", ring->StreamId());
+
+    Decode_Request req;
+    req.width = width;
+    req.gray = gray;
+    Decoded_Image image{};
+
+    uint64_t start_us = ProtoClockMicros();
+    uint64_t end_us = duration_sec > 0 ? start_us + (uint64_t)duration_sec * 1000000u : 0;
+    uint64_t report_us = start_us + REPORT_US;
+    uint64_t seen = 0;
+    uint64_t frames = 0, skipped = 0, decodes = 0, decode_us = 0, total_frames = 0, total_skipped = 0;
+    Latency_Histogram latency;
+    std::shared_ptr<const Ring_Pin> last;
+
+    while (!g_stop && !ring->Closed()) {
+        // Seul appel systeme de la boucle, et seulement quand rien de neuf n'est publie
+        if (!ring->Wait(seen, 200)) {
+            if (end_us != 0 && ProtoClockMicros() >= end_us) break;
+            continue;
+        }
+        std::shared_ptr<const Ring_Pin> pin = ring->PinLatest();
+        if (pin && pin->index != seen) {
+            if (seen != 0 && pin->index > seen + 1) skipped += pin->index - seen - 1;
+            seen = pin->index;
+            frames++;
+
+            uint64_t now = ProtoClockMicros();
+            uint64_t capture_us = pin->slot->header.capture_ts_us;
+            if (capture_us != 0 && capture_us <= now && now - capture_us < MAX_PLAUSIBLE_LATENCY_US) {
+                latency.Add((double)(now - capture_us) / 1000.0);
+            }
+            if (width > 0) {
+                if (Shm_Client::Decode(*pin, req, image)) decodes++;
+                decode_us += ProtoClockMicros() - now;
+            }
+            // Seule la derniere reste epinglee (pour -o) : les autres emplacements restent libres
+            last = output.empty() ? nullptr : pin;
+        }
+
+        uint64_t now = ProtoClockMicros();
+        if (now >= report_us) {
+            LOGI("stream %u: %llu frames/s, %llu skipped, %llu decodes (%.2f ms each)",
+                 ring->StreamId(), (unsigned long long)frames, (unsigned long long)skipped,
+                 (unsigned long long)decodes, decodes ? (double)decode_us / 1000.0 / (double)decodes : 0.0);
+            fflush(stdout);
+            total_frames += frames;
+            total_skipped += skipped;
+            frames = skipped = decodes = decode_us = 0;
+            report_us = now + REPORT_US;
+        }
+        if (end_us != 0 && now >= end_us) break;
+    }
+    total_frames += frames;
+    total_skipped += skipped;
+
+    LOGI("stream %u%s: %llu frames read, %llu skipped, capture -> read %s", ring->StreamId(),
+         ring->Closed() ? " ended" : "", (unsigned long long)total_frames,
+         (unsigned long long)total_skipped, latency.Json().c_str());
+    if (width > 0 && image.width > 0) {
+        LOGI("last decode: %dx%d x%d (IDCT %d/8)", image.width, image.height, image.channels,
+             image.scale_num);
+    }
+    if (last) {
+        // Tel que recu, avec son tag EXIF s'il est en orientation capteur
+        std::string exif;
+        size_t skip = JpegOrientationPrefix(last->data, last->length,
+                                            last->slot->header.orientation, exif);
+        FILE *f = fopen(output.c_str(), "wb");
+        if (f == nullptr || fwrite(exif.data(), 1, exif.size(), f) != exif.size() ||
+            fwrite(last->data + skip, 1, last->length - skip, f) != last->length - skip) {
+            LOGE("cannot write %s", output.c_str());
+        }
+        if (f != nullptr) fclose(f);
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_DECODE_SERVICE_H
+#define EDGECOMPUTER_DECODE_SERVICE_H
+
+#include "Ingest_Frame.h"
+
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct Decode_Request {
+    uint32_t stream_id = 0;
+    bool latest = true;      // sinon la frame numero sequence
+    uint32_t sequence = 0;
+    int width = 0;           // 0 : deduit de l'autre dimension (ratio conserve), ou taille native
+    int height = 0;
+    bool gray = false;       // luminance seule : pas de chroma a decoder
+    bool upright = false;    // redresse (FrameHeaderV2::orientation) ; width / height de l'image droite
+};
+
+// Image decodee, immuable et partagee entre les demandeurs
+struct Decoded_Image {
+    uint32_t stream_id;
+    uint32_t sequence;
+    int width;
+    int height;
+    int channels;            // 1 (gris) ou 3 (RGB)
+    int scale_num;           // echelle IDCT utilisee : scale_num / 8
+    uint8_t orientation;     // redressement restant a faire (OrientationByte), 0 si droite
+    std::vector<uint8_t> pixels;  // lignes contigues
+};
+
+struct Decode_Stats {
+    uint64_t decodes = 0;
+    uint64_t cache_hits = 0;
+    uint64_t failures = 0;   // frame inconnue ou JPEG illisible
+    uint64_t decode_us = 0;  // temps cumule passe a decoder
+};
+
+/**
+ * Decodage a la demande des frames recues, pour l'analyse et les miniatures.
+ *
+ * Les reductions passent par l'IDCT reduite de libjpeg (scale_num / 8) : un
+ * JPEG est decode directement a la plus petite echelle qui couvre la taille
+ * demandee, puis ajuste par moyenne de zones si la taille ne tombe pas juste.
+ * En gris, seule la luminance est decodee. Les pixels restent en orientation
+ * capteur sauf demande upright : c'est alors le seul endroit ou ils tournent.
+ *
+ * Garde par flux les dernieres frames recues et les derniers decodages.
+ * Thread-safe : Decode() peut etre appele hors de la boucle d'ingestion. Le
+ * decodage se fait hors verrou ; une demande identique en cours est attendue.
+ */
+class Decode_Service : public Frame_Sink {
+public:
+    explicit Decode_Service(size_t history = 8, size_t cache = 4);
+
+    void Publish(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &frame) override;
+    void EndStream(uint32_t stream_id) override;
+
+    // @return nullptr si la frame n'est plus (ou pas) disponible, ou si le JPEG est illisible
+    std::shared_ptr<const Decoded_Image> Decode(const Decode_Request &req);
+
+    // Decodage seul, sans historique ni cache (req.stream_id et req.sequence ignores).
+    // out.pixels est reutilise d'un appel a l'autre. @return false si le JPEG est illisible
+    // @param orientation celle de la frame : appliquee si req.upright, sinon reportee dans out
+    static bool DecodeJpeg(const uint8_t *data, size_t length, const Decode_Request &req,
+                           Decoded_Image &out, uint8_t orientation = 0);
+
+    Decode_Stats Stats();
+
+private:
+    struct Cached {
+        uint32_t sequence;
+        int width;   // taille demandee (0 = libre)
+        int height;
+        bool gray;
+        bool upright;
+        // Pret une fois le decodage termine ; nullptr si le JPEG est illisible
+        std::shared_future<std::shared_ptr<const Decoded_Image>> image;
+    };
+
+    struct Stream {
+        std::deque<std::shared_ptr<const Ingest_Frame>> frames;  // plus recente en tete
+        std::deque<Cached> cache;                                 // plus recente en tete
+    };
+
+    size_t history_;
+    size_t cache_size_;
+    std::mutex mutex_;
+    std::unordered_map<uint32_t, Stream> streams_;
+    Decode_Stats stats_;
+};
+
+#endif //EDGECOMPUTER_DECODE_SERVICE_H
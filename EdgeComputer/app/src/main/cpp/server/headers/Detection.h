@@ -0,0 +1,46 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_DETECTION_H
+#define EDGECOMPUTER_DETECTION_H
+
+#include <cstdint>
+#include <vector>
+
+// Un objet detecte, boite en coordonnees normalisees (0..1) de la frame telle que recue
+struct Detection {
+    int class_id;
+    float confidence;
+    float x;
+    float y;
+    float w;
+    float h;
+};
+
+// Resultat de l'analyse d'une frame
+struct Detection_Result {
+    uint32_t stream_id = 0;
+    uint32_t sequence = 0;        // numero de la frame analysee
+    uint64_t capture_ts_us = 0;   // horodatage capteur de la frame
+    uint64_t done_us = 0;         // ProtoClockMicros() a la fin de l'inference
+    uint32_t batch = 0;           // frames dans le meme forward
+    uint32_t infer_us = 0;        // duree du forward (partagee par tout le lot)
+    std::vector<Detection> detections;
+};
+
+// Destinataire des resultats, appele depuis le thread d'analyse
+class Detection_Sink {
+public:
+    virtual ~Detection_Sink() = default;
+    virtual void OnDetections(const Detection_Result &result) = 0;
+};
+
+// Classes de MobileNet-SSD (VOC), le modele de l'exemple mobilenet-objdetect du SDK
+#define VOC_CLASSES 21
+static const char *const VOC_LABELS[VOC_CLASSES] = {
+        "background", "aeroplane", "bicycle", "bird", "boat", "bottle", "bus", "car", "cat",
+        "chair", "cow", "diningtable", "dog", "horse", "motorbike", "person", "pottedplant",
+        "sheep", "sofa", "train", "tvmonitor"};
+
+#endif //EDGECOMPUTER_DETECTION_H
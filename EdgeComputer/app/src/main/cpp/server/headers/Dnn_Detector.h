@@ -0,0 +1,116 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_DNN_DETECTOR_H
+#define EDGECOMPUTER_DNN_DETECTOR_H
+
+#include "Detection.h"
+#include "Ingest_Frame.h"
+
+#include <opencv2/dnn.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct Dnn_Config {
+    std::string model;             // poids (.caffemodel, .onnx...)
+    std::string config;            // description (.prototxt), vide si inutile
+    int batch = 8;                 // frames max par forward
+    int window_ms = 20;            // attente max pour completer un lot
+    double fps = 5;                // analyses par seconde et par flux, au plus
+    int threads = 0;               // threads du backend CPU, 0 = tous les coeurs
+    // Entree de MobileNet-SSD (exemple mobilenet-objdetect du SDK)
+    int input_width = 300;
+    int input_height = 300;
+    double scale = 0.007843;       // 1 / 127.5
+    double mean = 127.5;
+    float threshold = 0.5f;        // confiance min d'une detection
+};
+
+struct Dnn_Stats {
+    uint64_t batches = 0;
+    uint64_t frames = 0;           // frames analysees
+    uint64_t replaced = 0;         // frames remplacees par une plus recente avant analyse
+    uint64_t failures = 0;         // JPEG illisibles
+    uint64_t decode_us = 0;
+    uint64_t infer_us = 0;
+};
+
+/**
+ * Detection d'objets cote serveur, par lots : pour chaque flux, seule la
+ * frame la plus recente attend l'analyse (reference partagee, pas de copie).
+ * Le thread d'analyse regroupe jusqu'a batch flux prets dans une fenetre de
+ * window_ms, decode chaque JPEG directement a la taille d'entree du reseau
+ * (IDCT reduite, voir Decode_Service), fait un seul forward sur le lot avec
+ * les threads du backend CPU d'OpenCV, puis rend a chaque flux ses
+ * detections (sortie DetectionOutput : colonne 0 = indice dans le lot).
+ *
+ * Un flux est analyse au plus fps fois par seconde : un serveur couvre plus
+ * de cameras en baissant fps, le cout fixe d'un forward etant partage par le
+ * lot. Si l'analyse ne suit pas, les frames en attente sont remplacees par
+ * les plus recentes ; l'ingestion n'attend jamais le reseau.
+ */
+class Dnn_Detector : public Frame_Sink {
+public:
+    explicit Dnn_Detector(const Dnn_Config &config);
+    ~Dnn_Detector() override;
+    Dnn_Detector(const Dnn_Detector &other) = delete;
+    Dnn_Detector &operator=(const Dnn_Detector &other) = delete;
+
+    // Resultats de chaque frame analysee, a fixer avant Start()
+    void AddSink(Detection_Sink *sink) { sinks_.push_back(sink); }
+    // Memes resultats en MSG_RESULTS (PublishResults, site serveur), pour l'enregistrement
+    void AddResultsSink(Frame_Sink *sink) { results_sinks_.push_back(sink); }
+
+    // Charge le reseau et lance le thread d'analyse
+    bool Start();
+    void Stop();
+
+    void Publish(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &frame) override;
+    void EndStream(uint32_t stream_id) override;
+
+    Dnn_Stats Stats();
+
+private:
+    struct Stream {
+        std::shared_ptr<const Ingest_Frame> pending;  // plus recente frame non analysee
+        uint64_t next_us = 0;                         // prochaine analyse permise
+    };
+
+    struct Job {
+        uint32_t stream_id;
+        std::shared_ptr<const Ingest_Frame> frame;
+    };
+
+    void analyzeLoop();
+    // Flux dont la frame peut partir maintenant ; earliest = prochaine echeance sinon
+    size_t readyCount(uint64_t now, uint64_t &earliest) const;
+    void runBatch(std::vector<Job> &jobs);
+    // Resultat d'une frame au format MSG_RESULTS : boites en pixels de la frame, texte = label
+    static std::shared_ptr<Ingest_Frame> encodeResults(const Ingest_Frame &frame,
+                                                       const Detection_Result &result);
+
+    Dnn_Config config_;
+    uint64_t period_us_;
+    cv::dnn::Net net_;
+    std::vector<Detection_Sink *> sinks_;
+    std::vector<Frame_Sink *> results_sinks_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::unordered_map<uint32_t, Stream> streams_;
+    bool stop_ = false;
+    std::thread thread_;
+
+    std::mutex stats_mutex_;
+    Dnn_Stats stats_;
+};
+
+#endif //EDGECOMPUTER_DNN_DETECTOR_H
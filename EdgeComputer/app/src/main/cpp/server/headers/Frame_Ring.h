@@ -0,0 +1,111 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_FRAME_RING_H
+#define EDGECOMPUTER_FRAME_RING_H
+
+#include "Ingest_Frame.h"
+#include "Shared_Stream.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Emplacements par anneau : assez pour que quelques lecteurs lents n'epinglent pas tout
+#define RING_SLOTS 8
+
+// Payload max par emplacement (au-dela, la frame n'est pas publiee dans l'anneau)
+#define RING_SLOT_BYTES (2u << 20)
+
+/**
+ * Ecrivain d'un anneau (Shared_Stream.h) : le worker proprietaire du flux,
+ * seul a y ecrire. L'anneau est un fichier /dev/shm : les pages ne sont
+ * allouees qu'a la premiere ecriture de chaque emplacement.
+ */
+class Frame_Ring_Writer {
+public:
+    Frame_Ring_Writer() = default;
+    ~Frame_Ring_Writer();
+    Frame_Ring_Writer(const Frame_Ring_Writer &other) = delete;
+    Frame_Ring_Writer &operator=(const Frame_Ring_Writer &other) = delete;
+
+    // Cree /dev/shm/<name> (un ancien fichier du meme nom est remplace)
+    bool Create(const std::string &name, uint32_t stream_id,
+                uint32_t slot_count = RING_SLOTS, uint32_t slot_bytes = RING_SLOT_BYTES);
+
+    // Copie la frame dans l'emplacement libre suivant. @return false si rejetee
+    bool Publish(const Ingest_Frame &frame);
+    // Un Frame_Ring_Reader au moins est ouvert (autre worker, Shm_Client)
+    bool HasReaders() const;
+
+    // Marque le flux termine et retire le nom ; les lecteurs gardent leur projection
+    void Close();
+
+private:
+    // Reveille les lecteurs endormis dans Wait(), s'il y en a
+    void notify();
+
+    std::string name_;
+    uint8_t *base_ = nullptr;
+    size_t bytes_ = 0;
+};
+
+/**
+ * Lecteur d'un anneau, dans n'importe quel processus. PinLatest() garde un
+ * emplacement intact tant que le Ring_Pin vit : ses octets peuvent partir
+ * tels quels sur une socket. La projection reste valide tant qu'un Ring_Pin
+ * la reference.
+ *
+ * Chemin rapide sans appel systeme : Published() et PinLatest() ne sont que
+ * des acces atomiques a la memoire partagee ; seul Wait() dort (futex) quand
+ * il n'y a rien de nouveau. Un pin doit rester bref : celui d'un processus
+ * mort bloque son emplacement jusqu'a la fin du flux.
+ */
+class Frame_Ring_Reader;
+
+struct Ring_Pin {
+    std::shared_ptr<const Frame_Ring_Reader> ring;
+    Ring_Slot *slot = nullptr;  // header (sequence, capture_ts_us...) et recv_us de la frame
+    const uint8_t *data = nullptr;
+    uint32_t length = 0;
+    uint64_t index = 0;       // numero de publication
+
+    ~Ring_Pin();
+};
+
+class Frame_Ring_Reader : public std::enable_shared_from_this<Frame_Ring_Reader> {
+public:
+    Frame_Ring_Reader() = default;
+    ~Frame_Ring_Reader();
+    Frame_Ring_Reader(const Frame_Ring_Reader &other) = delete;
+    Frame_Ring_Reader &operator=(const Frame_Ring_Reader &other) = delete;
+
+    // Projette /dev/shm/<name> (en ecriture : pins et readers sont partages).
+    // Compte comme lecteur jusqu'a la destruction : l'ecrivain publie tant qu'il y en a
+    bool Open(const std::string &name);
+
+    // Frames publiees depuis la creation de l'anneau
+    uint64_t Published() const;
+    bool Closed() const;
+
+    // Epingle la frame la plus recente. @return nullptr si rien de publie ou en cours de reecriture
+    std::shared_ptr<const Ring_Pin> PinLatest() const;
+
+    // Attend une publication au-dela de seen, ou la fin du flux.
+    // @param timeout_ms  -1 = sans limite. @return false si le delai expire
+    bool Wait(uint64_t seen, int timeout_ms) const;
+
+    uint32_t StreamId() const { return header()->stream_id; }
+
+private:
+    const Ring_Header *header() const { return (const Ring_Header *)base_; }
+    Ring_Slot *slot(uint32_t i) const {
+        return (Ring_Slot *)(base_ + RING_SLOTS_OFFSET + (size_t)i * header()->slot_stride);
+    }
+
+    uint8_t *base_ = nullptr;
+    size_t bytes_ = 0;
+};
+
+#endif //EDGECOMPUTER_FRAME_RING_H
@@ -0,0 +1,112 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_IMPAIR_RELAY_H
+#define EDGECOMPUTER_IMPAIR_RELAY_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Degradations appliquees par le relais, dans chaque sens
+struct Impairment {
+    int delay_ms = 0;         // latence ajoutee
+    int jitter_ms = 0;        // +- aleatoire sur la latence (l'ordre des octets est conserve)
+    int rate_kbps = 0;        // debit max par connexion et par sens, 0 = illimite
+    double loss = 0.0;        // proba de perte d'un paquet (0..1)
+    int loss_stall_ms = 200;  // attente supposee d'une retransmission apres une perte (-L)
+
+    bool Active() const { return delay_ms > 0 || jitter_ms > 0 || rate_kbps > 0 || loss > 0; }
+};
+
+/**
+ * Relais TCP local qui degrade le lien entre des clients et le serveur, a la
+ * place de netem (indisponible sans root ni sur les machines de test).
+ *
+ * Chaque connexion acceptee sur 127.0.0.1:Port() est reliee au serveur ; les
+ * octets sont retenus le temps de la latence, au rythme du debit max. TCP
+ * ne perd rien a ce niveau : une perte est vue comme le ferait l'application,
+ * un blocage de loss_stall_ms de tout le flux (head-of-line). C'est une
+ * hypothese : 200 ms par defaut correspond a un RTO complet ; une perte
+ * reparee par fast retransmit coute plutot un RTT. Les mesures TCP sous
+ * perte en dependent directement.
+ *
+ * Un seul thread, une boucle epoll ; la lecture d'un sens est suspendue si
+ * trop d'octets y sont retenus, le controle de flux TCP remonte alors
+ * jusqu'a l'emetteur.
+ */
+class Impair_Relay {
+public:
+    Impair_Relay(const std::string &host, int port, const Impairment &impairment);
+    ~Impair_Relay();
+    Impair_Relay(const Impair_Relay &other) = delete;
+    Impair_Relay &operator=(const Impair_Relay &other) = delete;
+
+    // Ecoute sur un port libre de 127.0.0.1 et lance le thread
+    bool Start();
+    void Stop();
+
+    // Port a donner aux clients
+    int Port() const { return listen_port_; }
+
+private:
+    struct Chunk {
+        std::vector<uint8_t> data;
+        size_t sent = 0;
+        uint64_t due_us = 0;  // pas avant (CLOCK_MONOTONIC)
+    };
+
+    // Un sens de la connexion : lu sur src, ecrit sur dst
+    struct Direction {
+        int src = -1;
+        int dst = -1;
+        std::deque<Chunk> chunks;
+        size_t queued = 0;
+        uint64_t last_due_us = 0;  // jamais avant le morceau precedent
+        uint64_t link_free_us = 0; // fin de l'emission du morceau precedent au debit max
+        bool blocked = false;      // dst plein : attendre EPOLLOUT
+        bool eof = false;          // src ferme : shutdown(dst) une fois vide
+        bool shut = false;
+    };
+
+    struct Link {
+        int client = -1;
+        int server = -1;
+        Direction up;    // client -> serveur
+        Direction down;  // serveur -> client
+    };
+
+    void loop();
+    void acceptAll();
+    // @return false si la connexion doit etre fermee
+    bool readSide(Link *link, Direction &dir);
+    bool writeSide(Direction &dir);
+    void updateEvents(Link *link);
+    // Prochaine echeance (0 = aucune)
+    uint64_t nextDue() const;
+    uint64_t dueFor(Direction &dir, size_t bytes);
+    void closeLink(Link *link);
+
+    std::string host_;
+    int port_;
+    Impairment impairment_;
+    size_t queue_limit_;  // octets retenus par sens avant de suspendre la lecture
+
+    int listen_fd_ = -1;
+    int listen_port_ = 0;
+    int epoll_fd_ = -1;
+    std::unordered_map<int, std::shared_ptr<Link>> links_;  // par fd, deux entrees par lien
+    std::mt19937 rng_{12345};
+
+    std::thread thread_;
+    std::atomic_bool stop_{false};
+};
+
+#endif //EDGECOMPUTER_IMPAIR_RELAY_H
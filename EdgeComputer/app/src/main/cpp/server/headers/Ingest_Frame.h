@@ -0,0 +1,43 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_INGEST_FRAME_H
+#define EDGECOMPUTER_INGEST_FRAME_H
+
+#include "Protocol.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Frame recue, immuable une fois publiee : partagee par reference, jamais copiee
+struct Ingest_Frame {
+    FrameHeaderV2 header;
+    std::vector<uint8_t> payload;
+    uint64_t recv_us;  // ProtoClockMicros() a la reception complete
+};
+
+// Destinataire des frames du serveur d'ingestion, appele depuis sa boucle
+class Frame_Sink {
+public:
+    virtual ~Frame_Sink() = default;
+
+    // Nouveau telephone connecte (peer = "ip:port")
+    virtual void BeginStream(uint32_t /*stream_id*/, const std::string & /*peer*/) {}
+    // Identite du telephone, cle de ses enregistrements : l'IP jusqu'au HELLO, puis
+    // son DeviceHello en hexadecimal s'il en envoie un (avant sa premiere frame)
+    virtual void IdentifyStream(uint32_t /*stream_id*/, const std::string & /*device*/) {}
+
+    // Nouvelle frame du flux stream_id
+    virtual void Publish(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &frame) = 0;
+    // Resultats d'analyse d'une frame du flux (header.type = MSG_RESULTS, payload valide
+    // pour ParseResults), recus du telephone ou produits par le serveur
+    virtual void PublishResults(uint32_t /*stream_id*/,
+                                const std::shared_ptr<const Ingest_Frame> & /*results*/) {}
+    // Le telephone s'est deconnecte
+    virtual void EndStream(uint32_t stream_id) = 0;
+};
+
+#endif //EDGECOMPUTER_INGEST_FRAME_H
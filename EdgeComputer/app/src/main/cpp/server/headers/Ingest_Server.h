@@ -0,0 +1,113 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_INGEST_SERVER_H
+#define EDGECOMPUTER_INGEST_SERVER_H
+
+#include "Ingest_Frame.h"
+#include "Mjpeg_Server.h"
+#include "Protocol.h"
+#include "Stream_Parser.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Ingest_Stats {
+    uint64_t frames = 0;
+    uint64_t repeats = 0;
+    uint64_t results = 0;     // MSG_RESULTS recus
+    uint64_t bytes = 0;       // octets lus sur les sockets
+    uint64_t errors = 0;      // flux invalides, checksums faux
+    uint64_t accepted = 0;    // connexions acceptees depuis le demarrage
+    uint32_t connections = 0; // connexions ouvertes
+};
+
+/**
+ * Serveur d'ingestion natif : une boucle epoll sur un seul thread, autant de
+ * telephones que de descripteurs. Chaque connexion a son Stream_Parser (v1 ou
+ * v2, detecte au premier octet comme server.py).
+ *
+ * Lecture en level-triggered avec un budget par reveil : une connexion tres
+ * rapide ne peut pas affamer les autres.
+ *
+ * Plusieurs workers (SetWorker) : un Ingest_Server par thread, tous sur le
+ * meme port (SO_REUSEPORT), le noyau repartit les telephones. Une connexion
+ * reste sur le worker qui l'a acceptee ; les numeros de flux sont entrelaces
+ * pour rester uniques.
+ */
+class Ingest_Server {
+public:
+    explicit Ingest_Server(int port, int report_sec = 5);
+    ~Ingest_Server();
+    Ingest_Server(const Ingest_Server &other) = delete;
+    Ingest_Server &operator=(const Ingest_Server &other) = delete;
+
+    // Redistribution MJPEG sur la meme boucle, a fixer avant Start()
+    void SetMjpeg(Mjpeg_Server *mjpeg) {
+        mjpeg_ = mjpeg;
+        AddSink(mjpeg);
+    }
+
+    // Recoit chaque frame et chaque fin de flux (appele depuis la boucle)
+    void AddSink(Frame_Sink *sink) { sinks_.push_back(sink); }
+
+    // Worker index parmi count, a fixer avant Start()
+    void SetWorker(int index, int count);
+
+    // bind + listen + epoll. @return false si le port n'est pas disponible
+    bool Start();
+
+    // Boucle d'evenements jusqu'a stop (verifie a chaque reveil, EINTR compris)
+    void Run(const std::atomic_bool &stop);
+    // Reveille Run() depuis un autre thread (pour qu'il voie stop)
+    void Wake();
+
+    const Ingest_Stats &Stats() const { return stats_; }
+
+private:
+    struct Connection {
+        int fd = -1;
+        uint32_t id = 0;  // numero de flux, /stream/<id> cote HTTP
+        std::string peer;
+        Stream_Parser parser;
+        bool v2 = false;
+        uint16_t width = 0;
+        uint16_t height = 0;
+        uint64_t frames = 0;
+        uint64_t repeats = 0;
+        std::shared_ptr<const Ingest_Frame> latest;
+    };
+
+    void acceptAll();
+    // @return false si la connexion doit etre fermee
+    bool readConnection(Connection *c);
+    bool handleMessage(Connection *c, const Parsed_Message &msg);
+    bool sendHelloAck(Connection *c, uint32_t client_caps);
+    void closeConnection(Connection *c);
+    void report();
+
+    int port_;
+    int report_sec_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+    uint32_t next_id_ = 1;
+    uint32_t id_stride_ = 1;  // nombre de workers
+    int worker_ = 0;
+    Mjpeg_Server *mjpeg_ = nullptr;
+    std::vector<Frame_Sink *> sinks_;
+
+    Ingest_Stats stats_;
+    Ingest_Stats last_stats_;
+    Mjpeg_Stats last_mjpeg_;
+    std::chrono::steady_clock::time_point last_report_;
+};
+
+#endif //EDGECOMPUTER_INGEST_SERVER_H
@@ -0,0 +1,224 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_MJPEG_SERVER_H
+#define EDGECOMPUTER_MJPEG_SERVER_H
+
+#include "Decode_Service.h"
+#include "Frame_Ring.h"
+#include "Ingest_Frame.h"
+#include "Playback_Session.h"
+#include "Recorder.h"
+#include "Stream_Directory.h"
+#include "Stream_Monitor.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct Mjpeg_Stats {
+    uint64_t parts = 0;    // frames envoyees en entier, tous clients confondus
+    uint64_t bytes = 0;
+    uint64_t skipped = 0;  // frames jamais parties, remplacees par une plus recente
+    uint64_t evicted = 0;  // clients coupes car trop lents
+    uint32_t viewers = 0;  // clients en cours de lecture
+};
+
+// Compteurs d'un client, exposes par GET /stats
+struct Viewer_Stats {
+    uint64_t parts = 0;
+    uint64_t bytes = 0;
+    uint64_t skipped = 0;
+    uint64_t stalls = 0;    // envois bloques (tampon noyau plein)
+    uint64_t stall_us = 0;  // temps cumule passe bloque
+};
+
+/**
+ * Redistribution HTTP multipart (MJPEG, lisible par VLC) dans la boucle epoll
+ * du serveur d'ingestion.
+ *
+ * GET /          : flux par defaut (le plus ancien telephone encore connecte)
+ * GET /stream/N  : flux du telephone N (numero affiche a sa connexion)
+ * GET /stats     : compteurs par client et par flux entrant (JSON)
+ * GET /frame?stream=N&seq=S&w=W&h=H&gray=1 : une frame decodee (PPM / PGM),
+ *                  tous les parametres optionnels ; voir Decode_Service
+ * GET /playback?device=IP|stream=N&from=T&to=T&speed=X : relecture MJPEG d'un
+ *                  enregistrement ; T en secondes Unix, negatif = relatif a maintenant
+ * GET /results?device=IP|stream=N&from=T&to=T : resultats d'analyse enregistres sur
+ *                  la periode, messages MSG_RESULTS bout a bout (FrameHeaderV2 + payload)
+ * GET /results?live=1&stream=N : memes messages au fil de l'eau, sans fin ; comme
+ *                  pour les frames, un abonne lent ne garde que le plus recent
+ *
+ * Chaque frame publiee devient une partie multipart immuable (en-tetes formates
+ * une fois), partagee par reference par tous les clients ; boundary + en-tetes
+ * + JPEG partent en un seul appel. Un client n'est reveille que par une
+ * nouvelle frame et ne recoit jamais deux fois la meme.
+ *
+ * Boite aux lettres par client : au plus la partie en cours d'envoi et une
+ * partie en attente. Un client lent saute des frames (l'attente est remplacee)
+ * au lieu d'accumuler memoire et retard, et ne ralentit jamais les autres.
+ * Un client qui met plus de evict_ms a envoyer une seule frame, ou a finir
+ * sa requete et recevoir les en-tetes, est coupe (verifie a chaque frame et
+ * par un timer).
+ *
+ * Avec plusieurs workers (SetDirectory), un client peut suivre un flux recu
+ * par un autre worker : ses parties pointent alors directement dans
+ * l'anneau partage du flux (emplacement epingle le temps de l'envoi).
+ */
+class Mjpeg_Server : public Frame_Sink {
+public:
+    // @param evict_ms  0 = jamais couper un client lent
+    explicit Mjpeg_Server(int port, int evict_ms = 10000);
+    ~Mjpeg_Server() override;
+    Mjpeg_Server(const Mjpeg_Server &other) = delete;
+    Mjpeg_Server &operator=(const Mjpeg_Server &other) = delete;
+
+    // Enregistre la socket d'ecoute sur l'epoll du serveur d'ingestion
+    bool Start(int epoll_fd);
+
+    // Active GET /frame
+    void SetDecoder(Decode_Service *decoder) { decoder_ = decoder; }
+    // Active GET /playback et GET /results
+    void SetRecorder(Recorder *recorder) { recorder_ = recorder; }
+    // Ajoute les flux entrants a GET /stats
+    void SetMonitor(const Stream_Monitor *monitor) { monitor_ = monitor; }
+    // Flux des autres workers, a fixer avant Start() ; ecoute partagee (SO_REUSEPORT)
+    void SetDirectory(Stream_Directory *directory, int worker) {
+        directory_ = directory;
+        worker_ = worker;
+    }
+
+    // @return false si fd n'appartient pas au serveur HTTP
+    bool HandleEvent(int fd, uint32_t events);
+
+    void BeginStream(uint32_t stream_id, const std::string &peer) override;
+    void IdentifyStream(uint32_t stream_id, const std::string &device) override;
+    // Seules les frames JPEG sont redistribuees
+    void Publish(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &frame) override;
+    // Appelable depuis n'importe quel thread (Dnn_Detector, autres workers) : remis a
+    // la boucle par un eventfd, ignore si personne ne suit les resultats en direct
+    void PublishResults(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &results) override;
+    void EndStream(uint32_t stream_id) override;
+
+    const Mjpeg_Stats &Stats() const { return stats_; }
+
+private:
+    // Une frame prete a envoyer : en-tete de partie + JPEG partage
+    struct Part {
+        std::string head;
+        const uint8_t *data = nullptr;
+        size_t length = 0;
+        std::shared_ptr<const void> hold;  // garde data valide (Ingest_Frame ou Ring_Pin)
+        bool trailer = true;               // fin de partie multipart (pas pour les resultats)
+        size_t size() const;
+    };
+
+    // Flux d'un autre worker suivi par des clients de celui-ci
+    struct Remote {
+        std::shared_ptr<Frame_Ring_Reader> ring;
+        int entry = -1;
+        uint64_t seen = 0;  // derniere publication transmise
+    };
+
+    struct Viewer {
+        int fd = -1;
+        std::string peer;
+        uint32_t stream_id = 0;   // 0 = flux par defaut
+        bool answered = false;    // requete HTTP lue et traitee
+        bool streaming = false;   // client MJPEG (pas /stats)
+        bool live_results = false;  // GET /results?live=1
+        std::string request;      // requete en cours de lecture
+        std::string response;     // en-tetes HTTP restant a envoyer
+        bool close_after = false; // fermer une fois response envoyee
+        std::shared_ptr<const Part> current;  // partie en cours d'envoi
+        size_t offset = 0;                    // octets de current deja envoyes
+        uint64_t current_since_us = 0;        // debut d'envoi de current
+        std::shared_ptr<const Part> pending;  // prochaine partie, remplacee si une plus recente arrive
+        std::unique_ptr<Playback_Session> playback;  // relecture au lieu du direct
+        bool want_write = false;  // EPOLLOUT arme
+        uint64_t stall_since_us = 0;
+        uint64_t accepted_us = 0;  // connexion acceptee
+        Viewer_Stats stats;
+    };
+
+    void acceptAll();
+    // @return false si le client doit etre ferme
+    bool readRequest(Viewer *v);
+    bool flush(Viewer *v);
+    void setWantWrite(Viewer *v, bool on);
+    void deliver(Viewer *v, const std::shared_ptr<const Part> &part);
+    // Client bloque depuis plus de evict_ms : frame en cours, requete ou en-tetes
+    bool stalled(const Viewer *v, uint64_t now) const;
+    void evict(Viewer *v);
+    // Appele par le timer de balayage, toutes les evict_ms / 2
+    void evictStalled();
+    void closeViewer(Viewer *v);
+    std::string statsJson() const;
+    // Reponse complete de GET /frame
+    std::string frameResponse(const std::string &query);
+    // Telephone et periode d'une requete sur les enregistrements. @return false si invalide
+    bool recordingRange(const std::string &query, std::string &device, uint64_t &from_us,
+                        uint64_t &to_us) const;
+    // Reponse complete de GET /results
+    std::string resultsResponse(const std::string &query);
+    // @return false si rien a relire
+    bool startPlayback(Viewer *v, const std::string &query);
+
+    // Flux suivi par un client
+    uint32_t resolve(uint32_t stream_id) const;
+
+    // orientation (FrameHeaderV2) : tag EXIF ajoute en tete, pixels intacts (Jpeg_Exif.h)
+    static std::shared_ptr<const Part> makePart(const uint8_t *data, size_t length,
+                                                uint8_t orientation,
+                                                std::shared_ptr<const void> hold);
+    void broadcast(uint32_t stream_id, const std::shared_ptr<const Part> &part);
+    // Resultats deposes par PublishResults, vers les abonnes de leur flux
+    void drainResults();
+
+    // Reveil de l'annuaire : flux ouverts / fermes, nouvelles frames des flux suivis
+    void onWake();
+    // Suit le flux s'il appartient a un autre worker
+    void follow(uint32_t stream_id);
+    void unfollow(uint32_t stream_id);
+    // Derniere frame de chaque flux suivi, si elle a change
+    void pollRemote();
+
+    int port_;
+    uint64_t evict_us_;
+    int epoll_fd_ = -1;
+    int listen_fd_ = -1;
+    int evict_timer_fd_ = -1;
+    std::unordered_map<int, std::unique_ptr<Viewer>> viewers_;
+
+    // Derniere partie de chaque flux, envoyee tout de suite a un nouveau client
+    std::unordered_map<uint32_t, std::shared_ptr<const Part>> latest_;
+    uint32_t default_stream_ = 0;
+    Decode_Service *decoder_ = nullptr;
+    Recorder *recorder_ = nullptr;
+    const Stream_Monitor *monitor_ = nullptr;
+    std::unordered_map<uint32_t, std::string> devices_;  // stream_id -> cle Recorder, pour /playback?stream=
+    std::unordered_map<int, int> timers_;                // timerfd de relecture -> fd du client
+
+    Stream_Directory *directory_ = nullptr;
+    int worker_ = 0;
+    int wake_fd_ = -1;
+    uint32_t generation_ = 0;
+    bool followed_dirty_ = false;  // un client est parti : flux suivis a revoir
+    std::unordered_map<uint32_t, Remote> remote_;
+
+    // Boite de depot de PublishResults, videe par la boucle au reveil de results_fd_
+    int results_fd_ = -1;
+    std::mutex results_mutex_;
+    std::vector<std::pair<uint32_t, std::shared_ptr<const Ingest_Frame>>> results_inbox_;
+    std::atomic<uint32_t> live_results_{0};  // abonnes a /results?live=1
+
+    Mjpeg_Stats stats_;
+};
+
+#endif //EDGECOMPUTER_MJPEG_SERVER_H
@@ -0,0 +1,90 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_PLAYBACK_SESSION_H
+#define EDGECOMPUTER_PLAYBACK_SESSION_H
+
+#include "Recording.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum pump_status {
+    PUMP_DONE,        // plus rien a envoyer (ou erreur) : fermer
+    PUMP_WAIT_WRITE,  // tampon d'envoi plein : attendre EPOLLOUT
+    PUMP_WAIT_TIMER,  // frame suivante pas encore due : attendre le timerfd
+};
+
+/**
+ * Relecture d'une plage d'enregistrement en MJPEG vers une socket.
+ *
+ * Les positions viennent des index projetes en memoire ; les JPEG partent du
+ * segment vers la socket par sendfile, sans passer par l'espace utilisateur.
+ * Le rythme suit les horodatages d'origine (capture si disponible, sinon
+ * reception), accelere ou ralenti par speed ; speed = 0 envoie au plus vite.
+ * Un trou d'enregistrement (telephone deconnecte) est ramene a MAX_GAP.
+ * Une frame en orientation capteur part avec son tag EXIF, lu dans le header
+ * qui la precede dans le segment.
+ */
+class Playback_Session {
+public:
+    Playback_Session(std::vector<Segment_Info> segments, uint64_t from_us, uint64_t to_us,
+                     double speed);
+    ~Playback_Session();
+    Playback_Session(const Playback_Session &other) = delete;
+    Playback_Session &operator=(const Playback_Session &other) = delete;
+
+    // Ouvre le premier segment et se place sur from_us. @return false si rien a relire
+    bool Open();
+
+    // Timer de cadence, a surveiller en lecture dans l'epoll
+    int TimerFd() const { return timer_fd_; }
+    void OnTimer();
+
+    pump_status Pump(int sock);
+
+    uint64_t FramesSent() const { return frames_sent_; }
+
+private:
+    enum send_phase { PHASE_IDLE, PHASE_HEAD, PHASE_BODY, PHASE_TAIL };
+
+    bool openSegment(size_t k);
+    void closeSegment();
+    // Entree suivante de la plage, en changeant de segment si besoin
+    bool nextEntry(Record_Index_Entry &entry);
+    // Entrees valides de l'index ouvert, bornees a sa capacite
+    uint32_t indexCount() const;
+    void schedule(const Record_Index_Entry &entry);
+    // Tag EXIF de l'entree (Jpeg_Exif.h) : octets de JPEG remplaces par prefix
+    size_t orientationPrefix(const Record_Index_Entry &entry, std::string &prefix);
+
+    std::vector<Segment_Info> segments_;
+    uint64_t from_us_;
+    uint64_t to_us_;
+    double speed_;
+
+    size_t segment_ = 0;             // segment courant dans segments_
+    int seg_fd_ = -1;
+    const Record_Index_Header *index_ = nullptr;
+    size_t index_bytes_ = 0;
+    uint32_t pos_ = 0;               // prochaine entree de l'index courant
+
+    int timer_fd_ = -1;
+    bool due_ = true;                // la frame suivante peut partir
+    bool started_ = false;
+    uint64_t start_mono_us_ = 0;     // depart de la relecture (CLOCK_MONOTONIC)
+    uint64_t media_us_ = 0;          // position dans l'enregistrement depuis le depart
+    Record_Index_Entry last_{};      // derniere frame envoyee
+
+    send_phase phase_ = PHASE_IDLE;
+    std::string head_;
+    size_t head_sent_ = 0;
+    off_t body_offset_ = 0;
+    size_t body_left_ = 0;
+    size_t tail_sent_ = 0;
+    uint64_t frames_sent_ = 0;
+};
+
+#endif //EDGECOMPUTER_PLAYBACK_SESSION_H
@@ -0,0 +1,129 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_RECORDER_H
+#define EDGECOMPUTER_RECORDER_H
+
+#include "Ingest_Frame.h"
+#include "Recording.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct Recorder_Config {
+    std::string dir;                       // racine des enregistrements
+    uint64_t segment_bytes = 64ull << 20;  // taille fixe d'un segment
+    uint64_t max_bytes = 0;                // budget disque total, 0 = illimite
+    uint64_t max_age_sec = 0;              // duree conservee, 0 = illimitee
+    size_t max_backlog = 64u << 20;        // octets en attente d'ecriture avant rejet
+};
+
+struct Recorder_Stats {
+    uint64_t frames = 0;     // frames ecrites
+    uint64_t results = 0;    // resultats d'analyse ecrits
+    uint64_t bytes = 0;
+    uint64_t dropped = 0;    // rejetees : disque trop lent (backlog plein)
+    uint64_t segments = 0;   // segments crees
+    uint64_t evicted = 0;    // segments supprimes par la retention
+};
+
+/**
+ * Enregistrement continu des flux JPEG, facon DVR : un dossier par telephone
+ * (son IP, stable d'une connexion a l'autre), des segments de taille fixe
+ * preallouee et un index projete en memoire (voir Recording.h).
+ *
+ * La boucle d'ingestion ne fait que mettre les frames en file (reference
+ * partagee, pas de copie) ; un thread d'ecriture les regroupe par segment et
+ * les ecrit en un pwritev par lot. Si le disque ne suit pas, les frames en
+ * trop sont rejetees : l'ingestion n'attend jamais le disque.
+ *
+ * Les resultats d'analyse (PublishResults) suivent le meme chemin : ecrits
+ * dans le segment de leur telephone, indexes a part dans le .rix.
+ *
+ * Retention par segment entier : les plus anciens sont supprimes au-dela du
+ * budget en octets ou en duree.
+ */
+class Recorder : public Frame_Sink {
+public:
+    explicit Recorder(const Recorder_Config &config);
+    ~Recorder() override;
+    Recorder(const Recorder &other) = delete;
+    Recorder &operator=(const Recorder &other) = delete;
+
+    // Cree le dossier, reprend les segments existants, lance le thread d'ecriture
+    bool Start();
+    // Ecrit ce qui reste en file puis arrete le thread
+    void Stop();
+
+    void BeginStream(uint32_t stream_id, const std::string &peer) override;
+    void IdentifyStream(uint32_t stream_id, const std::string &device) override;
+    void Publish(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &frame) override;
+    void PublishResults(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &results) override;
+    void EndStream(uint32_t stream_id) override;
+
+    // Segments d'un telephone qui recouvrent [from_us, to_us], par date croissante
+    std::vector<Segment_Info> Segments(const std::string &device, uint64_t from_us, uint64_t to_us);
+
+    Recorder_Stats Stats();
+
+private:
+    struct Pending {
+        std::string device;
+        std::shared_ptr<const Ingest_Frame> frame;
+    };
+
+    struct Open_Segment {
+        std::string path;                      // sans extension
+        int fd = -1;
+        Record_Index_Header *index = nullptr;    // mmap du .idx
+        Record_Index_Header *results = nullptr;  // mmap du .rix
+        size_t index_bytes = 0;                  // taille de chacun des deux
+        uint64_t used = 0;                     // octets ecrits dans le .seg
+    };
+
+    // Met en file une frame ou des resultats, sauf si le disque est en retard
+    void enqueue(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &frame);
+    void writerLoop();
+    void writeDevice(const std::string &device, std::vector<const Pending *> &frames);
+    // Segment courant du telephone, avec la place pour need octets
+    Open_Segment *segmentFor(const std::string &device, uint64_t need, uint64_t time_us);
+    bool openSegment(const std::string &device, Open_Segment &seg, uint64_t time_us);
+    void closeSegment(const std::string &device, Open_Segment &seg);
+    void enforceRetention();
+    void scanExisting();
+
+    Recorder_Config config_;
+    uint32_t index_capacity_;
+
+    // Boucles d'ingestion (une par worker)
+    std::mutex devices_mutex_;
+    std::unordered_map<uint32_t, std::string> devices_;  // stream_id -> telephone (IP ou DeviceHello)
+
+    // File vers le thread d'ecriture
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::vector<Pending> queue_;
+    size_t backlog_bytes_ = 0;
+    bool stop_ = false;
+    std::thread writer_;
+
+    // Thread d'ecriture uniquement
+    std::unordered_map<std::string, Open_Segment> open_;
+    uint64_t last_retention_us_ = 0;
+
+    // Catalogue des segments, lu par la relecture
+    std::mutex segments_mutex_;
+    std::map<std::string, std::vector<Segment_Info>> segments_;  // par telephone, date croissante
+
+    std::mutex stats_mutex_;
+    Recorder_Stats stats_;
+};
+
+#endif //EDGECOMPUTER_RECORDER_H
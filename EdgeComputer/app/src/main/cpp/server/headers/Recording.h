@@ -0,0 +1,72 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_RECORDING_H
+#define EDGECOMPUTER_RECORDING_H
+
+// Format des enregistrements sur disque, partage entre Recorder (ecriture)
+// et la relecture.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * <dossier>/<ip du telephone>/<debut en µs>.seg : segment de taille fixe,
+ * preallouee (fallocate). Suite de FrameHeaderV2 + payload JPEG, tels que recus.
+ *
+ * <dossier>/<ip du telephone>/<debut en µs>.idx : index du segment, projete en
+ * memoire (mmap). Record_Index_Header puis capacity entrees, dont count
+ * valides. Une entree n'est ajoutee qu'une fois ses octets ecrits dans le
+ * segment : un lecteur peut suivre un segment en cours d'ecriture.
+ *
+ * <dossier>/<ip du telephone>/<debut en µs>.rix : index des resultats
+ * d'analyse (MSG_RESULTS) ecrits dans le meme segment, entre les frames, au
+ * meme format (magic RECORD_RESULTS_MAGIC). sequence et capture_us designent
+ * la frame decrite ; offset / length le payload, lisible tel quel par
+ * ParseResults. La relecture des frames ne lit que le .idx.
+ */
+#define RECORD_INDEX_MAGIC 0x58444945u    // "EIDX" en little-endian
+#define RECORD_RESULTS_MAGIC 0x58495245u  // "ERIX" en little-endian
+#define RECORD_INDEX_VERSION 1
+
+#pragma pack(push, 1)
+struct Record_Index_Header {
+    uint32_t magic;           // RECORD_INDEX_MAGIC
+    uint32_t version;         // RECORD_INDEX_VERSION
+    uint32_t capacity;        // entrees allouees
+    uint32_t count;           // entrees valides (ecriture release, lecture acquire)
+    uint64_t segment_bytes;   // taille du .seg
+    uint64_t first_us;        // horodatage de la premiere entree
+    uint64_t last_us;         // horodatage de la derniere entree
+};
+
+struct Record_Index_Entry {
+    uint64_t time_us;         // reception, horloge murale (CLOCK_REALTIME)
+    uint64_t capture_us;      // capture_ts_us du header (horloge device), 0 en v1
+    uint64_t offset;          // position du payload (JPEG ou resultats) dans le .seg
+    uint32_t length;          // taille du payload
+    uint32_t sequence;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(Record_Index_Header) == 40, "Record_Index_Header doit rester fixe sur disque");
+static_assert(sizeof(Record_Index_Entry) == 32, "Record_Index_Entry doit rester fixe sur disque");
+
+// Taille du fichier .idx pour capacity entrees
+inline size_t RecordIndexBytes(uint32_t capacity) {
+    return sizeof(Record_Index_Header) + (size_t)capacity * sizeof(Record_Index_Entry);
+}
+
+// Un segment termine ou en cours d'ecriture
+struct Segment_Info {
+    std::string device;
+    std::string path;         // sans extension
+    uint64_t first_us;
+    uint64_t last_us;
+    uint64_t bytes;           // .seg + .idx + .rix sur disque
+    bool open;                // en cours d'ecriture
+};
+
+#endif //EDGECOMPUTER_RECORDING_H
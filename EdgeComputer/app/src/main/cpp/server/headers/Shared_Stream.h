@@ -0,0 +1,120 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_SHARED_STREAM_H
+#define EDGECOMPUTER_SHARED_STREAM_H
+
+// Format des flux publies en memoire partagee, entre les workers d'ingestion
+// (Stream_Directory, Frame_Ring) et les lecteurs d'autres processus.
+
+#include "Protocol.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * /dev/shm/edge_ingest.<port> : annuaire des flux. Directory_Header puis
+ * capacity entrees. Une entree est ACTIVE entre le BeginStream et
+ * l'EndStream de son worker ; generation change a chaque ouverture ou
+ * fermeture de flux.
+ *
+ * /dev/shm/edge_ingest.<port>.<stream_id> : anneau des dernieres frames du
+ * flux. Ring_Header puis slot_count emplacements de slot_stride octets
+ * (Ring_Slot + payload). latest designe l'emplacement le plus recent.
+ *
+ * Emplacement : seqlock. seq impair = en cours d'ecriture ; un lecteur lit
+ * seq, les donnees, puis seq a nouveau, et recommence s'ils different. Un
+ * lecteur qui envoie directement depuis l'emplacement (sans copie)
+ * l'epingle (pins) : l'ecrivain passe alors a l'emplacement suivant.
+ *
+ * notify est un futex (partage entre processus) incremente a chaque
+ * publication et a la fermeture ; l'ecrivain ne fait l'appel systeme
+ * FUTEX_WAKE que si waiters > 0.
+ *
+ * Champs partages lus et ecrits avec les __atomic (comme count dans Recording.h).
+ */
+#define STREAM_DIRECTORY_MAGIC 0x52494445u  // "EDIR" en little-endian
+#define FRAME_RING_MAGIC 0x474E5245u        // "ERNG" en little-endian
+#define SHARED_STREAM_VERSION 3
+
+#define DIRECTORY_CAPACITY 256
+#define MAX_WORKERS 64  // un bit par worker dans Directory_Entry::watchers
+
+enum directory_state {
+    ENTRY_FREE = 0,
+    ENTRY_CLAIMED = 1,  // en cours de remplissage
+    ENTRY_ACTIVE = 2,
+};
+
+#pragma pack(push, 1)
+struct Directory_Header {
+    uint32_t magic;           // STREAM_DIRECTORY_MAGIC
+    uint32_t version;         // SHARED_STREAM_VERSION
+    uint32_t capacity;        // entrees
+    uint32_t workers;
+    uint32_t generation;      // incremente a chaque ouverture / fermeture de flux
+    uint32_t reserved;
+};
+
+struct Directory_Entry {
+    uint32_t state;           // directory_state
+    uint32_t stream_id;
+    uint32_t worker;          // worker proprietaire (seul ecrivain de l'anneau)
+    uint32_t reserved;
+    uint64_t started_us;      // ProtoClockMicros() a l'ouverture : le plus ancien = flux par defaut
+    uint64_t watchers;        // bit w : le worker w a des clients sur ce flux, a reveiller
+    char peer[48];            // "ip:port" du telephone
+    char ring[64];            // nom shm de l'anneau
+    char device[48];          // cle des enregistrements (Frame_Sink::IdentifyStream)
+};
+
+struct Ring_Header {
+    uint32_t magic;           // FRAME_RING_MAGIC
+    uint32_t version;         // SHARED_STREAM_VERSION
+    uint32_t stream_id;
+    uint32_t slot_count;
+    uint32_t slot_bytes;      // payload max par emplacement
+    uint32_t slot_stride;     // taille d'un emplacement (Ring_Slot + payload, aligne)
+    uint64_t published;       // frames publiees (ecriture release)
+    uint32_t latest;          // emplacement le plus recent, valide si published > 0
+    uint32_t closed;          // 1 : le flux est termine, plus rien ne sera publie
+    uint64_t dropped;         // frames non publiees (trop grandes, tout epingle)
+    uint32_t notify;          // futex, change a chaque publication
+    uint32_t waiters;         // lecteurs endormis sur notify
+    uint32_t readers;         // Frame_Ring_Reader ouverts : a 0, l'ecrivain ne copie rien
+    uint32_t reserved;
+};
+
+struct Ring_Slot {
+    uint32_t seq;             // seqlock, impair pendant l'ecriture
+    uint32_t pins;            // lecteurs qui envoient depuis l'emplacement
+    uint64_t index;           // numero de publication (published au moment de l'ecriture)
+    uint64_t recv_us;
+    FrameHeaderV2 header;     // tel que recu (sequence, capture_ts_us, codec, taille)
+    uint32_t length;          // octets de payload
+    uint32_t reserved;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(Directory_Header) == 24, "Directory_Header doit rester fixe");
+static_assert(sizeof(Directory_Entry) == 192, "Directory_Entry doit rester fixe");
+static_assert(sizeof(Ring_Header) == 64, "Ring_Header doit rester fixe");
+static_assert(sizeof(Ring_Slot) == 68, "Ring_Slot doit rester fixe");
+
+// Debut des emplacements : aligne sur 64 (ligne de cache)
+#define RING_SLOTS_OFFSET 64u
+
+inline size_t DirectoryBytes(uint32_t capacity) {
+    return sizeof(Directory_Header) + (size_t)capacity * sizeof(Directory_Entry);
+}
+
+inline uint32_t RingSlotStride(uint32_t slot_bytes) {
+    return (uint32_t)((sizeof(Ring_Slot) + slot_bytes + 63u) & ~(size_t)63u);
+}
+
+inline size_t RingBytes(uint32_t slot_count, uint32_t slot_bytes) {
+    return RING_SLOTS_OFFSET + (size_t)slot_count * RingSlotStride(slot_bytes);
+}
+
+#endif //EDGECOMPUTER_SHARED_STREAM_H
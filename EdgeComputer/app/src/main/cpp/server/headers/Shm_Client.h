@@ -0,0 +1,74 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_SHM_CLIENT_H
+#define EDGECOMPUTER_SHM_CLIENT_H
+
+#include "Decode_Service.h"
+#include "Frame_Ring.h"
+#include "Shared_Stream.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Flux publie par edge_ingest, tel que lu dans l'annuaire
+struct Shared_Stream_Info {
+    uint32_t stream_id;
+    uint32_t worker;
+    uint64_t started_us;
+    std::string peer;  // "ip:port" du telephone
+    std::string ring;  // nom shm de l'anneau
+};
+
+/**
+ * Bibliotheque cliente des flux publies en memoire partagee par edge_ingest
+ * (-a ou -w), pour les traitements qui tournent sur la meme machine : pas de
+ * MJPEG a relire sur HTTP ni de JPEG a recopier.
+ *
+ *   Shm_Client client(9999);
+ *   client.Open();
+ *   auto ring = client.Attach();              // flux par defaut
+ *   uint64_t seen = 0;
+ *   while (ring->Wait(seen, 1000) && !ring->Closed()) {
+ *       auto pin = ring->PinLatest();         // JPEG dans la memoire partagee
+ *       if (!pin) continue;
+ *       seen = pin->index;
+ *       Shm_Client::Decode(*pin, req, image); // ou pin->data / pin->length tels quels
+ *   }
+ *
+ * Seul Wait() fait un appel systeme, et seulement s'il n'y a rien de nouveau.
+ * Les anneaux ne gardent que les dernieres frames : un lecteur lent saute
+ * des frames (ecart entre deux pin->index), il ne ralentit jamais le serveur.
+ */
+class Shm_Client {
+public:
+    explicit Shm_Client(int port = 9999);
+    ~Shm_Client();
+    Shm_Client(const Shm_Client &other) = delete;
+    Shm_Client &operator=(const Shm_Client &other) = delete;
+
+    // Projette l'annuaire de edge_ingest. @return false s'il ne publie rien sur ce port
+    bool Open();
+
+    // Flux actifs, par numero croissant (le premier est le flux par defaut)
+    std::vector<Shared_Stream_Info> Streams() const;
+    // Change a chaque ouverture ou fermeture de flux : Streams() a relire
+    uint32_t Generation() const;
+
+    // Projette l'anneau d'un flux (0 = flux par defaut). @return nullptr si inconnu
+    std::shared_ptr<Frame_Ring_Reader> Attach(uint32_t stream_id = 0) const;
+
+    // Decode la frame epinglee directement depuis la memoire partagee (IDCT reduite, voir
+    // Decode_Service). out.pixels est reutilise d'un appel a l'autre
+    static bool Decode(const Ring_Pin &pin, const Decode_Request &req, Decoded_Image &out);
+
+private:
+    std::string name_;
+    const uint8_t *base_ = nullptr;
+    size_t bytes_ = 0;
+};
+
+#endif //EDGECOMPUTER_SHM_CLIENT_H
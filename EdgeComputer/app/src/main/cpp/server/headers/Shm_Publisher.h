@@ -0,0 +1,42 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_SHM_PUBLISHER_H
+#define EDGECOMPUTER_SHM_PUBLISHER_H
+
+#include "Frame_Ring.h"
+#include "Ingest_Frame.h"
+#include "Stream_Directory.h"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+/**
+ * Publie les flux d'un worker dans l'annuaire partage : un anneau par flux,
+ * une copie par frame, puis reveil des workers qui le suivent. Appele depuis
+ * la boucle du worker proprietaire uniquement.
+ */
+class Shm_Publisher : public Frame_Sink {
+public:
+    Shm_Publisher(Stream_Directory *directory, int worker)
+            : directory_(directory), worker_(worker) {}
+
+    void BeginStream(uint32_t stream_id, const std::string &peer) override;
+    void IdentifyStream(uint32_t stream_id, const std::string &device) override;
+    void Publish(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &frame) override;
+    void EndStream(uint32_t stream_id) override;
+
+private:
+    struct Stream {
+        Frame_Ring_Writer ring;
+        int entry = -1;
+    };
+
+    Stream_Directory *directory_;
+    int worker_;
+    std::unordered_map<uint32_t, std::unique_ptr<Stream>> streams_;
+};
+
+#endif //EDGECOMPUTER_SHM_PUBLISHER_H
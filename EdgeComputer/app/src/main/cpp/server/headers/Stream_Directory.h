@@ -0,0 +1,78 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_STREAM_DIRECTORY_H
+#define EDGECOMPUTER_STREAM_DIRECTORY_H
+
+#include "Shared_Stream.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Annuaire des flux en memoire partagee (Shared_Stream.h), commun aux
+ * workers d'ingestion. Chaque flux appartient au worker qui a accepte sa
+ * connexion ; les autres le suivent par son anneau.
+ *
+ * Un eventfd par worker : le proprietaire d'un flux reveille les workers
+ * inscrits dans watchers a chaque frame, et tous les workers a chaque
+ * ouverture ou fermeture de flux (flux par defaut, clients a rattacher).
+ *
+ * Thread-safe : les entrees sont reservees par compare-and-swap.
+ */
+class Stream_Directory {
+public:
+    Stream_Directory(int port, int workers);
+    ~Stream_Directory();
+    Stream_Directory(const Stream_Directory &other) = delete;
+    Stream_Directory &operator=(const Stream_Directory &other) = delete;
+
+    // Cree /dev/shm/edge_ingest.<port> et les eventfd des workers
+    bool Create();
+
+    int Workers() const { return workers_; }
+    // eventfd du worker, a surveiller dans sa boucle (EPOLLIN)
+    int WakeFd(int worker) const { return wake_fds_[worker]; }
+    // Remet a zero l'eventfd apres un reveil
+    void Drain(int worker) const;
+
+    // Nom shm de l'anneau d'un flux
+    std::string RingName(uint32_t stream_id) const;
+
+    // Cote proprietaire. @return l'entree, -1 si l'annuaire est plein
+    int Add(uint32_t stream_id, int worker, const std::string &peer);
+    // Remplace l'IP comme cle des enregistrements du flux
+    void SetDevice(int entry, const std::string &device);
+    void Remove(int entry);
+    // Nouvelle frame : reveille les workers qui suivent le flux
+    void Notify(int entry) const;
+
+    // Cote lecteur. @return l'entree active du flux, -1 si inconnu
+    int Find(uint32_t stream_id) const;
+    uint32_t Owner(int entry) const;
+    std::string Peer(int entry) const;
+    std::string Device(int entry) const;
+    void Watch(int entry, int worker, bool on);
+
+    // Flux actif de plus petit numero (le plus ancien), 0 s'il n'y en a aucun
+    uint32_t DefaultStream() const;
+    uint32_t Generation() const;
+
+private:
+    Directory_Header *header() const { return (Directory_Header *)base_; }
+    Directory_Entry *entry(int i) const {
+        return (Directory_Entry *)(base_ + sizeof(Directory_Header)) + i;
+    }
+    void wakeAll() const;
+    void wake(int worker) const;
+
+    std::string name_;
+    int workers_;
+    uint8_t *base_ = nullptr;
+    size_t bytes_ = 0;
+    std::vector<int> wake_fds_;
+};
+
+#endif //EDGECOMPUTER_STREAM_DIRECTORY_H
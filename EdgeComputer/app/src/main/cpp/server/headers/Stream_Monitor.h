@@ -0,0 +1,85 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_STREAM_MONITOR_H
+#define EDGECOMPUTER_STREAM_MONITOR_H
+
+#include "Detection.h"
+#include "Ingest_Frame.h"
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Seaux de latence en ms, les memes que server.py : <= chaque borne, puis au-dela
+#define LATENCY_BUCKETS 12
+static const double LATENCY_BOUNDS_MS[LATENCY_BUCKETS - 1] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000};
+
+// Ecart capture -> reception au-dela duquel les horloges ne sont pas comparables
+#define MAX_PLAUSIBLE_LATENCY_US 60000000u
+
+struct Latency_Histogram {
+    uint64_t counts[LATENCY_BUCKETS] = {0};
+    uint64_t total = 0;
+    double sum_ms = 0.0;
+
+    void Add(double ms);
+    // {"count": .., "mean_ms": .., "buckets_ms": {..}}, comme server.py
+    std::string Json() const;
+};
+
+/**
+ * Compteurs par flux entrant, exposes dans GET /stats au meme format que
+ * server.py : le generateur de charge (edge_fleet) lit l'un ou l'autre.
+ *
+ * La latence capture -> reception n'est mesuree que si l'horloge du device
+ * est comparable a celle du serveur (meme machine, CLOCK_BOOTTIME) : sans
+ * synchro d'horloge, un vrai telephone donne un ecart sans signification,
+ * qui est ecarte.
+ *
+ * Distribution de la nettete des frames recues (FrameHeaderV2::sharpness),
+ * pour les telephones qui la mesurent.
+ *
+ * Recoit aussi les resultats de Dnn_Detector : nombre de frames analysees,
+ * latence capture -> resultat et dernieres detections du flux ; et les
+ * MSG_RESULTS du telephone : nombre recu et dernier resultat decode.
+ *
+ * Partage par les workers d'ingestion : thread-safe.
+ */
+class Stream_Monitor : public Frame_Sink, public Detection_Sink {
+public:
+    void BeginStream(uint32_t stream_id, const std::string &peer) override;
+    void Publish(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &frame) override;
+    void PublishResults(uint32_t stream_id, const std::shared_ptr<const Ingest_Frame> &results) override;
+    void EndStream(uint32_t stream_id) override;
+    void OnDetections(const Detection_Result &result) override;
+
+    // {"<ip:port>": {"frames": .., "bytes": .., "orientation": .., "capture_to_receive": {..}}, ..}
+    // plus "sharpness" si le telephone la mesure, "detections" pour un flux analyse et
+    // "results" pour un flux qui envoie les siens
+    std::string Json() const;
+
+private:
+    struct Stream {
+        std::string peer;
+        uint64_t frames = 0;
+        uint64_t bytes = 0;
+        uint8_t orientation = 0;       // de la derniere frame (OrientationByte)
+        Latency_Histogram latency;
+        uint64_t sharpness[SHARPNESS_BUCKETS] = {0};
+        uint64_t sharpness_count = 0;
+        uint64_t sharpness_sum = 0;    // somme des octets
+        uint64_t analysed = 0;
+        Latency_Histogram result_latency;
+        Detection_Result last;
+        uint64_t results = 0;
+        std::shared_ptr<const Ingest_Frame> last_results;  // reference, decode par Json()
+    };
+
+    mutable std::mutex mutex_;
+    std::map<uint32_t, Stream> streams_;
+};
+
+#endif //EDGECOMPUTER_STREAM_MONITOR_H
@@ -0,0 +1,54 @@
+//
+// Created by girard on 18/02/2026.
+//
+
+#ifndef EDGECOMPUTER_STREAM_PARSER_H
+#define EDGECOMPUTER_STREAM_PARSER_H
+
+#include "Protocol.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Un message decoupe dans le buffer de reception (valide jusqu'au prochain WriteSpace())
+struct Parsed_Message {
+    FrameHeaderV2 header;     // v1 : rempli a partir du type / des dims / de la taille
+    const uint8_t *payload;   // pointe dans le buffer de reception, nullptr si vide
+    bool legacy;              // message v1
+    bool checksum_ok;         // false si FLAG_CHECKSUM et CRC32 faux
+};
+
+/**
+ * Decoupe incremental d'un flux TCP entrant (protocole v1 ou v2) sur un seul
+ * grand buffer par connexion : recv() ecrit directement a la suite des octets
+ * en attente, les messages complets sont rendus sans copie, et la partie
+ * consommee n'est recuperee que quand la place manque pour le recv() suivant.
+ */
+class Stream_Parser {
+public:
+    explicit Stream_Parser(size_t initial_capacity = 1u << 20);
+
+    // Zone libre ou recv() peut ecrire. Le buffer grandit si un message
+    // annonce ne tient pas dedans.
+    uint8_t *WritePtr();
+    size_t WriteSpace();
+    void Commit(size_t n);
+
+    // @return 1 si un message est extrait, 0 s'il manque des octets, -1 si le flux est invalide
+    int Next(Parsed_Message &out);
+
+    size_t Buffered() const { return end_ - begin_; }
+
+private:
+    // Recupere la place des messages deja rendus
+    void compact();
+
+    // Octets necessaires pour le message en tete, 0 si encore inconnu
+    size_t need_ = 0;
+    std::vector<uint8_t> buf_;
+    size_t begin_ = 0;  // premier octet non consomme
+    size_t end_ = 0;    // fin des octets recus
+};
+
+#endif //EDGECOMPUTER_STREAM_PARSER_H
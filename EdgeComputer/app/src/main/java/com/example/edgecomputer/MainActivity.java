@@ -1,13 +1,20 @@
 package com.example.edgecomputer;
 
 import android.Manifest;
+import android.content.BroadcastReceiver;
 import android.content.Context;
+import android.content.Intent;
+import android.content.IntentFilter;
 import android.content.pm.PackageManager;
 import android.content.res.AssetManager;
 import android.hardware.camera2.CameraAccessException;
 import android.hardware.camera2.CameraCharacteristics;
 import android.hardware.camera2.CameraManager;
+import android.os.BatteryManager;
+import android.os.Build;
 import android.os.Bundle;
+import android.os.PowerManager;
+import android.provider.Settings;
 import android.util.Log;
 import android.view.Surface;
 import android.view.SurfaceHolder;
@@ -39,11 +46,33 @@ public class MainActivity extends AppCompatActivity {
     private boolean cameraRunning = false;
     private SurfaceHolder surfaceHolder;
 
+    // Etat d'alimentation transmis au natif (choix du cote de l'analyse)
+    private int batteryPct = 100;
+    private boolean charging = true;
+    private int thermalStatus = 0;
+    private PowerManager.OnThermalStatusChangedListener thermalListener;
+
+    private final BroadcastReceiver batteryReceiver = new BroadcastReceiver() {
+        @Override
+        public void onReceive(Context context, Intent intent) {
+            int level = intent.getIntExtra(BatteryManager.EXTRA_LEVEL, -1);
+            int scale = intent.getIntExtra(BatteryManager.EXTRA_SCALE, -1);
+            int plugged = intent.getIntExtra(BatteryManager.EXTRA_PLUGGED, 0);
+            if (level >= 0 && scale > 0) {
+                batteryPct = level * 100 / scale;
+            }
+            charging = plugged != 0;
+            setPowerState(batteryPct, charging, thermalStatus);
+        }
+    };
+
     // Méthodes natives
     public native void scan();
     public native void flipCamera();
     public native void setSurface(Surface surface);
     public native void release();
+    public native void setPowerState(int batteryPct, boolean charging, int thermalStatus);
+    public native void setDeviceId(long deviceId);
 
     @Override
     protected void onCreate(Bundle savedInstanceState) {
@@ -79,6 +108,8 @@ public class MainActivity extends AppCompatActivity {
      * Elle configure le code natif, le SurfaceView, les listeners des boutons et affiche quelques infos sur la caméra.
      */
     private void initNativeComponents() {
+        setDeviceId(deviceId());
+
         // Configuration du SurfaceView et de son callback
         SurfaceView surfaceView = binding.surfaceView;
         surfaceHolder = surfaceView.getHolder();
@@ -160,6 +191,49 @@ public class MainActivity extends AppCompatActivity {
         }
     }
 
+    /**
+     * Suit la batterie et, à partir d'Android 10, le statut thermique : le natif
+     * décide avec eux si l'analyse tourne sur le téléphone ou sur le serveur.
+     */
+    @Override
+    protected void onResume() {
+        super.onResume();
+        // Intent "sticky" : l'état courant arrive tout de suite
+        registerReceiver(batteryReceiver, new IntentFilter(Intent.ACTION_BATTERY_CHANGED));
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.Q) {
+            PowerManager power = (PowerManager) getSystemService(Context.POWER_SERVICE);
+            thermalListener = status -> {
+                thermalStatus = status;
+                setPowerState(batteryPct, charging, thermalStatus);
+            };
+            power.addThermalStatusListener(thermalListener);
+        }
+    }
+
+    @Override
+    protected void onPause() {
+        unregisterReceiver(batteryReceiver);
+        if (thermalListener != null && Build.VERSION.SDK_INT >= Build.VERSION_CODES.Q) {
+            PowerManager power = (PowerManager) getSystemService(Context.POWER_SERVICE);
+            power.removeThermalStatusListener(thermalListener);
+            thermalListener = null;
+        }
+        super.onPause();
+    }
+
+    /**
+     * ANDROID_ID (64 bits en hexadécimal, stable pour l'application sur ce
+     * téléphone) ; 0 s'il est indisponible : le serveur range alors par IP.
+     */
+    private long deviceId() {
+        String id = Settings.Secure.getString(getContentResolver(), Settings.Secure.ANDROID_ID);
+        try {
+            return id != null ? Long.parseUnsignedLong(id, 16) : 0;
+        } catch (NumberFormatException e) {
+            return 0;
+        }
+    }
+
     /**
      * Vérifie que toutes les permissions spécifiées sont accordées.
      */
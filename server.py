@@ -1,19 +1,32 @@
+import bisect
+import json
 import socket
 import struct
 import threading
 import time
+import zlib
+from collections import deque
+from urllib.parse import urlparse, parse_qs
 
 import cv2
 import numpy as np
-from http.server import HTTPServer, BaseHTTPRequestHandler
+from http.server import ThreadingHTTPServer, BaseHTTPRequestHandler
 
 TCP_PORT = 9999
 HTTP_PORT = 8080
 
-_latest_frame = None
+_latest_frame = None  # LazyFrame : decodee seulement si un consommateur la demande
 _latest_jpeg = None
+_latest_meta = None  # (StreamState, capture en µs horloge serveur ou None)
 _frame_lock = threading.Lock()
 
+# Devices connectes en TCP, pilotables par /control : addr -> StreamState
+_devices = {}
+_devices_lock = threading.Lock()
+
+# Sources UDP (sans canal de retour, donc hors /control) : addr -> StreamState, pour /stats
+_udp_sources = {}
+
 
 def recv_exact(sock, n):
     """Lit exactement n octets depuis la socket."""
@@ -27,62 +40,902 @@ def recv_exact(sock, n):
 
 
 def tcp_receiver():
-    global _latest_frame, _latest_jpeg
-
     srv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
     srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
     srv.bind(("0.0.0.0", TCP_PORT))
-    srv.listen(1)
+    srv.listen(16)
     print(f"[TCP] En attente de connexion sur le port {TCP_PORT} ...")
 
+    # Un thread par connexion : un flux strie ouvre plusieurs connexions a la fois
     while True:
         conn, addr = srv.accept()
-        print(f"[TCP] Connexion de {addr}")
-        try:
-            handle_client(conn)
-        except ConnectionError as e:
-            print(f"[TCP] Deconnexion : {e}")
-        except Exception as e:
-            print(f"[TCP] Erreur : {e}")
-        finally:
-            conn.close()
-            print(f"[TCP] Connexion fermee, en attente d'une nouvelle ...")
+        threading.Thread(target=client_thread, args=(conn, addr), daemon=True).start()
+
 
+def client_thread(conn, addr):
+    print(f"[TCP] Connexion de {addr}")
+    try:
+        handle_client(conn, addr)
+    except ConnectionError as e:
+        print(f"[TCP] Deconnexion : {e}")
+    except Exception as e:
+        print(f"[TCP] Erreur : {e}")
+    finally:
+        conn.close()
+        print(f"[TCP] Connexion {addr} fermee")
 
-def handle_client(conn):
-    global _latest_frame, _latest_jpeg
-    frame_count = 0
 
-    while True:
-        type_byte = recv_exact(conn, 1)
-        msg_type = type_byte[0]
+# Protocole v2 : header fixe de 36 octets (little-endian), voir Protocol.h
+PROTO_MAGIC = 0x32474445  # "EDG2"
+PROTO_VERSION = 2
+HEADER_V2 = struct.Struct("<IBBHIQHHBBBxII")
+PROTO_MAX_PAYLOAD = 16 * 1024 * 1024  # comme Protocol.h : au-dela, le flux est corrompu
+V2_FIRST_BYTE = PROTO_MAGIC & 0xFF  # 'E', jamais un type v1
 
-        if msg_type == 1:
-            data = recv_exact(conn, 8)
-            width, height = struct.unpack("<ii", data)
-            print(f"[TCP] Dimensions recues : {width} x {height}")
+MSG_DIMS = 1
+MSG_JPEG = 2
+MSG_REPEAT = 3
+MSG_HELLO = 16
+MSG_HELLO_ACK = 17
+MSG_CONTROL = 20
+MSG_PING = 21
+MSG_PONG = 22
+MSG_RESULTS = 23
 
-        elif msg_type == 2:
-            data = recv_exact(conn, 4)
-            size = struct.unpack("<i", data)[0]
-            jpeg_data = recv_exact(conn, size)
-            frame_count += 1
+FLAG_CHECKSUM = 1 << 1
+FLAG_ANALYZE = 1 << 2
 
-            # Decoder le JPEG en cv2 Mat (BGR)
-            arr = np.frombuffer(jpeg_data, dtype=np.uint8)
-            frame = cv2.imdecode(arr, cv2.IMREAD_COLOR)
+CAP_CHECKSUM = 1 << 0
+CAP_REPEAT = 1 << 1
+CAP_CONTROL = 1 << 2
+CAP_STRIPED = 1 << 3
+CAP_ANALYSIS = 1 << 4
+CAP_RESULTS = 1 << 5
+CAP_ORIENTATION = 1 << 7
 
-            if frame is not None:
-                with _frame_lock:
-                    _latest_frame = frame
-                    _latest_jpeg = jpeg_data
+CODEC_JPEG = 1
+CODEC_RAW_GRAY = 2
+CODEC_RAW_BGR = 3
+
+# Orientation (octet du header, voir OrientationByte dans Protocol.h) : pixels
+# en orientation capteur, a tourner de (o & ORIENT_TURNS) quarts de tour
+# horaires puis a retourner si ORIENT_MIRROR. ROI et resultats restent en
+# pixels de la frame recue.
+ORIENT_TURNS = 0x03
+ORIENT_MIRROR = 0x04
+EXIF_ORIENTATION = (1, 6, 3, 8, 2, 5, 4, 7)  # tag EXIF par (quarts de tour + 4 si miroir)
+SERVER_CAPS = (CAP_CHECKSUM | CAP_REPEAT | CAP_CONTROL | CAP_STRIPED | CAP_ANALYSIS | CAP_RESULTS
+               | CAP_ORIENTATION)
+
+# Flux strie : StripeHello apres les caps du HELLO, voir Protocol.h
+STRIPE_HELLO = struct.Struct("<IBBH")
+JITTER_MS = 100  # attente max d'une frame en retard sur une autre voie
+
+# Canal de retour serveur -> device, voir ControlPayload dans Protocol.h
+CONTROL_PAYLOAD = struct.Struct("<B3xiiii")
+PONG_PAYLOAD = struct.Struct("<QQ")
+CTRL_SET_QUALITY = 1
+CTRL_SET_BITRATE = 2
+CTRL_SET_SIZE = 3
+CTRL_REQUEST_REFRESH = 4
+CTRL_SET_ROI = 5
+CTRL_PAUSE = 6
+CTRL_SERVER_LOAD = 7
+
+# Analyse deplacable et resultats (MSG_RESULTS), voir Results_Header / Result_Object dans Protocol.h
+ANALYSIS_DEVICE = 0
+ANALYSIS_SERVER = 1
+SITE_NAMES = {ANALYSIS_DEVICE: "device", ANALYSIS_SERVER: "serveur"}
+RESULTS_HEADER = struct.Struct("<BBHIII")
+RESULT_ENTRY = struct.Struct("<HHf4hBBHHH16h")
+RESULT_MAX_POINTS = 8
+RESULT_BARCODE = 1
+RESULT_OBJECT = 2
+
+
+def encode_results(site, cost_us, objects):
+    """Payload MSG_RESULTS. objects : dicts kind, box (x, y, l, h), et en option
+    class, confidence, points [(x, y)...] et text."""
+    body = b""
+    text = b""
+    for o in objects:
+        points = list(o.get("points", []))[:RESULT_MAX_POINTS]
+        flat = [int(v) for p in points for v in p]
+        label = o.get("text", "").encode()
+        body += RESULT_ENTRY.pack(o["kind"], o.get("class", 0), o.get("confidence", 1.0),
+                                   *[int(v) for v in o["box"]], len(points), 0, len(text), len(label),
+                                   0, *(flat + [0] * (2 * RESULT_MAX_POINTS - len(flat))))
+        text += label
+    return RESULTS_HEADER.pack(site, 0, len(objects), cost_us, len(text), 0) + body + text
+
+
+def decode_results(payload):
+    """Inverse de encode_results ; None si le payload est plus court qu'annonce."""
+    if len(payload) < RESULTS_HEADER.size:
+        return None
+    site, _, count, cost_us, text_bytes, _ = RESULTS_HEADER.unpack_from(payload)
+    text_at = RESULTS_HEADER.size + count * RESULT_ENTRY.size
+    if text_at + text_bytes > len(payload):
+        return None
+    objects = []
+    for i in range(count):
+        v = RESULT_ENTRY.unpack_from(payload, RESULTS_HEADER.size + i * RESULT_ENTRY.size)
+        kind, cls, conf, box, npts, offset, length = v[0], v[1], v[2], list(v[3:7]), v[7], v[9], v[10]
+        flat = v[12:12 + 2 * min(npts, RESULT_MAX_POINTS)]
+        o = {"kind": kind, "class": cls, "confidence": round(conf, 3), "box": box,
+             "points": [list(flat[k:k + 2]) for k in range(0, len(flat), 2)]}
+        if length:
+            o["text"] = payload[text_at + offset:text_at + offset + length].decode(errors="replace")
+        objects.append(o)
+    return {"site": SITE_NAMES.get(site, site), "cost_ms": round(cost_us / 1000, 2), "objects": objects}
+
+
+def orient_point(o, w, h, x, y):
+    """Point (x, y) d'une image w x h telle que recue -> image redressee."""
+    for _ in range(o & ORIENT_TURNS):
+        x, y, w, h = h - y, x, h, w
+    return (w - x if o & ORIENT_MIRROR else x), y
+
+
+def unorient_point(o, w, h, x, y):
+    """Point de l'image redressee -> image w x h telle que recue (w, h avant redressement)."""
+    turns = o & ORIENT_TURNS
+    if turns & 1:
+        w, h = h, w
+    if o & ORIENT_MIRROR:
+        x = w - x
+    for _ in range((4 - turns) % 4):
+        x, y, w, h = h - y, x, h, w
+    return x, y
+
+
+def upright_image(img, o):
+    """Pixels redresses (vue numpy, sans copie)."""
+    img = np.rot90(img, -(o & ORIENT_TURNS))
+    return img[:, ::-1] if o & ORIENT_MIRROR else img
+
+
+def jpeg_with_orientation(jpeg, o):
+    """Le JPEG avec un segment EXIF Orientation apres SOI / APP0 JFIF : le
+    navigateur le redresse, les pixels ne sont ni decodes ni tournes."""
+    tag = EXIF_ORIENTATION[(o & ORIENT_TURNS) | (4 if o & ORIENT_MIRROR else 0)]
+    if tag == 1 or jpeg[:2] != b"\xff\xd8":
+        return jpeg
+    skip = 2
+    if jpeg[2:4] == b"\xff\xe0":
+        skip += 2 + struct.unpack(">H", jpeg[4:6])[0]
+    tiff = b"II*\x00" + struct.pack("<IHHHIHHI", 8, 1, 0x0112, 3, 1, tag, 0, 0)
+    exif = b"\xff\xe1" + struct.pack(">H", 2 + 6 + len(tiff)) + b"Exif\x00\x00" + tiff
+    return jpeg[:skip] + exif + jpeg[skip:]
+
+
+def parse_header_v2(raw, payload_reader):
+    """Decode un header v2 ; payload_reader(n) fournit les n octets de payload."""
+    (magic, version, msg_type, flags, seq, ts, width, height,
+     codec, sharpness, orientation, payload_len, checksum) = HEADER_V2.unpack(raw)
+    if magic != PROTO_MAGIC or version != PROTO_VERSION:
+        raise ConnectionError(f"Header v2 invalide (magic={magic:#x}, version={version})")
+    if payload_len > PROTO_MAX_PAYLOAD:
+        raise ConnectionError(f"Payload v2 trop grand ({payload_len} octets)")
+    payload = payload_reader(payload_len) if payload_len else b""
+    if flags & FLAG_CHECKSUM and zlib.crc32(payload) != checksum:
+        print(f"[TCP] Checksum invalide sur la frame {seq}, ignoree")
+        return None, None, None
+    hdr = {"flags": flags, "seq": seq, "ts": ts, "width": width,
+           "height": height, "codec": codec, "sharpness": sharpness,
+           "orientation": orientation}
+    return msg_type, hdr, payload
+
+
+def read_message(conn):
+    """Lit un message v1 ou v2. Retourne (type, header v2 ou None, payload)."""
+    first = recv_exact(conn, 1)
+
+    if first[0] == V2_FIRST_BYTE:
+        raw = first + recv_exact(conn, HEADER_V2.size - 1)
+        return parse_header_v2(raw, lambda n: recv_exact(conn, n))
+
+    msg_type = first[0]
+    if msg_type == MSG_DIMS:
+        return msg_type, None, recv_exact(conn, 8)
+    if msg_type == MSG_JPEG:
+        size = struct.unpack("<i", recv_exact(conn, 4))[0]
+        if size < 0 or size > PROTO_MAX_PAYLOAD:
+            raise ConnectionError(f"Taille JPEG invalide : {size}")
+        return msg_type, None, recv_exact(conn, size)
+    if msg_type == MSG_REPEAT:
+        return msg_type, None, b""
+    raise ConnectionError(f"Type inconnu : {msg_type}")
+
+
+def hello_ack(caps):
+    payload = struct.pack("<I", caps)
+    hdr = HEADER_V2.pack(PROTO_MAGIC, PROTO_VERSION, MSG_HELLO_ACK, 0, 0, 0,
+                         0, 0, 0, 0, 0, len(payload), 0)
+    print(f"[TCP] Client protocole v2 (caps={caps:#x})")
+    return hdr + payload
+
+
+def now_us():
+    return time.monotonic_ns() // 1000
+
+
+def device_clock_lag_us():
+    """CLOCK_BOOTTIME (ProtoClockMicros du device) moins l'horloge de now_us()."""
+    return (time.clock_gettime_ns(time.CLOCK_BOOTTIME) - time.monotonic_ns()) // 1000
+
+
+# Synchronisation d'horloge (type NTP) sur les PING/PONG
+PING_INTERVAL = 1.0   # s
+SYNC_WINDOW = 8       # echantillons du filtre min-RTT
+DRIFT_WINDOW = 120.0  # s d'historique pour estimer la derive
+
+
+class ClockSync:
+    """Offset et derive de l'horloge d'un device par rapport a celle du serveur."""
+
+    def __init__(self):
+        self.samples = deque(maxlen=SYNC_WINDOW)  # (rtt, offset, t3)
+        self.points = deque()  # (t3, offset) retenus par le filtre
+        self.rtt = None
+        self.offset = None     # device - serveur, en µs, a l'instant ref
+        self.ref = 0
+        self.drift = 0.0       # µs/µs
+
+    def add(self, t0, t1, t2, t3):
+        rtt = (t3 - t0) - (t2 - t1)
+        offset = ((t1 - t0) + (t2 - t3)) / 2
+        self.samples.append((rtt, offset, t3))
+
+        # L'echantillon au plus petit RTT est celui qui a le moins attendu dans
+        # des files : son offset est le moins biaise par l'asymetrie
+        best_rtt, best_offset, best_t = min(self.samples)
+        self.rtt = best_rtt
+        if not self.points or self.points[-1][0] != best_t:
+            self.points.append((best_t, best_offset))
+        while t3 - self.points[0][0] > DRIFT_WINDOW * 1e6:
+            self.points.popleft()
+
+        # Derive = pente des offsets retenus (moindres carres)
+        n = len(self.points)
+        mean_t = sum(t for t, _ in self.points) / n
+        mean_o = sum(o for _, o in self.points) / n
+        var = sum((t - mean_t) ** 2 for t, _ in self.points)
+        if var > 0:
+            self.drift = sum((t - mean_t) * (o - mean_o) for t, o in self.points) / var
+        self.ref = t3
+        self.offset = mean_o + self.drift * (t3 - mean_t)
+
+    def to_server(self, device_us):
+        """Ramene un horodatage device dans l'horloge serveur (None si pas encore synchro)."""
+        if self.offset is None:
+            return None
+        approx = device_us - self.offset
+        return device_us - (self.offset + self.drift * (approx - self.ref))
+
+
+LATENCY_BOUNDS_MS = (1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000)
+
+
+class LatencyHistogram:
+    """Histogramme de latences a seaux fixes (ms)."""
+
+    def __init__(self):
+        self.counts = [0] * (len(LATENCY_BOUNDS_MS) + 1)
+        self.total = 0
+        self.sum_ms = 0.0
+
+    def add(self, ms):
+        ms = max(ms, 0.0)  # erreur residuelle de synchro
+        self.counts[bisect.bisect_left(LATENCY_BOUNDS_MS, ms)] += 1
+        self.total += 1
+        self.sum_ms += ms
+
+    def as_dict(self):
+        labels = [f"<={b}" for b in LATENCY_BOUNDS_MS] + [f">{LATENCY_BOUNDS_MS[-1]}"]
+        return {"count": self.total,
+                "mean_ms": round(self.sum_ms / self.total, 2) if self.total else None,
+                "buckets_ms": dict(zip(labels, self.counts))}
+
+
+class SharpnessHistogram:
+    """Nettete des frames recues (octet sharpness du header, voir SharpnessByte
+    dans Protocol.h) : 8 seaux de 32 valeurs, soit des scores < 4, 16, 64..."""
+
+    def __init__(self):
+        self.counts = [0] * 8
+        self.total = 0
+        self.sum = 0
+
+    def add(self, sharpness):
+        self.counts[sharpness // 32] += 1
+        self.total += 1
+        self.sum += sharpness
+
+    def as_dict(self):
+        labels = [f"<{4 ** (i + 1)}" for i in range(7)] + [f">={4 ** 7}"]
+        return {"count": self.total,
+                "mean": round(2 ** (self.sum / self.total / 16) - 1) if self.total else None,
+                "buckets": dict(zip(labels, self.counts))}
+
+
+class StreamState:
+    """Compteurs d'un flux entrant (une connexion TCP ou une source UDP)."""
+
+    def __init__(self, tag, reply=None):
+        self.tag = tag
+        self.frame_count = 0
+        self.repeat_count = 0
+        self.caps = 0
+        self.reply = reply  # envoi vers le device, None en UDP
+        self.reply_lock = threading.Lock()
+        self.clock = ClockSync()
+        self.receive_latency = LatencyHistogram()   # capture -> reception complete
+        self.delivery_latency = LatencyHistogram()  # capture -> ecriture HTTP
+        self.sharpness = SharpnessHistogram()       # frames dont le device mesure la nettete
+        self.orientation = 0                        # de la derniere frame (OrientationByte)
+        self.same_host = False                      # device local : horloge commune, sans PING
+        self.analysis_site = ANALYSIS_DEVICE        # cote choisi par le device (FLAG_ANALYZE)
+        self.server_analyses = 0
+        self.device_results = 0
+        self.last_analysis = None
+
+    def stats(self):
+        c = self.clock
+        return {"frames": self.frame_count, "repeats": self.repeat_count,
+                "clock": {"offset_ms": None if c.offset is None else round(c.offset / 1000, 3),
+                          "drift_ppm": round(c.drift * 1e6, 2),
+                          "rtt_ms": None if c.rtt is None else round(c.rtt / 1000, 3)},
+                "capture_to_receive": self.receive_latency.as_dict(),
+                "capture_to_http": self.delivery_latency.as_dict(),
+                "sharpness": self.sharpness.as_dict(),
+                "orientation": self.orientation,
+                "analysis": {"site": SITE_NAMES[self.analysis_site],
+                             "server_analyses": self.server_analyses,
+                             "device_results": self.device_results,
+                             "last": self.last_analysis}}
+
+    def send(self, msg_type, payload=b"", ts=0, width=0, height=0, seq=0):
+        """Envoie un message v2 au device (thread HTTP ou thread de reception)."""
+        hdr = HEADER_V2.pack(PROTO_MAGIC, PROTO_VERSION, msg_type, 0, seq, ts,
+                             width, height, 0, 0, 0, len(payload), 0)
+        self.send_raw(hdr + payload)
+
+    def send_raw(self, data):
+        with self.reply_lock:
+            self.reply(data)
+
+    def control(self, command, *args):
+        args = (list(args) + [0, 0, 0, 0])[:4]
+        self.send(MSG_CONTROL, CONTROL_PAYLOAD.pack(command, *args))
+
+    def ping(self):
+        self.send(MSG_PING, ts=now_us())
+
+
+class LazyFrame:
+    """Frame recue, gardee compressee. decode() ne decode qu'a la premiere
+    demande et memorise le resultat par (taille, gris) : plusieurs consommateurs
+    d'une meme frame partagent un seul decodage."""
+
+    decode_count = 0  # decodages JPEG effectifs, tous flux confondus (/stats)
+    _count_lock = threading.Lock()  # threads TCP, UDP et consommateurs
+
+    def __init__(self, jpeg, pixels=None):
+        self.jpeg = jpeg
+        self._pixels = pixels  # CODEC_RAW_* : deja decodee
+        self._decoded = {}
+        self._lock = threading.Lock()
+
+    def decode(self, size=None, gray=False):
+        """Image BGR (ou niveaux de gris), redimensionnee a size=(w, h) si demande.
+        None si le JPEG est illisible."""
+        key = (size, gray)
+        with self._lock:
+            if key not in self._decoded:
+                self._decoded[key] = self._decode(size, gray)
+            return self._decoded[key]
+
+    def _decode(self, size, gray):
+        # Appele sous _lock
+        if size is not None:
+            full = self._decoded.get((None, gray))
+            if full is None:
+                full = self._decoded[(None, gray)] = self._decode(None, gray)
+            if full is None or (full.shape[1], full.shape[0]) == size:
+                return full
+            return cv2.resize(full, size, interpolation=cv2.INTER_AREA)
+
+        if self._pixels is not None:
+            img = self._pixels
+            if gray and img.ndim == 3:
+                img = cv2.cvtColor(img, cv2.COLOR_BGR2GRAY)
+            elif not gray and img.ndim == 2:
+                img = cv2.cvtColor(img, cv2.COLOR_GRAY2BGR)
+            return img
+
+        with LazyFrame._count_lock:
+            LazyFrame.decode_count += 1
+        flags = cv2.IMREAD_GRAYSCALE if gray else cv2.IMREAD_COLOR
+        return cv2.imdecode(np.frombuffer(self.jpeg, dtype=np.uint8), flags)
+
+
+def barcode_detect(gray, orientation=0):
+    """Meme traitement que CV_Manager::BarcodeDetect sur le device, qui analyse
+    l'image droite : gray (frame telle que recue) est d'abord redressee.
+    Retourne None, ou l'objet RESULT_BARCODE du plus grand contour, en pixels
+    de la frame recue : rectangle englobant et les 4 sommets de son rectangle
+    oriente."""
+    height, width = gray.shape[:2]
+    if orientation:
+        gray = np.ascontiguousarray(upright_image(gray, orientation))
+    # Le device moyenne le gradient X avec lui-meme : seul X compte (barres verticales)
+    edges = cv2.convertScaleAbs(cv2.Sobel(gray, cv2.CV_16S, 1, 0))
+    edges = cv2.GaussianBlur(edges, (3, 3), 0)
+    _, thresh = cv2.threshold(edges, 120, 255, cv2.THRESH_BINARY)
+    _, thresh = cv2.threshold(thresh, 0, 255, cv2.THRESH_BINARY + cv2.THRESH_OTSU)
+    kernel = cv2.getStructuringElement(cv2.MORPH_RECT, (21, 7))
+    cleaned = cv2.morphologyEx(thresh, cv2.MORPH_CLOSE, kernel)
+    cleaned = cv2.erode(cleaned, None, iterations=4)
+    cleaned = cv2.dilate(cleaned, None, iterations=4)
+    contours, _ = cv2.findContours(cleaned, cv2.RETR_EXTERNAL, cv2.CHAIN_APPROX_SIMPLE)
+    if not contours:
+        return None
+    largest = max(contours, key=cv2.contourArea)
+    corners = np.float32([unorient_point(orientation, width, height, float(x), float(y))
+                          for x, y in cv2.boxPoints(cv2.minAreaRect(largest))])
+    return {"kind": RESULT_BARCODE, "box": cv2.boundingRect(corners),
+            "points": [(round(float(x)), round(float(y))) for x, y in corners]}
+
+
+class Analyzer:
+    """Analyse cote serveur des frames que les devices lui confient (FLAG_ANALYZE).
+
+    Un seul thread, une seule frame en attente par device : si l'analyse ne suit
+    pas, la plus recente remplace l'autre. Le cout moyen d'une analyse (decodage
+    compris) et la file sont annonces aux devices a chaque PING
+    (CTRL_SERVER_LOAD) : ils s'en servent pour choisir le cote de l'analyse.
+    """
+
+    def __init__(self):
+        self.cond = threading.Condition()
+        self.pending = {}  # StreamState -> (LazyFrame, header)
+        self.cost_us = 0   # moyenne glissante, 0 = aucune analyse encore
+
+    def submit(self, state, frame, hdr):
+        with self.cond:
+            self.pending[state] = (frame, hdr)
+            self.cond.notify()
 
-            if frame_count % 30 == 0:
-                print(f"[TCP] {frame_count} frames recues (derniere : {size} octets)")
+    def queued(self):
+        with self.cond:
+            return len(self.pending)
 
+    def run(self):
+        while True:
+            with self.cond:
+                while not self.pending:
+                    self.cond.wait()
+                state = next(iter(self.pending))  # le device qui attend depuis le plus longtemps
+                frame, hdr = self.pending.pop(state)
+
+            start = time.perf_counter()
+            gray = frame.decode(gray=True)
+            if gray is None:
+                continue
+            barcode = barcode_detect(gray, hdr["orientation"])
+            cost = int((time.perf_counter() - start) * 1e6)
+            self.cost_us = cost if not self.cost_us else int(0.8 * self.cost_us + 0.2 * cost)
+
+            payload = encode_results(ANALYSIS_SERVER, cost, [barcode] if barcode else [])
+            state.server_analyses += 1
+            state.last_analysis = dict(decode_results(payload), frame_seq=hdr["seq"], frame_ts=hdr["ts"])
+            try:
+                state.send(MSG_RESULTS, payload, ts=hdr["ts"], width=gray.shape[1],
+                           height=gray.shape[0], seq=hdr["seq"])
+            except OSError:
+                pass  # la deconnexion est traitee par le thread de reception
+
+
+_analyzer = Analyzer()
+
+
+# Consommateurs analytics : fn(state, LazyFrame), appeles dans le thread de
+# reception a chaque nouvelle frame. Sans consommateur, rien n'est decode.
+_consumers = []
+_consumers_lock = threading.Lock()
+
+
+def add_consumer(fn):
+    with _consumers_lock:
+        _consumers.append(fn)
+
+
+def remove_consumer(fn):
+    with _consumers_lock:
+        _consumers.remove(fn)
+
+
+def process_message(state, msg_type, hdr, payload, reply=None):
+    """Traite un message decode, quel que soit le transport."""
+    global _latest_frame, _latest_jpeg, _latest_meta
+
+    if msg_type is None:
+        return
+
+    if msg_type == MSG_HELLO:
+        client_caps = struct.unpack_from("<I", payload)[0] if len(payload) >= 4 else 0
+        state.caps = client_caps & SERVER_CAPS
+        if reply is not None:
+            reply(hello_ack(state.caps))
+
+    elif msg_type == MSG_PONG:
+        # t0 : envoi du ping (serveur), t1/t2 : reception/reponse (device), t3 : ici
+        t3 = now_us()
+        t0, t1 = PONG_PAYLOAD.unpack_from(payload)
+        state.clock.add(t0, t1, hdr["ts"], t3)
+        if len(state.clock.samples) == SYNC_WINDOW // 2:
+            print(f"[{state.tag}] Horloge synchronisee : offset {state.clock.offset / 1000:.1f} ms, "
+                  f"rtt {state.clock.rtt / 1000:.1f} ms")
+        if state.caps & CAP_ANALYSIS:
+            # Ce que le device compare a son propre cout d'analyse
+            state.control(CTRL_SERVER_LOAD, _analyzer.cost_us, _analyzer.queued(),
+                          max(0, int(state.clock.rtt)))
+
+    elif msg_type == MSG_RESULTS:
+        # Analyse faite sur le device : rien a refaire ici
+        results = decode_results(payload)
+        if results is None:
+            print(f"[{state.tag}] Resultats invalides pour la frame {hdr['seq']}, ignores")
+            return
+        state.device_results += 1
+        state.last_analysis = dict(results, frame_seq=hdr["seq"], frame_ts=hdr["ts"])
+
+    elif msg_type == MSG_DIMS:
+        if hdr is not None:
+            width, height = hdr["width"], hdr["height"]
+        else:
+            width, height = struct.unpack("<ii", payload)
+        print(f"[{state.tag}] Dimensions recues : {width} x {height}")
+
+    elif msg_type == MSG_JPEG:
+        jpeg_data = payload
+        state.frame_count += 1
+
+        # Capture ramenee dans l'horloge serveur : PING/PONG en TCP avec canal de retour,
+        # horloge lue directement pour une source UDP locale (edge_fleet)
+        capture_us = state.clock.to_server(hdr["ts"]) if hdr is not None and hdr["ts"] else None
+        if capture_us is None and state.same_host and hdr is not None and hdr["ts"]:
+            capture_us = hdr["ts"] - device_clock_lag_us()
+        if capture_us is not None:
+            state.receive_latency.add((now_us() - capture_us) / 1000)
+        if hdr is not None and hdr["sharpness"]:
+            state.sharpness.add(hdr["sharpness"])
+        orientation = hdr["orientation"] if hdr is not None else 0
+        state.orientation = orientation
+
+        codec = hdr["codec"] if hdr is not None else CODEC_JPEG
+        if codec in (CODEC_RAW_GRAY, CODEC_RAW_BGR):
+            # Pixels bruts : re-encodes en JPEG pour les clients MJPEG
+            shape = (hdr["height"], hdr["width"]) + ((3,) if codec == CODEC_RAW_BGR else ())
+            if len(jpeg_data) != int(np.prod(shape)) or not len(jpeg_data):
+                print(f"[{state.tag}] Frame brute de {len(jpeg_data)} octets pour "
+                      f"{hdr['width']}x{hdr['height']}, ignoree")
+                frame = None
+            else:
+                pixels = np.frombuffer(jpeg_data, dtype=np.uint8).reshape(shape)
+                ok, encoded = cv2.imencode(".jpg", pixels)
+                frame = LazyFrame(encoded.tobytes(), pixels) if ok else None
         else:
-            print(f"[TCP] Type inconnu : {msg_type}, abandon")
-            break
+            # Pas de decodage ici : le MJPEG renvoie les octets tels quels
+            frame = LazyFrame(jpeg_data)
+
+        if frame is not None:
+            # Les clients MJPEG recoivent le tag EXIF ; l'analyse decode les pixels tels que recus
+            jpeg_data = jpeg_with_orientation(frame.jpeg, orientation)
+            with _frame_lock:
+                _latest_frame = frame
+                _latest_jpeg = jpeg_data
+                _latest_meta = (state, capture_us)
+
+            with _consumers_lock:
+                consumers = list(_consumers)
+            # Un consommateur en erreur ne prive pas les suivants de la frame
+            for fn in consumers:
+                try:
+                    fn(state, frame)
+                except Exception as e:
+                    print(f"[{state.tag}] Consommateur {getattr(fn, '__name__', fn)} en erreur : {e!r}")
+
+            if hdr is not None and state.caps & CAP_ANALYSIS:
+                site = ANALYSIS_SERVER if hdr["flags"] & FLAG_ANALYZE else ANALYSIS_DEVICE
+                if site != state.analysis_site:
+                    print(f"[{state.tag}] Analyse : {SITE_NAMES[state.analysis_site]} -> "
+                          f"{SITE_NAMES[site]} (choix du device, analyse serveur "
+                          f"{_analyzer.cost_us / 1000:.1f} ms, {_analyzer.queued()} en attente)")
+                    state.analysis_site = site
+                if site == ANALYSIS_SERVER:
+                    _analyzer.submit(state, frame, hdr)
+
+        if state.frame_count % 30 == 0:
+            print(f"[{state.tag}] {state.frame_count} frames recues (derniere : {len(jpeg_data)} octets)")
+
+    elif msg_type == MSG_REPEAT:
+        # Scene inchangee : pas de payload, _latest_jpeg reste en cache
+        # et continue d'etre re-servi tel quel aux clients MJPEG
+        state.repeat_count += 1
+
+        if state.repeat_count % 30 == 0:
+            print(f"[{state.tag}] {state.repeat_count} frames repetees")
+
+    else:
+        print(f"[{state.tag}] Type v2 inconnu : {msg_type}, ignore")
+
+
+class StripeGroup:
+    """Remet dans l'ordre les frames d'un flux reparti sur plusieurs connexions.
+
+    Le device numerote les frames a l'envoi, sans trou : une frame manquante est
+    encore en route sur une autre voie. On l'attend au plus JITTER_MS (ou tant
+    que moins de 2 frames par voie sont en attente), puis on la saute.
+    """
+
+    def __init__(self, state, count):
+        self.state = state
+        self.count = count
+        self.lock = threading.Lock()
+        self.expected = 0
+        self.pending = {}  # seq -> (type, header, payload)
+        self.waiting_since = None
+        self.reordered = 0
+        self.skipped = 0
+
+    def push(self, msg_type, hdr, payload):
+        with self.lock:
+            seq = hdr["seq"]
+            if seq < self.expected:
+                return  # deja sautee
+            if seq != self.expected:
+                self.reordered += 1
+            self.pending[seq] = (msg_type, hdr, payload)
+            self.release()
+
+    def release(self):
+        while self.pending:
+            if self.expected in self.pending:
+                msg_type, hdr, payload = self.pending.pop(self.expected)
+                self.expected += 1
+                self.waiting_since = None
+                process_message(self.state, msg_type, hdr, payload)
+                continue
+
+            now = time.monotonic()
+            if self.waiting_since is None:
+                self.waiting_since = now
+            if len(self.pending) < 2 * self.count and now - self.waiting_since < JITTER_MS / 1000:
+                return
+            nxt = min(self.pending)
+            self.skipped += nxt - self.expected
+            print(f"[{self.state.tag}] Flux strie : {nxt - self.expected} frame(s) sautee(s) "
+                  f"({self.reordered} remises en ordre)")
+            self.expected = nxt
+            self.waiting_since = None
+
+
+_stripe_groups = {}  # stream_id -> StripeGroup
+_stripe_lock = threading.Lock()
+
+
+def handle_client(conn, addr):
+    state = StreamState("TCP", reply=conn.sendall)
+    with _devices_lock:
+        _devices[addr] = state
+    group = None
+    stream_id = None
+
+    try:
+        while True:
+            msg_type, hdr, payload = read_message(conn)
+
+            # StripeHello seulement si annonce : le HELLO peut aussi finir par un DeviceHello
+            if (msg_type == MSG_HELLO and len(payload) >= 4 + STRIPE_HELLO.size
+                    and struct.unpack_from("<I", payload)[0] & CAP_STRIPED):
+                stream_id, index, count, _ = STRIPE_HELLO.unpack_from(payload, 4)
+                with _stripe_lock:
+                    if index == 0:
+                        group = _stripe_groups[stream_id] = StripeGroup(state, count)
+                    else:
+                        group = _stripe_groups.get(stream_id)
+                if group is None:
+                    raise ConnectionError(f"Voie {index} d'un flux strie inconnu {stream_id:#x}")
+                if index > 0:
+                    # Voie secondaire : ni controle ni stats propres, tout va au flux principal
+                    stream_id = None
+                    with _devices_lock:
+                        _devices.pop(addr, None)
+                print(f"[TCP] Flux strie {group.state.tag} : voie {index + 1}/{count}")
+
+            if group is not None and msg_type in (MSG_JPEG, MSG_REPEAT):
+                group.push(msg_type, hdr, payload)
+            else:
+                # La reponse HELLO_ACK passe par le meme verrou que les commandes
+                process_message(state, msg_type, hdr, payload, reply=state.send_raw)
+    finally:
+        with _devices_lock:
+            _devices.pop(addr, None)
+        if stream_id is not None:
+            with _stripe_lock:
+                _stripe_groups.pop(stream_id, None)
+
+
+def clock_sync_loop():
+    """Ping periodique de chaque device : suivi continu de l'offset et de la derive."""
+    while True:
+        time.sleep(PING_INTERVAL)
+        with _devices_lock:
+            devices = [s for s in _devices.values() if s.caps & CAP_CONTROL]
+        for state in devices:
+            try:
+                state.ping()
+            except OSError:
+                pass  # la deconnexion est traitee par le thread de reception
+
+
+def control_devices(query):
+    """Applique une requete /control aux devices connectes. Retourne le nombre atteint."""
+    def ints(name, sep):
+        return [int(v) for v in query[name][0].split(sep)]
+
+    commands = []
+    if "quality" in query:
+        commands.append((CTRL_SET_QUALITY, ints("quality", ",")))
+    if "bitrate" in query:
+        commands.append((CTRL_SET_BITRATE, ints("bitrate", ",")))
+    if "size" in query:
+        commands.append((CTRL_SET_SIZE, ints("size", "x")))
+    if "roi" in query:
+        commands.append((CTRL_SET_ROI, ints("roi", ",")))
+    if "pause" in query:
+        commands.append((CTRL_PAUSE, [1]))
+    if "resume" in query:
+        commands.append((CTRL_PAUSE, [0]))
+    if "refresh" in query:
+        commands.append((CTRL_REQUEST_REFRESH, []))
+
+    target = query.get("device", [None])[0]
+    with _devices_lock:
+        devices = [s for a, s in _devices.items()
+                   if s.caps & CAP_CONTROL and (target is None or a[0] == target)]
+
+    for state in devices:
+        try:
+            for command, args in commands:
+                state.control(command, *args)
+            if "ping" in query:
+                state.ping()
+        except OSError as e:
+            print(f"[CTRL] Envoi impossible : {e}")
+    return len(devices)
+
+
+# Transport UDP : fragments + parite XOR, voir DatagramHeader dans Protocol.h
+DGRAM_MAGIC = 0x55474445  # "EDGU"
+DGRAM_HEADER = struct.Struct("<IBBHHHII")
+DGRAM_DATA = 0
+DGRAM_PARITY = 1
+FRAME_DEADLINE = 0.1  # s : au-dela une frame incomplete est abandonnee
+
+
+class Reassembly:
+    """Fragments recus d'un message UDP."""
+
+    def __init__(self, frag_count, frag_size, fec_group, length):
+        self.first_seen = time.monotonic()
+        self.frag_count = frag_count
+        self.frag_size = frag_size
+        self.fec_group = fec_group
+        self.length = length
+        self.data = {}
+        self.parity = {}
+
+    def frag_len(self, index):
+        if index == self.frag_count - 1:
+            return self.length - index * self.frag_size
+        return self.frag_size
+
+    def recover(self):
+        """Reconstruit un fragment manquant par groupe grace a la parite XOR."""
+        if not self.fec_group:
+            return
+        for group, parity in self.parity.items():
+            first = group * self.fec_group
+            members = range(first, min(first + self.fec_group, self.frag_count))
+            missing = [i for i in members if i not in self.data]
+            if len(missing) != 1:
+                continue
+            # XOR sur des entiers : bien plus rapide qu'une boucle octet par octet
+            acc = int.from_bytes(parity, "little")
+            for i in members:
+                if i != missing[0]:
+                    acc ^= int.from_bytes(self.data[i], "little")
+            raw = acc.to_bytes(len(parity), "little")
+            self.data[missing[0]] = raw[:self.frag_len(missing[0])]
+
+    def message(self):
+        if len(self.data) < self.frag_count:
+            self.recover()
+        if len(self.data) < self.frag_count:
+            return None
+        return b"".join(self.data[i] for i in range(self.frag_count))
+
+
+def udp_receiver():
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 * 1024 * 1024)
+    sock.bind(("0.0.0.0", TCP_PORT))
+    sock.settimeout(FRAME_DEADLINE / 2)
+    print(f"[UDP] En attente de datagrammes sur le port {TCP_PORT} ...")
+
+    # addr -> (StreamState, {message_id: Reassembly}, compteur d'abandons, dernier message_id complete)
+    sources = {}
+
+    while True:
+        try:
+            data, addr = sock.recvfrom(65535)
+        except socket.timeout:
+            data, addr = None, None
+
+        now = time.monotonic()
+        if data is not None and len(data) >= DGRAM_HEADER.size:
+            (magic, kind, fec_group, frag_index, frag_count, frag_size,
+             message_id, message_len) = DGRAM_HEADER.unpack_from(data)
+            if magic == DGRAM_MAGIC:
+                if addr not in sources:
+                    print(f"[UDP] Nouvelle source {addr}")
+                    sources[addr] = (StreamState("UDP"), {}, [0], [None])
+                    sources[addr][0].same_host = addr[0].startswith("127.")
+                    with _devices_lock:
+                        _udp_sources[addr] = sources[addr][0]
+                state, pending, dropped, completed = sources[addr]
+
+                # Datagramme tardif (parite, doublon) d'un message deja traite :
+                # comparaison modulo 2^32 pour survivre au rebouclage du compteur
+                late = (completed[0] is not None
+                        and (completed[0] - message_id) & 0xFFFFFFFF < 0x80000000)
+
+                if not late:
+                    r = pending.get(message_id)
+                    if r is None:
+                        r = pending[message_id] = Reassembly(frag_count, frag_size,
+                                                             fec_group, message_len)
+                    body = data[DGRAM_HEADER.size:]
+                    if kind == DGRAM_DATA:
+                        r.data[frag_index] = body
+                    elif kind == DGRAM_PARITY:
+                        r.parity[frag_index] = body
+
+                    msg = r.message()
+                    if msg is not None:
+                        del pending[message_id]
+                        completed[0] = message_id
+                        # Les messages plus anciens encore incomplets ne servent plus a rien
+                        for mid in [m for m, p in pending.items() if p.first_seen <= r.first_seen]:
+                            del pending[mid]
+                            dropped[0] += 1
+                        try:
+                            msg_type, hdr, payload = parse_header_v2(
+                                msg[:HEADER_V2.size], lambda n: msg[HEADER_V2.size:HEADER_V2.size + n])
+                            process_message(state, msg_type, hdr, payload)
+                        except ConnectionError as e:
+                            print(f"[UDP] Message invalide de {addr} : {e}")
+
+        # Pas d'attente au-dela de l'echeance : une frame incomplete est abandonnee
+        for addr, (state, pending, dropped, _) in sources.items():
+            for mid in [m for m, p in pending.items() if now - p.first_seen > FRAME_DEADLINE]:
+                del pending[mid]
+                dropped[0] += 1
+                if dropped[0] % 30 == 1:
+                    print(f"[UDP] {addr} : {dropped[0]} frames incompletes abandonnees")
 
 
 BOUNDARY = b"--frame"
@@ -90,16 +943,26 @@ BOUNDARY = b"--frame"
 
 class MJPEGHandler(BaseHTTPRequestHandler):
     def do_GET(self):
+        url = urlparse(self.path)
+        if url.path == "/control":
+            self.do_control(parse_qs(url.query, keep_blank_values=True))
+            return
+        if url.path == "/stats":
+            self.do_stats()
+            return
+
         self.send_response(200)
         self.send_header("Content-Type",
                          "multipart/x-mixed-replace; boundary=frame")
         self.end_headers()
 
         print(f"[HTTP] Client VLC connecte : {self.client_address}")
+        last_jpeg = None
         try:
             while True:
                 with _frame_lock:
                     jpeg = _latest_jpeg
+                    meta = _latest_meta
 
                 if jpeg is None:
                     time.sleep(0.05)
@@ -113,11 +976,43 @@ class MJPEGHandler(BaseHTTPRequestHandler):
                 self.wfile.write(b"\r\n")
                 self.wfile.flush()
 
+                # Latence comptee une fois par frame et par client, pas a chaque re-envoi
+                if jpeg is not last_jpeg and meta is not None and meta[1] is not None:
+                    meta[0].delivery_latency.add((now_us() - meta[1]) / 1000)
+                last_jpeg = jpeg
+
                 time.sleep(0.033)  # ~30 fps max
 
         except (BrokenPipeError, ConnectionResetError, ConnectionAbortedError):
             print(f"[HTTP] Client VLC deconnecte : {self.client_address}")
 
+    def do_control(self, query):
+        """/control?quality=50 | bitrate=2000 | size=320x240 | roi=x,y,w,h | pause
+        | resume | refresh | ping, optionnellement &device=<ip>."""
+        try:
+            count = control_devices(query)
+        except (ValueError, TypeError) as e:
+            self.send_error(400, f"Parametre invalide : {e}")
+            return
+        body = f"{count} device(s)\n".encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "text/plain")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def do_stats(self):
+        with _devices_lock:
+            stats = {f"{a[0]}:{a[1]}": s.stats() for a, s in _devices.items()}
+            stats.update({f"udp {a[0]}:{a[1]}": s.stats() for a, s in _udp_sources.items()})
+        stats["jpeg_decodes"] = LazyFrame.decode_count
+        body = json.dumps(stats, indent=2).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
     def log_message(self, format, *args):
         pass
 
@@ -125,8 +1020,13 @@ class MJPEGHandler(BaseHTTPRequestHandler):
 if __name__ == "__main__":
     tcp_thread = threading.Thread(target=tcp_receiver, daemon=True)
     tcp_thread.start()
+    udp_thread = threading.Thread(target=udp_receiver, daemon=True)
+    udp_thread.start()
+    threading.Thread(target=clock_sync_loop, daemon=True).start()
+    threading.Thread(target=_analyzer.run, daemon=True).start()
 
-    http_server = HTTPServer(("0.0.0.0", HTTP_PORT), MJPEGHandler)
+    # Un thread par client : /control reste joignable pendant les flux MJPEG
+    http_server = ThreadingHTTPServer(("0.0.0.0", HTTP_PORT), MJPEGHandler)
     print(f"[HTTP] Serveur MJPEG demarre sur http://0.0.0.0:{HTTP_PORT}")
     print(f"[INFO] Ouvrir VLC -> Media -> Flux reseau -> http://<IP_DU_PC>:{HTTP_PORT}")
     try: